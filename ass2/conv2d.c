@@ -4,6 +4,37 @@
  * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
  */
 
+/*
+ * Current OpenMP tiling/schedule parameters. The defaults reproduce the
+ * original hard-coded choices; conv2d_autotune or a tuning cache hit
+ * replaces them.
+ */
+static TuneParams tune_params = { 0, omp_sched_dynamic, 16 };
+
+/**
+ * Install tuned parameters (NULL restores the built-in defaults)
+ */
+void conv2d_set_tune_params(const TuneParams *params) {
+    if (params) {
+        tune_params = *params;
+    } else {
+        tune_params.block_size = 0;
+        tune_params.schedule = omp_sched_dynamic;
+        tune_params.chunk_size = 16;
+    }
+}
+
+void conv2d_get_tune_params(TuneParams *params) {
+    *params = tune_params;
+}
+
+/**
+ * Point the runtime schedule used by the stride kernels at the tuned choice
+ */
+static void apply_tuned_schedule(void) {
+    omp_set_schedule(tune_params.schedule, tune_params.chunk_size);
+}
+
 /**
  * Serial implementation of 2D convolution with "same" padding
  *
@@ -12,6 +43,7 @@
  * by accessing consecutive memory locations in the innermost loops
  */
 void conv2d_serial(float **f, int H, int W, float **g, int kH, int kW, float **output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     // Use precise padding calculation for both odd and even kernels
     int pad_top = (kH - 1) / 2;
     int pad_left = (kW - 1) / 2;
@@ -36,7 +68,7 @@ void conv2d_serial(float **f, int H, int W, float **g, int kH, int kW, float **o
                     // If outside boundaries, the padded value is 0, so no contribution
                 }
             }
-            output[i][j] = sum;
+            output[i][j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
         }
     }
 }
@@ -46,6 +78,7 @@ void conv2d_serial(float **f, int H, int W, float **g, int kH, int kW, float **o
  * Output size: ceil(H/sH) × ceil(W/sW)
  */
 void conv2d_serial_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     int pad_top = (kH - 1) / 2;
     int pad_left = (kW - 1) / 2;
 
@@ -72,23 +105,27 @@ void conv2d_serial_stride(float **f, int H, int W, float **g, int kH, int kW, in
                     }
                 }
             }
-            output[out_i][out_j] = sum;
+            output[out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
         }
     }
 }
 
 
 /**
- * OpenMP implementation with stride support
+ * Dense OpenMP stride loop (every tap, tuned runtime schedule). The rank
+ * calibration and the autotuner time this loop directly, since it is the
+ * one the row partitioner's cost model describes.
  */
-void conv2d_omp_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output) {
+static void omp_stride_dense(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     int pad_top = (kH - 1) / 2;
     int pad_left = (kW - 1) / 2;
 
     int out_H = (H + sH - 1) / sH;
     int out_W = (W + sW - 1) / sW;
 
-    #pragma omp parallel for schedule(dynamic, 16) collapse(2)
+    apply_tuned_schedule();
+    #pragma omp parallel for schedule(runtime) collapse(2)
     for (int out_i = 0; out_i < out_H; out_i++) {
         for (int out_j = 0; out_j < out_W; out_j++) {
             float sum = 0.0f;
@@ -105,11 +142,34 @@ void conv2d_omp_stride(float **f, int H, int W, float **g, int kH, int kW, int s
                     }
                 }
             }
-            output[out_i][out_j] = sum;
+            output[out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
         }
     }
 }
 
+/**
+ * OpenMP implementation with stride support
+ */
+void conv2d_omp_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output) {
+    int out_H = (H + sH - 1) / sH;
+
+    // Box-like kernels go through the summed-area table engine,
+    // mostly-zero kernels through the tap-list engine
+    BoxKernel box;
+    if (conv2d_box_select(g, kH, kW, sH, sW, &box)) {
+        conv2d_box_rows(f, 0, H, W, &box, sH, sW, output, 0, out_H);
+        conv2d_box_free(&box);
+        return;
+    }
+    SparseKernel sparse;
+    if (conv2d_sparse_select(g, kH, kW, &sparse)) {
+        conv2d_sparse_rows(f, 0, H, W, &sparse, sH, sW, output, 0, out_H);
+        conv2d_sparse_free(&sparse);
+        return;
+    }
+    omp_stride_dense(f, H, W, g, kH, kW, sH, sW, output);
+}
+
 /**
  * OpenMP blocked parallel implementation of 2D convolution
  *
@@ -119,6 +179,7 @@ void conv2d_omp_stride(float **f, int H, int W, float **g, int kH, int kW, int s
  * - Optimized for large matrices with better load balancing
  */
 void conv2d_omp_blocked(float **f, int H, int W, float **g, int kH, int kW, float **output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     // Use precise padding calculation for both odd and even kernels
     int pad_top = (kH - 1) / 2;
     int pad_left = (kW - 1) / 2;
@@ -163,6 +224,11 @@ void conv2d_omp_blocked(float **f, int H, int W, float **g, int kH, int kW, floa
                     H / (num_threads * 2) : H;
     block_size = (block_size < max_block) ? block_size : max_block;
     if (block_size < 1) block_size = 1;
+
+    // A tuned block size overrides the heuristic
+    if (tune_params.block_size > 0) {
+        block_size = (tune_params.block_size < H) ? tune_params.block_size : H;
+    }
     
     // Parallelize over output rows with dynamic scheduling
     #pragma omp parallel for schedule(dynamic, block_size) \
@@ -185,7 +251,7 @@ void conv2d_omp_blocked(float **f, int H, int W, float **g, int kH, int kW, floa
                     }
                 }
             }
-            output[i][j] = sum;
+            output[i][j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
         }
     }
 }
@@ -233,6 +299,319 @@ void free_2d_array(float **array, int rows) {
     }
 }
 
+/**
+ * Read a binary array file (Conv2dBinHeader + values) into floats
+ */
+static int read_array_from_binary(const char *filename, float ***array, int *rows, int *cols) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Conv2dBinHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, CONV2D_BIN_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CONV2D_BIN_VERSION || header.dtype > CONV2D_DTYPE_BF16 ||
+        header.rows <= 0 || header.cols <= 0) {
+        fprintf(stderr, "Error: Invalid binary header in %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+    *rows = header.rows;
+    *cols = header.cols;
+
+    *array = allocate_2d_array(*rows, *cols);
+    uint16_t *half_row = (uint16_t*)malloc(*cols * sizeof(uint16_t));
+    if (!*array || !half_row) {
+        free_2d_array(*array, *rows);
+        free(half_row);
+        fclose(file);
+        return -1;
+    }
+
+    for (int i = 0; i < *rows; i++) {
+        size_t got;
+        if (header.dtype == CONV2D_DTYPE_F32) {
+            got = fread((*array)[i], sizeof(float), *cols, file);
+        } else {
+            got = fread(half_row, sizeof(uint16_t), *cols, file);
+            conv2d_half_to_float(half_row, (*array)[i], *cols, header.dtype);
+        }
+        if (got != (size_t)*cols) {
+            fprintf(stderr, "Error: Cannot read row %d from %s\n", i, filename);
+            free_2d_array(*array, *rows);
+            free(half_row);
+            fclose(file);
+            return -1;
+        }
+    }
+
+    free(half_row);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Write array as a binary file with the given element type (CONV2D_DTYPE_*)
+ */
+int write_array_to_binary(const char *filename, float **array, int rows, int cols, int dtype) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file %s\n", filename);
+        return -1;
+    }
+
+    Conv2dBinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CONV2D_BIN_MAGIC, sizeof(header.magic));
+    header.version = CONV2D_BIN_VERSION;
+    header.dtype = (uint8_t)dtype;
+    header.rows = rows;
+    header.cols = cols;
+
+    uint16_t *half_row = (uint16_t*)malloc(cols * sizeof(uint16_t));
+    int status = (half_row && fwrite(&header, sizeof(header), 1, file) == 1) ? 0 : -1;
+    for (int i = 0; i < rows && status == 0; i++) {
+        size_t put;
+        if (dtype == CONV2D_DTYPE_F32) {
+            put = fwrite(array[i], sizeof(float), cols, file);
+        } else {
+            conv2d_float_to_half(array[i], half_row, cols, dtype);
+            put = fwrite(half_row, sizeof(uint16_t), cols, file);
+        }
+        if (put != (size_t)cols) status = -1;
+    }
+
+    free(half_row);
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Error: Cannot write %s\n", filename);
+    return status;
+}
+
+/**
+ * Dimensions of an array file without reading its values: the binary header,
+ * or the first line of a text file
+ */
+int read_array_dims(const char *filename, int *rows, int *cols) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Conv2dBinHeader header;
+    int status = -1;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, CONV2D_BIN_MAGIC, sizeof(header.magic)) == 0) {
+        if (header.version == CONV2D_BIN_VERSION && header.dtype <= CONV2D_DTYPE_BF16) {
+            *rows = header.rows;
+            *cols = header.cols;
+            status = 0;
+        }
+    } else {
+        rewind(file);
+        if (fscanf(file, "%d %d", rows, cols) == 2) status = 0;
+    }
+    fclose(file);
+
+    if (status != 0 || *rows <= 0 || *cols <= 0) {
+        fprintf(stderr, "Error: Cannot read array dimensions from %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read the sub-rectangle rect of an array file into a new rect.h x rect.w
+ * array. Binary files are read with one seek and one read per row, so only
+ * the rectangle is touched; text files have no fixed row offsets and are
+ * parsed in full, then cropped. Returns the bytes read from the file (0 for
+ * text), or -1 on error.
+ */
+long long read_array_region(const char *filename, Conv2dRect rect, float ***array) {
+    int rows, cols;
+    if (read_array_dims(filename, &rows, &cols) != 0) return -1;
+    if (rect.y < 0 || rect.x < 0 || rect.h <= 0 || rect.w <= 0 ||
+        rect.y + rect.h > rows || rect.x + rect.w > cols) {
+        fprintf(stderr, "Error: Region %d,%d,%d,%d outside %dx%d array in %s\n",
+                rect.y, rect.x, rect.h, rect.w, rows, cols, filename);
+        return -1;
+    }
+
+    FILE *file = fopen(filename, "rb");
+    char magic[4];
+    if (!file || fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        memcmp(magic, CONV2D_BIN_MAGIC, sizeof(magic)) != 0) {
+        // Text file: read everything, keep the rectangle
+        if (file) fclose(file);
+        float **full;
+        if (read_array_from_file(filename, &full, &rows, &cols) != 0) return -1;
+        *array = allocate_2d_array(rect.h, rect.w);
+        if (!*array) {
+            free_2d_array(full, rows);
+            return -1;
+        }
+        for (int i = 0; i < rect.h; i++) {
+            memcpy((*array)[i], full[rect.y + i] + rect.x, rect.w * sizeof(float));
+        }
+        free_2d_array(full, rows);
+        return 0;
+    }
+
+    Conv2dBinHeader header;
+    rewind(file);
+    if (fread(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return -1;
+    }
+    size_t esize = conv2d_dtype_size(header.dtype);
+    *array = allocate_2d_array(rect.h, rect.w);
+    uint16_t *half_row = (uint16_t*)malloc(rect.w * sizeof(uint16_t));
+    if (!*array || !half_row) {
+        free_2d_array(*array, rect.h);
+        free(half_row);
+        fclose(file);
+        return -1;
+    }
+
+    long long bytes = 0;
+    for (int i = 0; i < rect.h; i++) {
+        off_t offset = (off_t)sizeof(header) + ((off_t)(rect.y + i) * cols + rect.x) * (off_t)esize;
+        size_t got = 0;
+        if (fseeko(file, offset, SEEK_SET) == 0) {
+            if (header.dtype == CONV2D_DTYPE_F32) {
+                got = fread((*array)[i], sizeof(float), rect.w, file);
+            } else {
+                got = fread(half_row, sizeof(uint16_t), rect.w, file);
+                conv2d_half_to_float(half_row, (*array)[i], rect.w, header.dtype);
+            }
+        }
+        if (got != (size_t)rect.w) {
+            fprintf(stderr, "Error: Cannot read row %d from %s\n", rect.y + i, filename);
+            free_2d_array(*array, rect.h);
+            free(half_row);
+            fclose(file);
+            return -1;
+        }
+        bytes += (long long)rect.w * esize;
+    }
+
+    free(half_row);
+    fclose(file);
+    return bytes;
+}
+
+/**
+ * Read a binary volume file into a new contiguous depth x rows x cols array
+ * (slice, row, column). A 2D binary file reads as a volume of depth 1.
+ */
+int read_volume_from_file(const char *filename, float **volume, int *depth, int *rows, int *cols) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Conv2dBinHeader header;
+    int32_t d = 1;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, CONV2D_BIN_MAGIC, sizeof(header.magic)) != 0 ||
+        (header.version != CONV2D_BIN_VERSION && header.version != CONV2D_BIN_VERSION_3D) ||
+        (header.version == CONV2D_BIN_VERSION_3D && fread(&d, sizeof(d), 1, file) != 1) ||
+        header.dtype > CONV2D_DTYPE_BF16 || header.rows <= 0 || header.cols <= 0 || d <= 0) {
+        fprintf(stderr, "Error: Invalid binary volume header in %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+    *depth = d;
+    *rows = header.rows;
+    *cols = header.cols;
+
+    size_t plane = (size_t)*rows * *cols;
+    *volume = (float*)malloc((size_t)*depth * plane * sizeof(float));
+    uint16_t *half_row = (uint16_t*)malloc(*cols * sizeof(uint16_t));
+    if (!*volume || !half_row) {
+        fprintf(stderr, "Error: Failed to allocate memory for volume %s\n", filename);
+        free(*volume);
+        free(half_row);
+        fclose(file);
+        return -1;
+    }
+
+    for (long long r = 0; r < (long long)*depth * *rows; r++) {
+        float *dst = *volume + (size_t)r * *cols;
+        size_t got;
+        if (header.dtype == CONV2D_DTYPE_F32) {
+            got = fread(dst, sizeof(float), *cols, file);
+        } else {
+            got = fread(half_row, sizeof(uint16_t), *cols, file);
+            conv2d_half_to_float(half_row, dst, *cols, header.dtype);
+        }
+        if (got != (size_t)*cols) {
+            fprintf(stderr, "Error: Cannot read slice %lld row %lld from %s\n",
+                    r / *rows, r % *rows, filename);
+            free(*volume);
+            free(half_row);
+            fclose(file);
+            return -1;
+        }
+    }
+
+    free(half_row);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Write a contiguous depth x rows x cols volume as a binary volume file with
+ * the given element type (CONV2D_DTYPE_*)
+ */
+int write_volume_to_binary(const char *filename, const float *volume, int depth, int rows, int cols, int dtype) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file %s\n", filename);
+        return -1;
+    }
+
+    Conv2dBinHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CONV2D_BIN_MAGIC, sizeof(header.magic));
+    header.version = CONV2D_BIN_VERSION_3D;
+    header.dtype = (uint8_t)dtype;
+    header.rows = rows;
+    header.cols = cols;
+    int32_t d = depth;
+
+    uint16_t *half_row = (uint16_t*)malloc(cols * sizeof(uint16_t));
+    int status = (half_row && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(&d, sizeof(d), 1, file) == 1) ? 0 : -1;
+    for (long long r = 0; r < (long long)depth * rows && status == 0; r++) {
+        const float *src = volume + (size_t)r * cols;
+        size_t put;
+        if (dtype == CONV2D_DTYPE_F32) {
+            put = fwrite(src, sizeof(float), cols, file);
+        } else {
+            conv2d_float_to_half(src, half_row, cols, dtype);
+            put = fwrite(half_row, sizeof(uint16_t), cols, file);
+        }
+        if (put != (size_t)cols) status = -1;
+    }
+
+    free(half_row);
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Error: Cannot write %s\n", filename);
+    return status;
+}
+
+/**
+ * 1 if filename ends in ".bin" (written in the binary format)
+ */
+int is_binary_filename(const char *filename) {
+    size_t len = strlen(filename);
+    return len >= 4 && strcmp(filename + len - 4, ".bin") == 0;
+}
+
 /**
  * Read array from file following the specification:
  * First line: height width
@@ -244,6 +623,15 @@ int read_array_from_file(const char *filename, float ***array, int *rows, int *c
         fprintf(stderr, "Error: Cannot open file %s\n", filename);
         return -1;
     }
+
+    // Binary files start with the magic; everything else is text
+    char magic[4];
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, CONV2D_BIN_MAGIC, sizeof(magic)) == 0) {
+        fclose(file);
+        return read_array_from_binary(filename, array, rows, cols);
+    }
+    rewind(file);
     
     // Read dimensions
     if (fscanf(file, "%d %d", rows, cols) != 2) {
@@ -342,16 +730,16 @@ void performance_analysis_threads(float **f, int H, int W, float **g, int kH, in
     int best_threads = 1;
     double single_thread_time = 0.0;
     
+    // One output array serves every thread count
+    float **output = allocate_2d_array(H, W);
+    if (!output) {
+        fprintf(stderr, "Error allocating memory for performance test\n");
+        return;
+    }
+
     for (int threads = 1; threads <= max_threads; threads++) {
         omp_set_num_threads(threads);
         
-        // Allocate output array
-        float **output = allocate_2d_array(H, W);
-        if (!output) {
-            fprintf(stderr, "Error allocating memory for performance test\n");
-            continue;
-        }
-        
         // Warm up (not timed)
         conv2d_omp_blocked(f, H, W, g, kH, kW, output);
         
@@ -379,124 +767,598 @@ void performance_analysis_threads(float **f, int H, int W, float **g, int kH, in
             printf(" <-- BEST");
         }
         printf("\n");
-        
-        free_2d_array(output, H);
     }
+    free_2d_array(output, H);
     
     printf("\nOptimal thread count: %d (%.6f seconds)\n", best_threads, best_time);
 }
 
 
+/*
+ * Autotuning candidates: schedule and chunk pairs for the stride kernels
+ */
+static const omp_sched_t tune_schedules[] = { omp_sched_static, omp_sched_dynamic, omp_sched_guided };
+static const int tune_chunk_sizes[] = { 1, 4, 16, 64 };
+
+// Row block candidates for conv2d_omp_blocked
+static const int tune_block_sizes[] = { 2, 4, 8, 16, 32, 64 };
+
+// Target multiply-adds per candidate timing on the sample
+#define TUNE_SAMPLE_OPS 20000000.0
+
 /**
- * Calculate time difference in seconds
+ * Read the CPU model name used to key the tuning cache
  */
-double get_time_diff(struct timespec start, struct timespec end) {
-    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+static void get_cpu_model(char *model, size_t len) {
+    snprintf(model, len, "unknown");
+
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (!file) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "model name", 10) == 0) {
+            char *value = strchr(line, ':');
+            if (value) {
+                value++;
+                while (*value == ' ' || *value == '\t') value++;
+                value[strcspn(value, "\n")] = '\0';
+                snprintf(model, len, "%s", value);
+            }
+            break;
+        }
+    }
+    fclose(file);
 }
 
 /**
- * MPI-only distributed memory implementation with stride
- *
- * Data decomposition: Row-based decomposition of output
- * Each process computes a contiguous block of output rows
- * Requires halo exchange for overlapping input regions
+ * Size class of a dimension: floor(log2(n)), so nearby sizes share a cache entry
  */
-void conv2d_mpi_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm) {
-    int rank, size;
-    MPI_Comm_rank(comm, &rank);
-    MPI_Comm_size(comm, &size);
-
-    int pad_top = (kH - 1) / 2;
-    int pad_left = (kW - 1) / 2;
-
-    int out_H = (H + sH - 1) / sH;
-    int out_W = (W + sW - 1) / sW;
-
-    // Distribute output rows among processes
-    int rows_per_proc = (out_H + size - 1) / size;
-    int local_start = rank * rows_per_proc;
-    int local_end = (rank + 1) * rows_per_proc;
-    if (local_end > out_H) local_end = out_H;
-    int local_rows = local_end - local_start;
-
-    // Compute local output only if this process has rows assigned
-    if (local_rows > 0) {
-        // Calculate input region needed (with halo)
-        int input_start = local_start * sH - pad_top;
-        int input_end = (local_end - 1) * sH + kH - pad_top;
-
-        // Clamp to valid input range
-        if (input_start < 0) input_start = 0;
-        if (input_end > H) input_end = H;
-        int input_rows = input_end - input_start;
+static int size_class(int n) {
+    int c = 0;
+    while (n > 1) {
+        n >>= 1;
+        c++;
+    }
+    return c;
+}
 
-        // Allocate local input buffer if needed
-        float **local_f = NULL;
-        if (size > 1) {
-            local_f = allocate_2d_array(input_rows, W);
+/**
+ * Default tuning cache location: $CONV2D_TUNE_CACHE, else ~/.conv2d_tune_cache
+ */
+static void default_cache_path(char *path, size_t len) {
+    const char *env = getenv("CONV2D_TUNE_CACHE");
+    const char *home = getenv("HOME");
+    if (env && *env) {
+        snprintf(path, len, "%s", env);
+    } else if (home && *home) {
+        snprintf(path, len, "%s/.conv2d_tune_cache", home);
+    } else {
+        snprintf(path, len, ".conv2d_tune_cache");
+    }
+}
 
-            // Gather required input rows
-            for (int i = 0; i < input_rows; i++) {
-                memcpy(local_f[i], f[input_start + i], W * sizeof(float));
-            }
-        } else {
-            local_f = f;
+/**
+ * Look up a problem key in the tuning cache. Returns 0 on a hit.
+ *
+ * Cache format, one entry per line:
+ *   cpu model<TAB>Hclass Wclass kH kW sH sW threads<TAB>block schedule chunk
+ */
+static int tune_cache_lookup(const char *path, const char *cpu, const char *key, TuneParams *params) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char line[1024];
+    int found = -1;
+    while (fgets(line, sizeof(line), file)) {
+        char *cpu_field = strtok(line, "\t");
+        char *key_field = strtok(NULL, "\t");
+        char *value_field = strtok(NULL, "\t\n");
+        if (!cpu_field || !key_field || !value_field) continue;
+        if (strcmp(cpu_field, cpu) != 0 || strcmp(key_field, key) != 0) continue;
+
+        int block, schedule, chunk;
+        if (sscanf(value_field, "%d %d %d", &block, &schedule, &chunk) == 3) {
+            params->block_size = block;
+            params->schedule = (omp_sched_t)schedule;
+            params->chunk_size = chunk;
+            found = 0;
         }
+    }
+    fclose(file);
+    return found;
+}
 
-        // Compute local output
-        for (int out_i = 0; out_i < local_rows; out_i++) {
-            for (int out_j = 0; out_j < out_W; out_j++) {
-                float sum = 0.0f;
-                int i = (local_start + out_i) * sH;
-                int j = out_j * sW;
+/**
+ * Store (or replace) a problem key in the tuning cache
+ */
+static int tune_cache_store(const char *path, const char *cpu, const char *key, const TuneParams *params) {
+    char tmp_path[1100];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", path, (int)getpid());
 
-                for (int ki = 0; ki < kH; ki++) {
-                    for (int kj = 0; kj < kW; kj++) {
-                        int input_i = i + ki - pad_top;
-                        int input_j = j + kj - pad_left;
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fprintf(stderr, "Warning: Cannot write tuning cache %s\n", tmp_path);
+        return -1;
+    }
 
-                        if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
-                            int local_i = input_i - input_start;
-                            sum += local_f[local_i][input_j] * g[ki][kj];
-                        }
-                    }
-                }
-                output[local_start + out_i][out_j] = sum;
+    // Copy every other entry, then append the new one
+    FILE *in = fopen(path, "r");
+    if (in) {
+        char line[1024], copy[1024];
+        while (fgets(line, sizeof(line), in)) {
+            memcpy(copy, line, sizeof(line));
+            char *cpu_field = strtok(copy, "\t");
+            char *key_field = strtok(NULL, "\t");
+            if (cpu_field && key_field && strcmp(cpu_field, cpu) == 0 && strcmp(key_field, key) == 0) {
+                continue;
             }
+            fputs(line, out);
         }
-
-        if (size > 1) {
-            free_2d_array(local_f, input_rows);
-        }
+        fclose(in);
     }
+    fprintf(out, "%s\t%s\t%d %d %d\n", cpu, key,
+            params->block_size, (int)params->schedule, params->chunk_size);
+    fclose(out);
 
-    // Gather results to all processes
-    // All processes must participate in all MPI_Bcast calls
-    if (size > 1) {
-        for (int p = 0; p < size; p++) {
-            int p_start = p * rows_per_proc;
-            int p_end = (p + 1) * rows_per_proc;
-            if (p_end > out_H) p_end = out_H;
-            int p_rows = p_end - p_start;
-
-            // All processes participate, even if p_rows is 0
-            for (int i = 0; i < p_rows; i++) {
-                MPI_Bcast(output[p_start + i], out_W, MPI_FLOAT, p, comm);
-            }
-        }
+    if (rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Warning: Cannot update tuning cache %s\n", path);
+        remove(tmp_path);
+        return -1;
     }
+    return 0;
 }
 
 /**
- * Hybrid MPI+OpenMP implementation with stride
- *
- * Two-level parallelism:
- * - MPI: Distribute output rows across processes
- * - OpenMP: Parallelize computation within each process
+ * Time one candidate: best of two runs of conv2d_omp_stride on the sample.
+ * Its runtime-scheduled row loop (or the box or tap-list engine it picks
+ * for this kernel) is the one the omp, hybrid and dynamic modes run.
+ */
+static double time_tune_candidate(float **f, int H, int W, float **g, int kH, int kW,
+                                  int sH, int sW, float **output) {
+    struct timespec start, end;
+    double best = 1e30;
+    for (int rep = 0; rep < 2; rep++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        omp_stride_dense(f, H, W, g, kH, kW, sH, sW, output);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = get_time_diff(start, end);
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+/**
+ * Time conv2d_omp_blocked (stride 1) on the sample, best of two runs
+ */
+static double time_tune_block(float **f, int H, int W, float **g, int kH, int kW, float **output) {
+    struct timespec start, end;
+    double best = 1e30;
+    for (int rep = 0; rep < 2; rep++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        conv2d_omp_blocked(f, H, W, g, kH, kW, output);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = get_time_diff(start, end);
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+/**
+ * Autotune the OpenMP schedule and chunk size of the stride kernels and the
+ * row block of conv2d_omp_blocked for this problem class and install the
+ * result. The block size is only searched for stride 1 (the blocked kernel
+ * has no stride); otherwise the current one is kept. The OpenMP runtime
+ * schedule in effect before the call is restored afterwards.
  *
- * This is the main function for Assignment 2
+ * The class is (log2 H, log2 W, kH, kW, sH, sW, threads) on this CPU model.
+ * A cached entry is used as-is unless force is set; otherwise each candidate
+ * is timed on a short sample of the input (its top-left corner, sized to
+ * about TUNE_SAMPLE_OPS multiply-adds) and the winner is written back.
+ *
+ * Returns 1 if the parameters came from the cache, 0 if they were tuned
+ * now, -1 on allocation failure.
  */
-void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm) {
+int conv2d_autotune(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW,
+                    int force, const char *cache_path, TuneParams *result) {
+    char path[1024], cpu[256], key[128];
+    if (cache_path) {
+        snprintf(path, sizeof(path), "%s", cache_path);
+    } else {
+        default_cache_path(path, sizeof(path));
+    }
+    get_cpu_model(cpu, sizeof(cpu));
+
+    int threads = omp_get_max_threads();
+    snprintf(key, sizeof(key), "%d %d %d %d %d %d %d",
+             size_class(H), size_class(W), kH, kW, sH, sW, threads);
+
+    TuneParams best;
+    conv2d_get_tune_params(&best);
+    if (!force && tune_cache_lookup(path, cpu, key, &best) == 0) {
+        conv2d_set_tune_params(&best);
+        if (result) *result = best;
+        return 1;
+    }
+
+    // Sample the top rows of the input, at most 512 columns wide
+    int sample_W = W < 512 ? W : 512;
+    double out_cols = (double)((sample_W + sW - 1) / sW);
+    double target_pixels = TUNE_SAMPLE_OPS / (double)(kH * kW);
+    if (target_pixels < threads * 256.0) target_pixels = threads * 256.0;
+    long long rows = (long long)(target_pixels / out_cols + 1.0) * sH;
+    int sample_H = rows < H ? (int)rows : H;
+
+    float **sample_out = allocate_2d_array((sample_H + sH - 1) / sH, (sample_W + sW - 1) / sW);
+    if (!sample_out) return -1;
+
+    omp_sched_t saved_schedule;
+    int saved_chunk;
+    omp_get_schedule(&saved_schedule, &saved_chunk);
+
+    // Schedule and chunk size for the stride kernels
+    TuneParams trial = best;
+    double best_time = 1e30;
+    for (size_t s = 0; s < sizeof(tune_schedules) / sizeof(tune_schedules[0]); s++) {
+        for (size_t c = 0; c < sizeof(tune_chunk_sizes) / sizeof(tune_chunk_sizes[0]); c++) {
+            trial.schedule = tune_schedules[s];
+            trial.chunk_size = tune_chunk_sizes[c];
+            conv2d_set_tune_params(&trial);
+
+            double t = time_tune_candidate(f, sample_H, sample_W, g, kH, kW, sH, sW, sample_out);
+            if (t < best_time) {
+                best_time = t;
+                best.schedule = trial.schedule;
+                best.chunk_size = trial.chunk_size;
+            }
+        }
+    }
+
+    free_2d_array(sample_out, (sample_H + sH - 1) / sH);
+
+    // Row block of the blocked kernel, which computes every input pixel
+    // (kept as it is if the sample output cannot be allocated)
+    float **block_out = sH == 1 && sW == 1 ? allocate_2d_array(sample_H, sample_W) : NULL;
+    if (block_out) {
+        trial = best;
+        best_time = 1e30;
+        for (size_t b = 0; b < sizeof(tune_block_sizes) / sizeof(tune_block_sizes[0]); b++) {
+            trial.block_size = tune_block_sizes[b];
+            conv2d_set_tune_params(&trial);
+
+            double t = time_tune_block(f, sample_H, sample_W, g, kH, kW, block_out);
+            if (t < best_time) {
+                best_time = t;
+                best.block_size = trial.block_size;
+            }
+        }
+        free_2d_array(block_out, sample_H);
+    }
+    omp_set_schedule(saved_schedule, saved_chunk);
+
+    conv2d_set_tune_params(&best);
+    tune_cache_store(path, cpu, key, &best);
+    if (result) *result = best;
+    return 0;
+}
+
+/**
+ * Calculate time difference in seconds
+ */
+double get_time_diff(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * Optional per-rank speed weights used by the row partitioner.
+ * NULL (the default) means all ranks are assumed to run at the same speed.
+ */
+static double *rank_weights = NULL;
+static int rank_weights_count = 0;
+
+/**
+ * Install per-rank relative speed weights (e.g. from conv2d_calibrate_rank_weights).
+ * Passing NULL or count <= 0 restores uniform weights.
+ */
+void conv2d_set_rank_weights(const double *weights, int count) {
+    free(rank_weights);
+    rank_weights = NULL;
+    rank_weights_count = 0;
+
+    if (!weights || count <= 0) return;
+
+    rank_weights = (double*)malloc(count * sizeof(double));
+    if (!rank_weights) {
+        fprintf(stderr, "Error: Failed to allocate memory for rank weights\n");
+        return;
+    }
+    memcpy(rank_weights, weights, count * sizeof(double));
+    rank_weights_count = count;
+}
+
+/**
+ * Return the installed weight for rank p, or 1.0 if none are installed for
+ * a communicator of this size
+ */
+static double rank_weight(const double *weights, int p) {
+    if (!weights || weights[p] <= 0.0) return 1.0;
+    return weights[p];
+}
+
+/**
+ * Cost model for one output row: number of valid kernel taps (the border
+ * rows see fewer input rows) plus a fixed per-pixel overhead for the loop
+ * and output store
+ */
+static void compute_row_costs(int H, int W, int kH, int kW, int sH, int sW, double *costs) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    // Valid taps across one output row are the same for every row
+    long long col_taps = 0;
+    for (int out_j = 0; out_j < out_W; out_j++) {
+        int j = out_j * sW - pad_left;
+        int lo = j < 0 ? -j : 0;
+        int hi = (j + kW > W) ? W - j : kW;
+        col_taps += hi - lo;
+    }
+
+    for (int out_i = 0; out_i < out_H; out_i++) {
+        int i = out_i * sH - pad_top;
+        int lo = i < 0 ? -i : 0;
+        int hi = (i + kH > H) ? H - i : kH;
+        costs[out_i] = (double)(hi - lo) * (double)col_taps + (double)out_W;
+    }
+}
+
+/**
+ * Greedy cut for a bottleneck of limit: each part in turn takes rows while
+ * its cost stays within limit times its weight, keeping one row for every
+ * remaining part (when there are enough rows). Returns 1 if all out_H rows
+ * were placed, so no part exceeds limit.
+ */
+static int partition_within(const double *costs, int out_H, int nparts, const double *weights,
+                            double limit, int *row_starts) {
+    int min_rows = out_H >= nparts ? 1 : 0;
+    int row = 0;
+    row_starts[0] = 0;
+    for (int p = 0; p < nparts; p++) {
+        double cap = limit * rank_weight(weights, p);
+        int max_end = out_H - min_rows * (nparts - 1 - p);
+        double part_cost = 0.0;
+        int end = row;
+        while (end < max_end && part_cost + costs[end] <= cap) part_cost += costs[end++];
+        if (end - row < min_rows) return 0;
+        row = end;
+        row_starts[p + 1] = end;
+    }
+    return row == out_H;
+}
+
+/**
+ * Split the output rows into nparts contiguous bands whose modelled cost is
+ * proportional to each part's speed weight (weights may be NULL).
+ *
+ * The largest weighted part cost is minimised by a binary search on that
+ * bottleneck: a greedy cut decides whether a bound is reachable, and the
+ * cut for the smallest reachable bound is kept.
+ *
+ * row_starts must hold nparts + 1 entries; part p owns output rows
+ * [row_starts[p], row_starts[p + 1]). Every part receives at least one row
+ * whenever there are at least as many output rows as parts.
+ */
+void conv2d_partition_rows(int H, int W, int kH, int kW, int sH, int sW,
+                           int nparts, const double *weights, int *row_starts) {
+    int out_H = (H + sH - 1) / sH;
+
+    double *costs = (double*)malloc(out_H * sizeof(double));
+    if (!costs) {
+        // Fall back to equal bands if the cost table cannot be allocated
+        for (int p = 0; p <= nparts; p++) {
+            row_starts[p] = (int)((long long)out_H * p / nparts);
+        }
+        return;
+    }
+    compute_row_costs(H, W, kH, kW, sH, sW, costs);
+
+    double total_cost = 0.0, min_weight = 0.0;
+    for (int i = 0; i < out_H; i++) total_cost += costs[i];
+    for (int p = 0; p < nparts; p++) {
+        double w = rank_weight(weights, p);
+        if (p == 0 || w < min_weight) min_weight = w;
+    }
+
+    // Any single part may hold every row, so total / min_weight is reachable
+    // (padded so rounding in the weighted caps cannot make it unreachable)
+    double lo = 0.0, hi = total_cost / min_weight * (1.0 + 1e-9);
+    for (int iter = 0; iter < 100 && hi - lo > hi * 1e-12; iter++) {
+        double mid = 0.5 * (lo + hi);
+        if (partition_within(costs, out_H, nparts, weights, mid, row_starts)) hi = mid;
+        else lo = mid;
+    }
+    if (!partition_within(costs, out_H, nparts, weights, hi, row_starts)) {
+        for (int p = 0; p <= nparts; p++) {
+            row_starts[p] = (int)((long long)out_H * p / nparts);
+        }
+    }
+
+    free(costs);
+}
+
+/**
+ * Load imbalance of a partition: (slowest part's weighted cost / ideal) - 1.
+ * 0.0 means perfectly balanced, 0.25 means the slowest part finishes 25%
+ * later than it would under a perfect split.
+ */
+double conv2d_partition_imbalance(int H, int W, int kH, int kW, int sH, int sW,
+                                  int nparts, const double *weights, const int *row_starts) {
+    int out_H = (H + sH - 1) / sH;
+
+    double *costs = (double*)malloc(out_H * sizeof(double));
+    if (!costs) return 0.0;
+    compute_row_costs(H, W, kH, kW, sH, sW, costs);
+
+    double total_cost = 0.0, total_weight = 0.0, worst = 0.0;
+    for (int i = 0; i < out_H; i++) total_cost += costs[i];
+    for (int p = 0; p < nparts; p++) {
+        double part_cost = 0.0;
+        for (int i = row_starts[p]; i < row_starts[p + 1]; i++) part_cost += costs[i];
+        double w = rank_weight(weights, p);
+        total_weight += w;
+        if (part_cost / w > worst) worst = part_cost / w;
+    }
+    free(costs);
+
+    double ideal = total_cost / total_weight;
+    return ideal > 0.0 ? worst / ideal - 1.0 : 0.0;
+}
+
+/**
+ * Equal-band split used before the cost model: ceil(out_H / nparts) rows each
+ */
+static void equal_row_partition(int out_H, int nparts, int *row_starts) {
+    int rows_per_proc = (out_H + nparts - 1) / nparts;
+    for (int p = 0; p <= nparts; p++) {
+        long long start = (long long)p * rows_per_proc;
+        row_starts[p] = start > out_H ? out_H : (int)start;
+    }
+}
+
+/**
+ * Installed rank weights for a communicator of this size, or NULL if none
+ * (or weights for a different size) are installed
+ */
+const double* conv2d_get_rank_weights(int size) {
+    return (rank_weights_count == size) ? rank_weights : NULL;
+}
+
+/**
+ * Build the row partition for this communicator using the installed rank
+ * weights (if they match the communicator size). Caller frees the result.
+ */
+int* conv2d_create_row_partition(int H, int W, int kH, int kW, int sH, int sW, int size, MPI_Comm comm) {
+    int *row_starts = (int*)malloc((size + 1) * sizeof(int));
+    if (!row_starts) {
+        fprintf(stderr, "Error: Failed to allocate memory for row partition\n");
+        MPI_Abort(comm, 1);
+    }
+    const double *weights = conv2d_get_rank_weights(size);
+    conv2d_partition_rows(H, W, kH, kW, sH, sW, size, weights, row_starts);
+    return row_starts;
+}
+
+/**
+ * Record the load imbalance of the old equal-band split and the cost-weighted
+ * split in the statistics
+ */
+void conv2d_record_partition_stats(int H, int W, int kH, int kW, int sH, int sW,
+                                   int size, const int *row_starts, PerfStats *stats) {
+    const double *weights = conv2d_get_rank_weights(size);
+    int out_H = (H + sH - 1) / sH;
+
+    int *equal_starts = (int*)malloc((size + 1) * sizeof(int));
+    if (equal_starts) {
+        equal_row_partition(out_H, size, equal_starts);
+        stats->load_imbalance_before =
+            conv2d_partition_imbalance(H, W, kH, kW, sH, sW, size, weights, equal_starts);
+        free(equal_starts);
+    }
+    stats->load_imbalance_after =
+        conv2d_partition_imbalance(H, W, kH, kW, sH, sW, size, weights, row_starts);
+}
+
+/**
+ * Reset the statistics at the start of a call and snapshot the calling
+ * thread's arena counters (conv2d_arena_stats_end turns them into deltas)
+ */
+void conv2d_stats_begin(PerfStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    conv2d_arena_stats_begin(conv2d_thread_arena(), stats);
+}
+
+/**
+ * Calibration kernel of k x k taps: a checkerboard of two nonzero weights,
+ * so every tap is a rectangle of its own and neither the tap-list nor the
+ * summed-area table engine would take it. The weights sum to 1.
+ */
+void conv2d_calibration_kernel(float **g, int k) {
+    float total = 0.0f;
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++)
+            total += g[i][j] = (float)(1 + (i + j) % 2);
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++)
+            g[i][j] /= total;
+}
+
+/**
+ * Quick calibration run: every rank times the same small OpenMP convolution
+ * and the relative speeds are installed as partition weights on all ranks.
+ * Returns 0 on success.
+ */
+int conv2d_calibrate_rank_weights(MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    const int cal_H = 256, cal_W = 256, cal_k = CALIBRATION_KERNEL;
+    float **cal_f = allocate_2d_array(cal_H, cal_W);
+    float **cal_g = allocate_2d_array(cal_k, cal_k);
+    float **cal_out = allocate_2d_array(cal_H, cal_W);
+    if (!cal_f || !cal_g || !cal_out) {
+        free_2d_array(cal_f, cal_H);
+        free_2d_array(cal_g, cal_k);
+        free_2d_array(cal_out, cal_H);
+        return -1;
+    }
+
+    // Deterministic contents so every rank does identical work
+    for (int i = 0; i < cal_H; i++)
+        for (int j = 0; j < cal_W; j++)
+            cal_f[i][j] = (float)((i * 31 + j * 17) % 97) / 97.0f;
+    conv2d_calibration_kernel(cal_g, cal_k);
+
+    // Warm up, then keep the best of a few repetitions of the dense loop
+    omp_stride_dense(cal_f, cal_H, cal_W, cal_g, cal_k, cal_k, 1, 1, cal_out);
+    double best = 1e9;
+    for (int rep = 0; rep < 3; rep++) {
+        double t0 = MPI_Wtime();
+        omp_stride_dense(cal_f, cal_H, cal_W, cal_g, cal_k, cal_k, 1, 1, cal_out);
+        double t = MPI_Wtime() - t0;
+        if (t < best) best = t;
+    }
+
+    free_2d_array(cal_f, cal_H);
+    free_2d_array(cal_g, cal_k);
+    free_2d_array(cal_out, cal_H);
+
+    double speed = best > 0.0 ? 1.0 / best : 1.0;
+    double *speeds = (double*)malloc(size * sizeof(double));
+    if (!speeds) return -1;
+    MPI_Allgather(&speed, 1, MPI_DOUBLE, speeds, 1, MPI_DOUBLE, comm);
+
+    // Normalise so the mean weight is 1.0
+    double mean = 0.0;
+    for (int p = 0; p < size; p++) mean += speeds[p];
+    mean /= size;
+    for (int p = 0; p < size; p++) speeds[p] /= mean;
+
+    conv2d_set_rank_weights(speeds, size);
+    free(speeds);
+    return 0;
+}
+
+/**
+ * MPI-only distributed memory implementation with stride
+ *
+ * Data decomposition: Row-based decomposition of output
+ * Each process computes a contiguous block of output rows
+ * Requires halo exchange for overlapping input regions
+ */
+void conv2d_mpi_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     int rank, size;
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
@@ -504,14 +1366,12 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
     int pad_top = (kH - 1) / 2;
     int pad_left = (kW - 1) / 2;
 
-    int out_H = (H + sH - 1) / sH;
     int out_W = (W + sW - 1) / sW;
 
-    // Distribute output rows among processes
-    int rows_per_proc = (out_H + size - 1) / size;
-    int local_start = rank * rows_per_proc;
-    int local_end = (rank + 1) * rows_per_proc;
-    if (local_end > out_H) local_end = out_H;
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
     int local_rows = local_end - local_start;
 
     // Compute local output only if this process has rows assigned
@@ -520,15 +1380,23 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
         int input_start = local_start * sH - pad_top;
         int input_end = (local_end - 1) * sH + kH - pad_top;
 
+        // Clamp to valid input range
         if (input_start < 0) input_start = 0;
         if (input_end > H) input_end = H;
         int input_rows = input_end - input_start;
 
-        // Allocate local input buffer if needed
+        // Local input copy comes from this thread's scratch arena
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
         float **local_f = NULL;
         if (size > 1) {
-            local_f = allocate_2d_array(input_rows, W);
+            local_f = conv2d_arena_alloc_2d(arena, input_rows, W);
+            if (!local_f) {
+                fprintf(stderr, "Error: Failed to allocate memory for local input\n");
+                MPI_Abort(comm, 1);
+            }
 
+            // Gather required input rows
             for (int i = 0; i < input_rows; i++) {
                 memcpy(local_f[i], f[input_start + i], W * sizeof(float));
             }
@@ -536,8 +1404,7 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
             local_f = f;
         }
 
-        // Compute local output with OpenMP parallelization
-        #pragma omp parallel for schedule(dynamic, 16) collapse(2)
+        // Compute local output
         for (int out_i = 0; out_i < local_rows; out_i++) {
             for (int out_j = 0; out_j < out_W; out_j++) {
                 float sum = 0.0f;
@@ -555,23 +1422,129 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
                         }
                     }
                 }
-                output[local_start + out_i][out_j] = sum;
+                output[local_start + out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
             }
         }
 
+        conv2d_arena_rewind(arena, mark);
+    }
+
+    // Gather results to all processes
+    // All processes must participate in all MPI_Bcast calls
+    if (size > 1) {
+        for (int p = 0; p < size; p++) {
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
+
+            // All processes participate, even if p_rows is 0
+            for (int i = 0; i < p_rows; i++) {
+                MPI_Bcast(output[p_start + i], out_W, MPI_FLOAT, p, comm);
+            }
+        }
+    }
+
+    free(row_starts);
+}
+
+/**
+ * Hybrid MPI+OpenMP implementation with stride
+ *
+ * Two-level parallelism:
+ * - MPI: Distribute output rows across processes
+ * - OpenMP: Parallelize computation within each process
+ *
+ * This is the main function for Assignment 2
+ */
+void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_W = (W + sW - 1) / sW;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+    int local_rows = local_end - local_start;
+
+    // Compute local output only if this process has rows assigned
+    if (local_rows > 0) {
+        // Calculate input region needed (with halo)
+        int input_start = local_start * sH - pad_top;
+        int input_end = (local_end - 1) * sH + kH - pad_top;
+
+        if (input_start < 0) input_start = 0;
+        if (input_end > H) input_end = H;
+        int input_rows = input_end - input_start;
+
+        // Local input copy comes from this thread's scratch arena
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float **local_f = NULL;
         if (size > 1) {
-            free_2d_array(local_f, input_rows);
+            local_f = conv2d_arena_alloc_2d(arena, input_rows, W);
+            if (!local_f) {
+                fprintf(stderr, "Error: Failed to allocate memory for local input\n");
+                MPI_Abort(comm, 1);
+            }
+
+            for (int i = 0; i < input_rows; i++) {
+                memcpy(local_f[i], f[input_start + i], W * sizeof(float));
+            }
+        } else {
+            local_f = f;
+        }
+
+        // Compute local output with OpenMP parallelization
+        // Box-like kernels go through the summed-area table engine,
+        // mostly-zero kernels through the tap-list engine
+        BoxKernel box;
+        SparseKernel sparse;
+        if (conv2d_box_select(g, kH, kW, sH, sW, &box)) {
+            conv2d_box_rows(local_f, input_start, H, W, &box, sH, sW, output, local_start, local_end);
+            conv2d_box_free(&box);
+        } else if (conv2d_sparse_select(g, kH, kW, &sparse)) {
+            conv2d_sparse_rows(local_f, input_start, H, W, &sparse, sH, sW, output, local_start, local_end);
+            conv2d_sparse_free(&sparse);
+        } else {
+            apply_tuned_schedule();
+            #pragma omp parallel for schedule(runtime) collapse(2)
+            for (int out_i = 0; out_i < local_rows; out_i++) {
+                for (int out_j = 0; out_j < out_W; out_j++) {
+                    float sum = 0.0f;
+                    int i = (local_start + out_i) * sH;
+                    int j = out_j * sW;
+
+                    for (int ki = 0; ki < kH; ki++) {
+                        for (int kj = 0; kj < kW; kj++) {
+                            int input_i = i + ki - pad_top;
+                            int input_j = j + kj - pad_left;
+
+                            if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
+                                int local_i = input_i - input_start;
+                                sum += local_f[local_i][input_j] * g[ki][kj];
+                            }
+                        }
+                    }
+                    output[local_start + out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
+                }
+            }
         }
+
+        conv2d_arena_rewind(arena, mark);
     }
 
     // Gather results to all processes
     // All processes must participate in all MPI_Bcast calls
     if (size > 1) {
         for (int p = 0; p < size; p++) {
-            int p_start = p * rows_per_proc;
-            int p_end = (p + 1) * rows_per_proc;
-            if (p_end > out_H) p_end = out_H;
-            int p_rows = p_end - p_start;
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
 
             // All processes participate, even if p_rows is 0
             for (int i = 0; i < p_rows; i++) {
@@ -579,24 +1552,20 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
             }
         }
     }
+
+    free(row_starts);
 }
 
 /**
  * MPI-only implementation with detailed performance statistics
  */
 void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     int rank, size;
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
-    // Initialize stats
-    stats->total_time = 0.0;
-    stats->computation_time = 0.0;
-    stats->communication_time = 0.0;
-    stats->broadcast_time = 0.0;
-    stats->memory_copy_time = 0.0;
-    stats->bytes_communicated = 0;
-    stats->num_communications = 0;
+    conv2d_stats_begin(stats);
 
     double t_start, t_comp_start, t_comm_start;
     t_start = MPI_Wtime();
@@ -609,11 +1578,11 @@ void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW,
 
     stats->output_elements = (long long)out_H * out_W;
 
-    // Distribute output rows among processes
-    int rows_per_proc = (out_H + size - 1) / size;
-    int local_start = rank * rows_per_proc;
-    int local_end = (rank + 1) * rows_per_proc;
-    if (local_end > out_H) local_end = out_H;
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
     int local_rows = local_end - local_start;
 
     // Compute local output only if this process has rows assigned
@@ -627,11 +1596,17 @@ void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW,
         if (input_end > H) input_end = H;
         int input_rows = input_end - input_start;
 
-        // Allocate local input buffer if needed
+        // Local input copy comes from this thread's scratch arena
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
         float **local_f = NULL;
         if (size > 1) {
             t_comm_start = MPI_Wtime();
-            local_f = allocate_2d_array(input_rows, W);
+            local_f = conv2d_arena_alloc_2d(arena, input_rows, W);
+            if (!local_f) {
+                fprintf(stderr, "Error: Failed to allocate memory for local input\n");
+                MPI_Abort(comm, 1);
+            }
 
             // Gather required input rows (memory copy)
             for (int i = 0; i < input_rows; i++) {
@@ -662,24 +1637,20 @@ void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW,
                         }
                     }
                 }
-                output[local_start + out_i][out_j] = sum;
+                output[local_start + out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
             }
         }
         stats->computation_time += MPI_Wtime() - t_comp_start;
 
-        if (size > 1) {
-            free_2d_array(local_f, input_rows);
-        }
+        conv2d_arena_rewind(arena, mark);
     }
 
     // Gather results to all processes
     if (size > 1) {
         t_comm_start = MPI_Wtime();
         for (int p = 0; p < size; p++) {
-            int p_start = p * rows_per_proc;
-            int p_end = (p + 1) * rows_per_proc;
-            if (p_end > out_H) p_end = out_H;
-            int p_rows = p_end - p_start;
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
 
             // All processes participate, even if p_rows is 0
             for (int i = 0; i < p_rows; i++) {
@@ -692,6 +1663,8 @@ void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW,
         stats->communication_time = stats->broadcast_time + stats->memory_copy_time;
     }
 
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
     stats->total_time = MPI_Wtime() - t_start;
 }
 
@@ -699,18 +1672,12 @@ void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW,
  * Hybrid MPI+OpenMP implementation with detailed performance statistics
  */
 void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
     int rank, size;
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
-    // Initialize stats
-    stats->total_time = 0.0;
-    stats->computation_time = 0.0;
-    stats->communication_time = 0.0;
-    stats->broadcast_time = 0.0;
-    stats->memory_copy_time = 0.0;
-    stats->bytes_communicated = 0;
-    stats->num_communications = 0;
+    conv2d_stats_begin(stats);
 
     double t_start, t_comp_start, t_comm_start;
     t_start = MPI_Wtime();
@@ -723,11 +1690,11 @@ void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int
 
     stats->output_elements = (long long)out_H * out_W;
 
-    // Distribute output rows among processes
-    int rows_per_proc = (out_H + size - 1) / size;
-    int local_start = rank * rows_per_proc;
-    int local_end = (rank + 1) * rows_per_proc;
-    if (local_end > out_H) local_end = out_H;
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
     int local_rows = local_end - local_start;
 
     // Compute local output only if this process has rows assigned
@@ -740,11 +1707,17 @@ void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int
         if (input_end > H) input_end = H;
         int input_rows = input_end - input_start;
 
-        // Allocate local input buffer if needed
+        // Local input copy comes from this thread's scratch arena
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
         float **local_f = NULL;
         if (size > 1) {
             t_comm_start = MPI_Wtime();
-            local_f = allocate_2d_array(input_rows, W);
+            local_f = conv2d_arena_alloc_2d(arena, input_rows, W);
+            if (!local_f) {
+                fprintf(stderr, "Error: Failed to allocate memory for local input\n");
+                MPI_Abort(comm, 1);
+            }
 
             for (int i = 0; i < input_rows; i++) {
                 memcpy(local_f[i], f[input_start + i], W * sizeof(float));
@@ -757,11 +1730,149 @@ void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int
 
         // Compute local output with OpenMP parallelization
         t_comp_start = MPI_Wtime();
-        #pragma omp parallel for schedule(dynamic, 16) collapse(2)
-        for (int out_i = 0; out_i < local_rows; out_i++) {
+        // Box-like kernels go through the summed-area table engine,
+        // mostly-zero kernels through the tap-list engine
+        BoxKernel box;
+        SparseKernel sparse;
+        if (conv2d_box_select(g, kH, kW, sH, sW, &box)) {
+            conv2d_box_rows(local_f, input_start, H, W, &box, sH, sW, output, local_start, local_end);
+            conv2d_box_free(&box);
+        } else if (conv2d_sparse_select(g, kH, kW, &sparse)) {
+            conv2d_sparse_rows(local_f, input_start, H, W, &sparse, sH, sW, output, local_start, local_end);
+            conv2d_sparse_free(&sparse);
+        } else {
+            apply_tuned_schedule();
+            #pragma omp parallel for schedule(runtime) collapse(2)
+            for (int out_i = 0; out_i < local_rows; out_i++) {
+                for (int out_j = 0; out_j < out_W; out_j++) {
+                    float sum = 0.0f;
+                    int i = (local_start + out_i) * sH;
+                    int j = out_j * sW;
+
+                    for (int ki = 0; ki < kH; ki++) {
+                        for (int kj = 0; kj < kW; kj++) {
+                            int input_i = i + ki - pad_top;
+                            int input_j = j + kj - pad_left;
+
+                            if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
+                                int local_i = input_i - input_start;
+                                sum += local_f[local_i][input_j] * g[ki][kj];
+                            }
+                        }
+                    }
+                    output[local_start + out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
+                }
+            }
+        }
+        stats->computation_time += MPI_Wtime() - t_comp_start;
+
+        conv2d_arena_rewind(arena, mark);
+    }
+
+    // Gather results to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
+
+            // All processes participate, even if p_rows is 0
+            for (int i = 0; i < p_rows; i++) {
+                MPI_Bcast(output[p_start + i], out_W, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)out_W * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time + stats->memory_copy_time;
+    }
+
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+
+/**
+ * Hybrid MPI+OpenMP implementation with dynamic load balancing
+ *
+ * Instead of one static band per rank, the output rows are cut into many
+ * small chunks. Ranks claim the next chunk with an atomic MPI_Fetch_and_op
+ * on a counter exposed by rank 0 in an RMA window, so a rank slowed down by
+ * a noisy neighbour simply claims fewer chunks. Every rank already holds the
+ * full input (as in conv2d_stride), so a chunk reads its halo rows directly.
+ *
+ * Chunk ownership is combined afterwards and each chunk's rows are
+ * broadcast from the rank that computed them.
+ */
+void conv2d_stride_dynamic_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Several chunks per rank so there is something left to claim at the end
+    int chunk_rows = out_H / (size * DYNAMIC_CHUNKS_PER_RANK);
+    if (chunk_rows < 1) chunk_rows = 1;
+    int num_chunks = (out_H + chunk_rows - 1) / chunk_rows;
+
+    // Shared chunk counter lives on rank 0
+    int *counter = NULL;
+    MPI_Win win;
+    MPI_Win_allocate(rank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, comm, &counter, &win);
+    if (rank == 0) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+        *counter = 0;
+        MPI_Win_unlock(0, win);
+    }
+    MPI_Barrier(comm);
+
+    int *chunk_owner = (int*)malloc(num_chunks * sizeof(int));
+    if (!chunk_owner) {
+        fprintf(stderr, "Error: Failed to allocate memory for chunk owners\n");
+        MPI_Abort(comm, 1);
+    }
+    for (int c = 0; c < num_chunks; c++) chunk_owner[c] = -1;
+
+    MPI_Win_lock_all(0, win);
+    const int one = 1;
+    while (1) {
+        int chunk;
+        t_comm_start = MPI_Wtime();
+        MPI_Fetch_and_op(&one, &chunk, MPI_INT, 0, 0, MPI_SUM, win);
+        MPI_Win_flush(0, win);
+        stats->communication_time += MPI_Wtime() - t_comm_start;
+
+        if (chunk >= num_chunks) break;
+
+        chunk_owner[chunk] = rank;
+        stats->chunks_claimed++;
+
+        int chunk_start = chunk * chunk_rows;
+        int chunk_end = chunk_start + chunk_rows;
+        if (chunk_end > out_H) chunk_end = out_H;
+
+        // Compute this chunk with OpenMP parallelization
+        t_comp_start = MPI_Wtime();
+        apply_tuned_schedule();
+        #pragma omp parallel for schedule(runtime) collapse(2)
+        for (int out_i = chunk_start; out_i < chunk_end; out_i++) {
             for (int out_j = 0; out_j < out_W; out_j++) {
                 float sum = 0.0f;
-                int i = (local_start + out_i) * sH;
+                int i = out_i * sH;
                 int j = out_j * sW;
 
                 for (int ki = 0; ki < kH; ki++) {
@@ -770,40 +1881,400 @@ void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int
                         int input_j = j + kj - pad_left;
 
                         if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
-                            int local_i = input_i - input_start;
-                            sum += local_f[local_i][input_j] * g[ki][kj];
+                            sum += f[input_i][input_j] * g[ki][kj];
                         }
                     }
                 }
-                output[local_start + out_i][out_j] = sum;
+                output[out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
             }
         }
         stats->computation_time += MPI_Wtime() - t_comp_start;
-
-        if (size > 1) {
-            free_2d_array(local_f, input_rows);
-        }
     }
+    MPI_Win_unlock_all(win);
 
-    // Gather results to all processes
+    // Time spent waiting for the slowest rank to run out of chunks
+    double t_idle_start = MPI_Wtime();
+    MPI_Barrier(comm);
+    stats->idle_time = MPI_Wtime() - t_idle_start;
+
+    MPI_Win_free(&win);
+
+    // Gather results to all processes from each chunk's owner
     if (size > 1) {
         t_comm_start = MPI_Wtime();
-        for (int p = 0; p < size; p++) {
-            int p_start = p * rows_per_proc;
-            int p_end = (p + 1) * rows_per_proc;
-            if (p_end > out_H) p_end = out_H;
-            int p_rows = p_end - p_start;
-
-            // All processes participate, even if p_rows is 0
-            for (int i = 0; i < p_rows; i++) {
-                MPI_Bcast(output[p_start + i], out_W, MPI_FLOAT, p, comm);
+        MPI_Allreduce(MPI_IN_PLACE, chunk_owner, num_chunks, MPI_INT, MPI_MAX, comm);
+        for (int c = 0; c < num_chunks; c++) {
+            int c_start = c * chunk_rows;
+            int c_end = c_start + chunk_rows;
+            if (c_end > out_H) c_end = out_H;
+
+            for (int i = c_start; i < c_end; i++) {
+                MPI_Bcast(output[i], out_W, MPI_FLOAT, chunk_owner[c], comm);
                 stats->num_communications++;
                 stats->bytes_communicated += (long long)out_W * sizeof(float);
             }
         }
         stats->broadcast_time = MPI_Wtime() - t_comm_start;
-        stats->communication_time = stats->broadcast_time + stats->memory_copy_time;
+        stats->communication_time += stats->broadcast_time;
     }
 
+    free(chunk_owner);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
     stats->total_time = MPI_Wtime() - t_start;
 }
+
+/**
+ * Hybrid MPI+OpenMP implementation with dynamic chunk claiming
+ * (alternative to the static row split of conv2d_stride)
+ */
+void conv2d_stride_dynamic(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_dynamic_stats(f, H, W, g, kH, kW, sH, sW, output, comm, &stats);
+}
+
+/*
+ * Output tile used by the filter-bank kernels. The input footprint of one
+ * tile ((rows * sH + kH) x (cols * sW + kW) floats) stays cache-resident
+ * while every kernel group of the bank is applied to it.
+ */
+#define BANK_TILE_ROWS 8
+#define BANK_TILE_COLS 256
+
+// Kernels accumulated together per output pixel (one input load feeds all)
+#define BANK_KERNEL_GROUP 32
+
+/**
+ * Apply every kernel of a bank to output rows [row_start, row_end) in
+ * one pass over the input.
+ *
+ * The kernels are packed tap-major (packed[tap * num_kernels + k]) so each
+ * input value is loaded once and multiplied into up to BANK_KERNEL_GROUP
+ * accumulators with a unit-stride SIMD loop over the kernels. The band is
+ * walked in tiles, so the tile's input stays cached across kernel groups.
+ */
+static void conv2d_bank_rows(float **f, int H, int W, const float *packed, int num_kernels, int kH, int kW,
+                             int sH, int sW, float ***outputs, int row_start, int row_end) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_W = (W + sW - 1) / sW;
+
+    int tile_rows = (row_end - row_start + BANK_TILE_ROWS - 1) / BANK_TILE_ROWS;
+    int tile_cols = (out_W + BANK_TILE_COLS - 1) / BANK_TILE_COLS;
+
+    apply_tuned_schedule();
+    #pragma omp parallel for schedule(runtime) collapse(2)
+    for (int tr = 0; tr < tile_rows; tr++) {
+        for (int tc = 0; tc < tile_cols; tc++) {
+            int i_start = row_start + tr * BANK_TILE_ROWS;
+            int i_end = i_start + BANK_TILE_ROWS;
+            if (i_end > row_end) i_end = row_end;
+            int j_start = tc * BANK_TILE_COLS;
+            int j_end = j_start + BANK_TILE_COLS;
+            if (j_end > out_W) j_end = out_W;
+
+            for (int k0 = 0; k0 < num_kernels; k0 += BANK_KERNEL_GROUP) {
+                int nk = num_kernels - k0;
+                if (nk > BANK_KERNEL_GROUP) nk = BANK_KERNEL_GROUP;
+
+                for (int out_i = i_start; out_i < i_end; out_i++) {
+                    for (int out_j = j_start; out_j < j_end; out_j++) {
+                        float sum[BANK_KERNEL_GROUP] = {0.0f};
+                        int i = out_i * sH;
+                        int j = out_j * sW;
+
+                        for (int ki = 0; ki < kH; ki++) {
+                            int input_i = i + ki - pad_top;
+                            if (input_i < 0 || input_i >= H) continue;
+
+                            for (int kj = 0; kj < kW; kj++) {
+                                int input_j = j + kj - pad_left;
+                                if (input_j < 0 || input_j >= W) continue;
+
+                                float x = f[input_i][input_j];
+                                const float *w = packed + (size_t)(ki * kW + kj) * num_kernels + k0;
+                                #pragma omp simd
+                                for (int k = 0; k < nk; k++) {
+                                    sum[k] += x * w[k];
+                                }
+                            }
+                        }
+
+                        for (int k = 0; k < nk; k++) {
+                            outputs[k0 + k][out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum[k]) : sum[k];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Hybrid MPI+OpenMP filter bank with performance statistics
+ *
+ * Applies num_kernels kernels of the same kH x kW shape to one input and
+ * produces num_kernels outputs. The row partition and the (replicated) input
+ * are shared by all kernels, so the input is distributed once and streamed
+ * through memory once; only the outputs are gathered per kernel.
+ */
+void conv2d_stride_bank_stats(float **f, int H, int W, float ***g, int num_kernels, int kH, int kW, int sH, int sW, float ***outputs, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    stats->output_elements = (long long)out_H * out_W * num_kernels;
+
+    // Every kernel has the same shape, so one partition serves the whole bank
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+
+    // Pack the kernels tap-major so one input load feeds every kernel
+    Conv2dArena *arena = conv2d_thread_arena();
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    float *packed = (float*)conv2d_arena_alloc(arena, (size_t)kH * kW * num_kernels * sizeof(float));
+    if (!packed) {
+        fprintf(stderr, "Error: Failed to allocate memory for packed kernels\n");
+        MPI_Abort(comm, 1);
+    }
+    for (int k = 0; k < num_kernels; k++) {
+        for (int ki = 0; ki < kH; ki++) {
+            for (int kj = 0; kj < kW; kj++) {
+                packed[(size_t)(ki * kW + kj) * num_kernels + k] = g[k][ki][kj];
+            }
+        }
+    }
+
+    t_comp_start = MPI_Wtime();
+    if (row_starts[rank + 1] > row_starts[rank]) {
+        conv2d_bank_rows(f, H, W, packed, num_kernels, kH, kW, sH, sW, outputs,
+                         row_starts[rank], row_starts[rank + 1]);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+    conv2d_arena_rewind(arena, mark);
+
+    // Gather every kernel's output rows to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int k = 0; k < num_kernels; k++) {
+            for (int p = 0; p < size; p++) {
+                int p_start = row_starts[p];
+                int p_rows = row_starts[p + 1] - p_start;
+
+                for (int i = 0; i < p_rows; i++) {
+                    MPI_Bcast(outputs[k][p_start + i], out_W, MPI_FLOAT, p, comm);
+                    stats->num_communications++;
+                    stats->bytes_communicated += (long long)out_W * sizeof(float);
+                }
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP filter bank: outputs[k] = conv(f, g[k]) for every kernel
+ */
+void conv2d_stride_bank(float **f, int H, int W, float ***g, int num_kernels, int kH, int kW, int sH, int sW, float ***outputs, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_bank_stats(f, H, W, g, num_kernels, kH, kW, sH, sW, outputs, comm, &stats);
+}
+
+/**
+ * Compare directory entry names for a stable kernel order
+ */
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Append one kernel to a growing bank, checking it matches the bank's shape
+ */
+static int bank_append(float ****kernels, int *num_kernels, int *capacity, int *kH, int *kW,
+                       float **kernel, int rows, int cols, const char *source) {
+    if (*num_kernels == 0) {
+        *kH = rows;
+        *kW = cols;
+    } else if (rows != *kH || cols != *kW) {
+        fprintf(stderr, "Error: Kernel in %s is %dx%d, expected %dx%d\n", source, rows, cols, *kH, *kW);
+        free_2d_array(kernel, rows);
+        return -1;
+    }
+
+    if (*num_kernels == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 8;
+        float ***grown = (float***)realloc(*kernels, new_capacity * sizeof(float**));
+        if (!grown) {
+            fprintf(stderr, "Error: Failed to allocate memory for kernel bank\n");
+            free_2d_array(kernel, rows);
+            return -1;
+        }
+        *kernels = grown;
+        *capacity = new_capacity;
+    }
+    (*kernels)[(*num_kernels)++] = kernel;
+    return 0;
+}
+
+/**
+ * Read a kernel bank from either
+ *   - a multi-kernel file: several arrays in the usual text format, back to back
+ *   - a directory: every regular file in it holds one kernel (sorted by name)
+ * All kernels must have the same dimensions. Returns 0 on success.
+ */
+int read_kernel_bank(const char *path, float ****kernels, int *num_kernels, int *kH, int *kW) {
+    int capacity = 0;
+    *kernels = NULL;
+    *num_kernels = 0;
+
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open kernel bank %s\n", path);
+        return -1;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "Error: Cannot open kernel directory %s\n", path);
+            return -1;
+        }
+
+        // Collect and sort the file names first
+        char **names = NULL;
+        int num_names = 0, names_capacity = 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+
+            char full[4096];
+            snprintf(full, sizeof(full), "%s/%s", path, entry->d_name);
+            struct stat entry_st;
+            if (stat(full, &entry_st) != 0 || !S_ISREG(entry_st.st_mode)) continue;
+
+            if (num_names == names_capacity) {
+                int new_capacity = names_capacity ? names_capacity * 2 : 16;
+                char **grown = (char**)realloc(names, new_capacity * sizeof(char*));
+                if (!grown) break;
+                names = grown;
+                names_capacity = new_capacity;
+            }
+            char *name = strdup(full);
+            if (!name) break;
+            names[num_names++] = name;
+        }
+        int listed = entry == NULL;
+        closedir(dir);
+        if (!listed) {
+            fprintf(stderr, "Error: Failed to allocate memory for kernel bank\n");
+            for (int n = 0; n < num_names; n++) free(names[n]);
+            free(names);
+            return -1;
+        }
+        if (num_names > 0) qsort(names, num_names, sizeof(char*), compare_names);
+
+        int status = 0;
+        for (int n = 0; n < num_names; n++) {
+            float **kernel;
+            int rows, cols;
+            if (status == 0) {
+                if (read_array_from_file(names[n], &kernel, &rows, &cols) != 0 ||
+                    bank_append(kernels, num_kernels, &capacity, kH, kW, kernel, rows, cols, names[n]) != 0) {
+                    status = -1;
+                }
+            }
+            free(names[n]);
+        }
+        free(names);
+
+        if (status != 0 || *num_kernels == 0) {
+            if (*num_kernels == 0) fprintf(stderr, "Error: No kernels found in %s\n", path);
+            free_kernel_bank(*kernels, *num_kernels, *kH);
+            *kernels = NULL;
+            *num_kernels = 0;
+            return -1;
+        }
+        return 0;
+    }
+
+    // Multi-kernel file: read arrays until end of file
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return -1;
+    }
+
+    int rows, cols, status = 0;
+    while (fscanf(file, "%d %d", &rows, &cols) == 2) {
+        if (rows <= 0 || cols <= 0) {
+            fprintf(stderr, "Error: Invalid kernel dimensions in %s: %dx%d\n", path, rows, cols);
+            status = -1;
+            break;
+        }
+        float **kernel = allocate_2d_array(rows, cols);
+        if (!kernel) {
+            fprintf(stderr, "Error: Failed to allocate memory for kernel bank\n");
+            status = -1;
+            break;
+        }
+
+        int ok = 1;
+        for (int i = 0; i < rows && ok; i++) {
+            for (int j = 0; j < cols && ok; j++) {
+                if (fscanf(file, "%f", &kernel[i][j]) != 1) {
+                    fprintf(stderr, "Error: Cannot read kernel %d element [%d][%d] from %s\n",
+                            *num_kernels, i, j, path);
+                    ok = 0;
+                }
+            }
+        }
+        if (!ok) {
+            free_2d_array(kernel, rows);
+            status = -1;
+            break;
+        }
+        if (bank_append(kernels, num_kernels, &capacity, kH, kW, kernel, rows, cols, path) != 0) {
+            status = -1;
+            break;
+        }
+    }
+    int at_end = feof(file);
+    fclose(file);
+
+    // A partly read kernel also ends at end of file, so check the status too
+    if (status != 0 || !at_end || *num_kernels == 0) {
+        if (status == 0 && !at_end) fprintf(stderr, "Error: Unexpected data in kernel bank %s\n", path);
+        else if (status == 0) fprintf(stderr, "Error: No kernels found in %s\n", path);
+        free_kernel_bank(*kernels, *num_kernels, *kH);
+        *kernels = NULL;
+        *num_kernels = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Free a kernel bank (or a bank of outputs) of num_kernels arrays with rows rows each
+ */
+void free_kernel_bank(float ***kernels, int num_kernels, int rows) {
+    if (kernels) {
+        for (int k = 0; k < num_kernels; k++) {
+            free_2d_array(kernels[k], rows);
+        }
+        free(kernels);
+    }
+}
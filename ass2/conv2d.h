@@ -4,15 +4,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
+#include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 #include <omp.h>
 #include <mpi.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 /**
  * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
  */
 
+// OpenMP tiling and schedule parameters chosen by the autotuner
+typedef struct {
+    int block_size;        // Row block for conv2d_omp_blocked (0 = built-in heuristic)
+    omp_sched_t schedule;  // Loop schedule for the stride kernels
+    int chunk_size;        // Chunk size for the stride kernels
+} TuneParams;
+
 // Function prototypes for convolution operations
 // Serial (single-threaded) implementations
 void conv2d_serial(float **f, int H, int W, float **g, int kH, int kW, float **output);
@@ -30,9 +41,33 @@ void conv2d_stride(float **f, int H, int W, float **g, int kH, int kW, int sH, i
 float** allocate_2d_array(int rows, int cols);
 void free_2d_array(float **array, int rows);
 
-// I/O functions
+// Element types for storage and binary files
+#define CONV2D_DTYPE_F32  0
+#define CONV2D_DTYPE_F16  1  // IEEE half
+#define CONV2D_DTYPE_BF16 2  // bfloat16 (upper half of a float32)
+
+// Binary array file: this header, then rows * cols values row-major
+#define CONV2D_BIN_MAGIC "CV2B"
+#define CONV2D_BIN_VERSION 1
+typedef struct {
+    char magic[4];      // CONV2D_BIN_MAGIC
+    uint8_t version;
+    uint8_t dtype;      // CONV2D_DTYPE_*
+    uint16_t reserved;
+    int32_t rows;
+    int32_t cols;
+} Conv2dBinHeader;
+
+// Binary volume file: the same header with version CONV2D_BIN_VERSION_3D,
+// then int32_t depth, then depth * rows * cols values (slice, row, column)
+#define CONV2D_BIN_VERSION_3D 2
+
+// I/O functions (read_array_from_file accepts text and binary files)
 int read_array_from_file(const char *filename, float ***array, int *rows, int *cols);
+int read_array_dims(const char *filename, int *rows, int *cols);
 int write_array_to_file(const char *filename, float **array, int rows, int cols);
+int write_array_to_binary(const char *filename, float **array, int rows, int cols, int dtype);
+int is_binary_filename(const char *filename);
 
 // Random array generation
 void generate_random_array(float **array, int rows, int cols);
@@ -40,6 +75,11 @@ void generate_random_array(float **array, int rows, int cols);
 // Performance analysis utilities
 void performance_analysis_threads(float **f, int H, int W, float **g, int kH, int kW);
 
+// Autotuning with a persistent on-disk cache keyed by CPU model
+int conv2d_autotune(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int force, const char *cache_path, TuneParams *result);
+void conv2d_set_tune_params(const TuneParams *params);
+void conv2d_get_tune_params(TuneParams *params);
+
 // Timing utilities
 double get_time_diff(struct timespec start, struct timespec end);
 
@@ -53,10 +93,390 @@ typedef struct {
     long long output_elements;
     long long bytes_communicated;
     int num_communications;
+    double load_imbalance_before;  // Equal-band split, (slowest / ideal) - 1
+    double load_imbalance_after;   // Cost-weighted split, (slowest / ideal) - 1
+    int chunks_claimed;            // Dynamic mode: chunks computed by this rank
+    double idle_time;              // Dynamic mode: time waiting for other ranks
+    long long scratch_allocs;      // Arena allocations made during the call
+    long long scratch_bytes;       // Bytes handed out by the arena during the call
+    long long heap_allocs;         // Of which needed malloc (0 once the arena is warm)
 } PerfStats;
 
+// Arena allocator for per-call scratch: aligned bump allocation, released by
+// rewinding to a mark; one arena per thread (conv2d_thread_arena)
+typedef struct {
+    char *base;             // Persistent block
+    size_t capacity;
+    size_t used;
+    size_t high_water;      // Peak demand (block + overflow) since creation
+    void *overflow;         // malloc'd buffers for requests that did not fit
+    size_t overflow_bytes;
+    long long allocs;       // Running totals
+    long long bytes;
+    long long heap_allocs;
+} Conv2dArena;
+
+typedef struct {
+    size_t used;
+    void *overflow;
+} Conv2dArenaMark;
+
+void conv2d_arena_init(Conv2dArena *arena, size_t capacity);
+void conv2d_arena_free(Conv2dArena *arena);
+void* conv2d_arena_alloc(Conv2dArena *arena, size_t bytes);
+float** conv2d_arena_alloc_2d(Conv2dArena *arena, int rows, int cols);
+Conv2dArenaMark conv2d_arena_mark(const Conv2dArena *arena);
+void conv2d_arena_rewind(Conv2dArena *arena, Conv2dArenaMark mark);
+void conv2d_arena_reset(Conv2dArena *arena);
+Conv2dArena* conv2d_thread_arena(void);
+void conv2d_arena_release_all(void);
+void conv2d_arena_stats_begin(const Conv2dArena *arena, PerfStats *stats);
+void conv2d_arena_stats_end(const Conv2dArena *arena, PerfStats *stats);
+
+// Cost-weighted row partitioning across ranks
+void conv2d_partition_rows(int H, int W, int kH, int kW, int sH, int sW, int nparts, const double *weights, int *row_starts);
+double conv2d_partition_imbalance(int H, int W, int kH, int kW, int sH, int sW, int nparts, const double *weights, const int *row_starts);
+void conv2d_set_rank_weights(const double *weights, int count);
+const double* conv2d_get_rank_weights(int size);
+#define CALIBRATION_KERNEL 7  // Edge of the calibration kernel
+void conv2d_calibration_kernel(float **g, int k);
+int conv2d_calibrate_rank_weights(MPI_Comm comm);
+int* conv2d_create_row_partition(int H, int W, int kH, int kW, int sH, int sW, int size, MPI_Comm comm);
+void conv2d_record_partition_stats(int H, int W, int kH, int kW, int sH, int sW, int size, const int *row_starts, PerfStats *stats);
+void conv2d_stats_begin(PerfStats *stats);
+
 // MPI implementations with performance statistics
 void conv2d_mpi_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats);
 void conv2d_stride_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats);
 
+// Dynamic load balancing: ranks claim row chunks through an MPI RMA counter
+#define DYNAMIC_CHUNKS_PER_RANK 16
+void conv2d_stride_dynamic(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm);
+void conv2d_stride_dynamic_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, MPI_Comm comm, PerfStats *stats);
+
+// Filter bank: many same-shaped kernels applied to one input in a single pass
+void conv2d_stride_bank(float **f, int H, int W, float ***g, int num_kernels, int kH, int kW, int sH, int sW, float ***outputs, MPI_Comm comm);
+void conv2d_stride_bank_stats(float **f, int H, int W, float ***g, int num_kernels, int kH, int kW, int sH, int sW, float ***outputs, MPI_Comm comm, PerfStats *stats);
+int read_kernel_bank(const char *path, float ****kernels, int *num_kernels, int *kH, int *kW);
+void free_kernel_bank(float ***kernels, int num_kernels, int rows);
+
+// Multi-channel layer (NHWC activations, OIHW weights) and depthwise variant
+#define MC_SPLIT_SPATIAL  0
+#define MC_SPLIT_CHANNELS 1
+void conv2d_mc_stride(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out);
+void conv2d_mc_depthwise(const float *in, int H, int W, int C, const float *weights, int kH, int kW, int sH, int sW, float *out);
+void conv2d_mc_stride_mpi(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out, int depthwise, int split, MPI_Comm comm);
+void conv2d_mc_stride_mpi_stats(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out, int depthwise, int split, MPI_Comm comm, PerfStats *stats);
+void conv2d_nchw_to_nhwc(const float *src, int C, int H, int W, float *dst);
+void conv2d_nhwc_to_nchw(const float *src, int C, int H, int W, float *dst);
+
+// Batched throughput mode for many independent images
+#define BATCH_SPLIT_PIXELS (2048LL * 2048LL)  // Larger images use the row split
+
+typedef struct {
+    int images;               // Images completed
+    int small_images;         // Processed whole by one rank
+    int large_images;         // Processed by all ranks with the row split
+    int failures;             // Inputs that could not be read
+    double total_time;
+    double images_per_second;
+    double latency_mean;      // Per-image read + convolve + write time
+    double latency_p50;
+    double latency_p90;
+    double latency_p99;
+    double latency_max;
+} BatchStats;
+
+int conv2d_batch_run(const char *source, float **g, int kH, int kW, int sH, int sW, long long split_pixels, const char *output_dir, MPI_Comm comm, BatchStats *stats);
+
+// Plan/execute API: decomposition, buffers, kernel factorization and
+// persistent MPI requests are set up once per shape
+typedef struct Conv2dPlan Conv2dPlan;
+#define CONV2D_PLAN_DEFAULT       0
+#define CONV2D_PLAN_NO_SEPARABLE  1  // Always use the direct engine
+#define CONV2D_PLAN_NO_GATHER     2  // Each rank keeps only its own output rows
+Conv2dPlan* conv2d_plan_create(int H, int W, int kH, int kW, int sH, int sW, MPI_Comm comm, unsigned flags);
+void conv2d_execute(Conv2dPlan *plan, float **f, float **g, float **output);
+void conv2d_plan_destroy(Conv2dPlan *plan);
+void conv2d_plan_print(const Conv2dPlan *plan);
+
+// Half-precision storage (fp16/bf16) with fp32 accumulation
+int conv2d_dtype_from_name(const char *name);
+const char* conv2d_dtype_name(int dtype);
+size_t conv2d_dtype_size(int dtype);
+int conv2d_half_has_f16c(void);
+void conv2d_float_to_half(const float *src, uint16_t *dst, size_t n, int dtype);
+void conv2d_half_to_float(const uint16_t *src, float *dst, size_t n, int dtype);
+void conv2d_stride_half(const uint16_t *f, int H, int W, int dtype, float **g, int kH, int kW, int sH, int sW, uint16_t *output, MPI_Comm comm);
+void conv2d_stride_half_stats(const uint16_t *f, int H, int W, int dtype, float **g, int kH, int kW, int sH, int sW, uint16_t *output, MPI_Comm comm, PerfStats *stats);
+
+// Quantized convolution: 8-bit input, int8/int16 weights, int32 accumulation
+#define CONV2D_QOUT_FLOAT 0  // acc * input_scale * weight scale
+#define CONV2D_QOUT_U8    1  // requantized, saturated to [0, 255]
+#define CONV2D_QOUT_I8    2  // requantized, saturated to [-128, 127]
+typedef struct {
+    int kH, kW;
+    int bits;      // 8 or 16
+    float scale;   // float weight = scale * q
+    int16_t *q;    // kH x kW quantized weights
+} QuantKernel;
+int conv2d_quantize_kernel(float **g, int kH, int kW, int bits, QuantKernel *qk);
+void conv2d_free_quant_kernel(QuantKernel *qk);
+void conv2d_quantize_input(const float *src, uint8_t *dst, size_t n, float scale, int input_signed);
+int conv2d_quant_has_avx2(void);
+void conv2d_quant_stride(const uint8_t *f, int H, int W, int input_signed, float input_scale, const QuantKernel *qk, int sH, int sW, int out_type, float out_scale, void *output, MPI_Comm comm);
+void conv2d_quant_stride_stats(const uint8_t *f, int H, int W, int input_signed, float input_scale, const QuantKernel *qk, int sH, int sW, int out_type, float out_scale, void *output, MPI_Comm comm, PerfStats *stats);
+
+// Sparse kernels: nonzero taps compiled to a per-row tap list
+#define SPARSE_DENSITY_THRESHOLD 0.5  // Kernels at or below this density use the tap list
+typedef struct {
+    int kH, kW;
+    int nnz;          // Nonzero taps
+    double density;   // nnz / (kH * kW)
+    int num_rows;     // Kernel rows with at least one nonzero tap
+    int *row_dy;      // Kernel row of each of those rows
+    int *row_first;   // Taps of row r are [row_first[r], row_first[r + 1])
+    int *tap_dx;      // Kernel column of each tap
+    float *tap_w;     // Weight of each tap
+} SparseKernel;
+void conv2d_set_sparse_threshold(double threshold);
+double conv2d_get_sparse_threshold(void);
+double conv2d_kernel_density(float **g, int kH, int kW);
+int conv2d_sparse_compile(float **g, int kH, int kW, SparseKernel *sk);
+void conv2d_sparse_free(SparseKernel *sk);
+int conv2d_sparse_select(float **g, int kH, int kW, SparseKernel *sk);
+void conv2d_sparse_row(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, int out_i, float *out, int col_start, int col_end);
+void conv2d_sparse_block(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, float **output, int row_start, int row_end, int col_start, int col_end);
+void conv2d_sparse_rows(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, float **output, int row_start, int row_end);
+
+// Box and block-constant kernels: constant rectangles summed from a
+// summed-area table of the rows a band reads
+#define BOX_MAX_BLOCKS 8      // Kernels of at most this many rectangles may use the table
+#define BOX_BUILD_COST 6      // Modelled cost of building the table, per input pixel
+#define BOX_BAND_ROWS 1024    // Input rows per table chunk (plus the kernel halo)
+typedef struct {
+    int kH, kW;
+    int nnz;          // Taps covered by the rectangles
+    int num_blocks;   // Constant rectangles
+    int *block_y;     // Kernel row of each rectangle's top
+    int *block_x;     // Kernel column of each rectangle's left edge
+    int *block_h;
+    int *block_w;
+    float *block_v;   // Weight of each rectangle
+} BoxKernel;
+void conv2d_set_box_max_blocks(int max_blocks);
+int conv2d_get_box_max_blocks(void);
+int conv2d_box_compile(float **g, int kH, int kW, int max_blocks, BoxKernel *bk);
+void conv2d_box_free(BoxKernel *bk);
+int conv2d_box_select(float **g, int kH, int kW, int sH, int sW, BoxKernel *bk);
+void conv2d_box_rows(float **f, int f_row0, int H, int W, const BoxKernel *bk, int sH, int sW, float **output, int row_start, int row_end);
+
+// Zero-tile skipping for mostly-zero inputs (occupancy bitmap + prefix sums)
+#define CONV2D_SKIP_TILE 16  // Default tile edge in pixels
+typedef struct {
+    int H, W, tile;
+    int tiles_y, tiles_x;
+    uint8_t *bits;        // tiles_y x tiles_x, 1 if the tile has a nonzero pixel
+    int *prefix;          // (tiles_y + 1) x (tiles_x + 1) 2D prefix sums of bits
+    int occupied;         // Tiles with a nonzero pixel
+} OccupancyMap;
+
+typedef struct {
+    long long tiles_total;    // Output tiles of this rank
+    long long tiles_skipped;  // Of which had an all-zero receptive field
+    long long rows_skipped;   // All-zero output rows left out of the gather
+    double build_time;        // Occupancy pre-pass
+} SkipStats;
+
+int conv2d_occupancy_build(float **f, int H, int W, int tile, int row_start, int row_end, Conv2dArena *arena, OccupancyMap *occ);
+int conv2d_occupancy_any(const OccupancyMap *occ, int y0, int y1, int x0, int x1);
+long long conv2d_bcast_nonzero_rows(float **f, int H, int W, int root, MPI_Comm comm);
+void conv2d_stride_skip(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int tile, float **output, MPI_Comm comm);
+void conv2d_stride_skip_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int tile, float **output, MPI_Comm comm, PerfStats *stats, SkipStats *skip);
+
+// Dilated (atrous) convolution: tap (ki, kj) reads (i*sH + ki*dH, j*sW + kj*dW) - pad
+void conv2d_serial_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output);
+void conv2d_omp_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output);
+void conv2d_mpi_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm);
+void conv2d_mpi_dilated_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm, PerfStats *stats);
+void conv2d_stride_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm);
+void conv2d_stride_dilated_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm, PerfStats *stats);
+
+// Incremental recomputation of the output for changed input rectangles
+#define CONV2D_DIRTY_TILE 32  // Output tile edge used to merge dirty regions
+typedef struct {
+    int y, x;  // Top-left corner
+    int h, w;
+} Conv2dRect;
+int conv2d_dirty_output_rect(Conv2dRect r, int H, int W, int kH, int kW, int sH, int sW, Conv2dRect *out);
+long long conv2d_update(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, const Conv2dRect *dirty, int num_dirty, float **output, MPI_Comm comm);
+long long conv2d_update_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, const Conv2dRect *dirty, int num_dirty, float **output, MPI_Comm comm, PerfStats *stats);
+
+// Content-addressed on-disk result cache (LRU by mtime, bounded size)
+#define CONV2D_CACHE_VERSION 1      // Part of every key; bump to invalidate old entries
+#define CONV2D_CACHE_MAX_MB  1024   // Default size budget of a cache directory
+typedef struct {
+    void *map;            // Read-only mapping of the stored file
+    size_t map_bytes;
+    int rows, cols;
+    float **output;       // Row pointers into the mapping
+} Conv2dCacheEntry;
+int conv2d_hash_array(float **a, int rows, int cols, uint64_t *hash);
+int conv2d_cache_key(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, uint64_t *key);
+int conv2d_cache_lookup(const char *dir, uint64_t key, int rows, int cols, Conv2dCacheEntry *entry);
+void conv2d_cache_release(Conv2dCacheEntry *entry);
+int conv2d_cache_store(const char *dir, uint64_t key, float **output, int rows, int cols, long long max_bytes);
+int conv2d_cache_evict(const char *dir, long long max_bytes, uint64_t keep);
+
+// Fused epilogues: out = clamp(act(sum + bias) * scale), applied by every
+// engine at the output store, and a fused 2x2 max-pool engine
+#define CONV2D_ACT_NONE       0
+#define CONV2D_ACT_RELU       1
+#define CONV2D_ACT_LEAKY_RELU 2
+typedef struct {
+    float bias;                  // Added to every output
+    int activation;              // CONV2D_ACT_*
+    float alpha;                 // Negative slope of the leaky ReLU
+    float scale;                 // Applied after the activation
+    float clamp_min, clamp_max;  // Applied last
+} Conv2dEpilogue;
+void conv2d_epilogue_default(Conv2dEpilogue *ep);
+void conv2d_set_epilogue(const Conv2dEpilogue *ep);
+const Conv2dEpilogue* conv2d_get_epilogue(void);
+const char* conv2d_activation_name(int activation);
+int conv2d_activation_from_name(const char *name);
+void conv2d_epilogue_row(const Conv2dEpilogue *ep, float *row, int n);
+void conv2d_maxpool2x2(float **in, int rows, int cols, float **pooled);
+void conv2d_stride_pool(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **pooled, MPI_Comm comm);
+void conv2d_stride_pool_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **pooled, MPI_Comm comm, PerfStats *stats);
+
+static inline float conv2d_epilogue_value(const Conv2dEpilogue *ep, float v) {
+    v += ep->bias;
+    if (v < 0.0f) {
+        if (ep->activation == CONV2D_ACT_RELU) v = 0.0f;
+        else if (ep->activation == CONV2D_ACT_LEAKY_RELU) v *= ep->alpha;
+    }
+    v *= ep->scale;
+    v = v < ep->clamp_min ? ep->clamp_min : v;
+    return v > ep->clamp_max ? ep->clamp_max : v;
+}
+
+// Multi-layer chains: layers run depth-first over final-output tiles with
+// intermediates kept in per-thread tile buffers
+#define CONV2D_CHAIN_MAX_LAYERS 8
+#define CONV2D_CHAIN_TILE 64  // Default final-output tile edge
+typedef struct {
+    float **g;      // kH x kW kernel
+    int kH, kW;
+    int sH, sW;
+} Conv2dLayer;
+
+typedef struct {
+    long long tiles;              // Final-output tiles of this rank
+    long long macs;               // Multiply-adds of this rank (fused: with recomputed halos)
+    long long peak_bytes;         // Modelled peak working set of this rank
+    long long traffic_bytes;      // Modelled DRAM traffic of this rank
+    long long tile_buffer_bytes;  // Intermediate tile buffers per thread
+    int band_rows;                // Input rows of this rank's band (whole-chain halo)
+    int receptive_field;          // Input rows feeding one final output row
+} ChainStats;
+
+void conv2d_chain_dims(int H, int W, const Conv2dLayer *layers, int num_layers, int *dims_H, int *dims_W);
+void conv2d_chain_serial(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, float **output);
+void conv2d_chain(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, int tile, float **output, MPI_Comm comm);
+void conv2d_chain_stats(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, int tile, float **output, MPI_Comm comm, PerfStats *stats, ChainStats *chain);
+void conv2d_chain_layered_stats(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, float **output, MPI_Comm comm, PerfStats *stats, ChainStats *chain);
+
+// Fused output reductions: min, max, sum, squared deviations and a fixed-bin
+// histogram accumulated while the output is computed
+#define CONV2D_HIST_MAX_BINS 256
+#define CONV2D_HIST_BINS 16  // Default histogram bins
+typedef struct {
+    long long count;              // Values reduced
+    double min, max;
+    double sum;
+    double m2;                    // Sum of squared deviations from the mean
+    float hist_lo, hist_hi;       // Histogram range; hi falls in the last bin
+    int bins;
+    long long below, above;       // Values outside the range
+    long long hist[CONV2D_HIST_MAX_BINS];
+} Conv2dReduce;
+void conv2d_reduce_init(Conv2dReduce *red, float lo, float hi, int bins);
+void conv2d_reduce_range(float **f, int H, int W, float **g, int kH, int kW, float *lo, float *hi);
+void conv2d_reduce_rows(Conv2dReduce *red, float **a, int rows, int cols);
+void conv2d_reduce_mpi(Conv2dReduce *red, int root, MPI_Comm comm);
+void conv2d_reduce_print(const Conv2dReduce *red);
+void conv2d_stride_reduce(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, Conv2dReduce *red, MPI_Comm comm);
+void conv2d_stride_reduce_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, Conv2dReduce *red, MPI_Comm comm, PerfStats *stats);
+
+// Region-of-interest convolution: one output rectangle from the input
+// rectangle it depends on
+int conv2d_roi_input_rect(Conv2dRect roi, int H, int W, int kH, int kW, int sH, int sW, Conv2dRect *in);
+long long read_array_region(const char *filename, Conv2dRect rect, float ***array);
+void conv2d_stride_roi(float **crop, Conv2dRect in, int H, int W, float **g, int kH, int kW, int sH, int sW, Conv2dRect roi, float **output, MPI_Comm comm);
+void conv2d_stride_roi_stats(float **crop, Conv2dRect in, int H, int W, float **g, int kH, int kW, int sH, int sW, Conv2dRect roi, float **output, MPI_Comm comm, PerfStats *stats);
+
+// Iterated stride-1 convolution with temporal blocking: ghost rows
+// block * halo deep, exchanged once per block of steps
+#define CONV2D_ITER_BLOCK 4  // Default steps per ghost exchange
+#define CONV2D_ITER_TILE 64  // Default edge of the time-skewed tiles
+typedef struct {
+    int steps;
+    int block;                    // Steps per exchange after clamping to the band size
+    int blocks;                   // Exchange rounds (blocked) or steps (stepwise)
+    int ghost_rows;               // Ghost rows of this rank's band
+    long long exchanges;          // Messages of this rank, final gather excluded
+    long long exchange_bytes;     // Bytes sent by this rank, final gather excluded
+    long long macs;               // Multiply-adds of this rank (with recomputed tile halos)
+    long long traffic_bytes;      // Modelled DRAM traffic of this rank
+    long long tile_buffer_bytes;  // Tile buffers per thread
+} IterStats;
+void conv2d_iterate_serial(float **f, int H, int W, float **g, int kH, int kW, int steps, float **output);
+void conv2d_iterate(float **f, int H, int W, float **g, int kH, int kW, int steps, int block, int tile, float **output, MPI_Comm comm);
+void conv2d_iterate_stats(float **f, int H, int W, float **g, int kH, int kW, int steps, int block, int tile, float **output, MPI_Comm comm, PerfStats *stats, IterStats *iter);
+void conv2d_iterate_stepwise_stats(float **f, int H, int W, float **g, int kH, int kW, int steps, float **output, MPI_Comm comm, PerfStats *stats, IterStats *iter);
+
+// Pipelined frame streams: double-buffered bands, nonblocking scatter and
+// gather, frames spread over rank groups when they are too small to split
+#define STREAM_RANK_PIXELS (1024LL * 1024LL)  // Output pixels per rank before frames are split further
+typedef void (*Conv2dFrameFn)(int frame, float *data, int rows, int cols, void *ctx);
+typedef struct {
+    int frames;
+    int groups;                  // Rank groups the frames are spread over
+    int group_size;              // Ranks in this rank's group
+    double total_time;
+    double frames_per_second;
+    double latency_mean;         // Source call to sink return of one frame
+    double latency_p50;
+    double latency_p99;
+    double latency_max;
+    double compute_time;         // This rank: convolving
+    double wait_time;            // This rank: blocked on frame data
+    long long bytes_communicated;  // This rank: scattered and gathered
+} StreamStats;
+int conv2d_stream_groups(int H, int W, int sH, int sW, int size);
+void conv2d_stream(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW, int groups, Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm);
+void conv2d_stream_stats(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW, int groups, Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm, StreamStats *stats);
+void conv2d_stream_framewise_stats(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW, Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm, StreamStats *stats);
+
+// Backward pass: gradients of conv2d_stride with respect to input and kernel
+void conv2d_grad_input_serial(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in);
+void conv2d_grad_kernel_serial(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g);
+void conv2d_grad_input(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in, MPI_Comm comm);
+void conv2d_grad_input_stats(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in, MPI_Comm comm, PerfStats *stats);
+void conv2d_grad_kernel(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g, MPI_Comm comm);
+void conv2d_grad_kernel_stats(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g, MPI_Comm comm, PerfStats *stats);
+void conv2d_grad_check(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_out, float **grad_in, float **grad_g, int samples, double *err_in, double *err_g);
+
+// Volumetric convolution: contiguous D x H x W volumes (slice, row, column),
+// slabs of output slices per rank with halo slices from the neighbours
+#define CONV3D_TILE_D 4    // Output slices per thread tile
+#define CONV3D_TILE_H 8    // Output rows per thread tile
+#define CONV3D_TILE_W 256  // Output columns per pass over a tile
+int read_volume_from_file(const char *filename, float **volume, int *depth, int *rows, int *cols);
+int write_volume_to_binary(const char *filename, const float *volume, int depth, int rows, int cols, int dtype);
+void conv3d_serial_stride(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW, int sD, int sH, int sW, float *output);
+void conv3d_stride(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW, int sD, int sH, int sW, float *output, MPI_Comm comm);
+void conv3d_stride_stats(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW, int sD, int sH, int sW, float *output, MPI_Comm comm, PerfStats *stats);
+
 #endif // CONV2D_H
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Arena allocator for per-call scratch buffers
+ *
+ * The MPI engines used to allocate_2d_array their local input copy on every
+ * call (one malloc per row) and free it again at the end, so repeated calls
+ * paid for thousands of mallocs and freshly zeroed pages each time. An arena
+ * hands out 64-byte aligned slices of one persistent block by bumping an
+ * offset; rewinding to a mark (or resetting) releases everything allocated
+ * since in O(1). Requests that do not fit spill to individually malloc'd
+ * overflow buffers, and the next rewind to empty grows the block to the
+ * high-water mark, so steady-state calls make no heap allocations at all.
+ *
+ * Every thread has its own arena (conv2d_thread_arena), which doubles as the
+ * per-thread pool for tile scratch inside OpenMP regions. The thread that
+ * calls an engine is also OpenMP thread 0 of its parallel regions, so code
+ * must rewind to its own mark rather than reset an arena it did not start.
+ */
+
+// Alignment of every arena slice (one cache line, covers AVX-512 loads)
+#define ARENA_ALIGN 64
+// Granularity of block growth
+#define ARENA_GROW_STEP (64 * 1024)
+
+// Header in front of each overflow buffer, chaining them newest first
+typedef struct ArenaOverflow {
+    struct ArenaOverflow *next;
+    size_t bytes;
+} ArenaOverflow;
+
+#define ARENA_HEADER (((sizeof(ArenaOverflow) + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN)
+
+static _Thread_local Conv2dArena thread_arena;
+
+static size_t align_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+/**
+ * Initialise an arena with an initial block of capacity bytes (may be 0)
+ */
+void conv2d_arena_init(Conv2dArena *arena, size_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+    if (capacity > 0) {
+        capacity = align_up(capacity, ARENA_GROW_STEP);
+        void *block = NULL;
+        if (posix_memalign(&block, ARENA_ALIGN, capacity) == 0) {
+            arena->base = (char*)block;
+            arena->capacity = capacity;
+            arena->heap_allocs++;
+        }
+    }
+}
+
+/**
+ * Release the arena's block and any overflow buffers
+ */
+void conv2d_arena_free(Conv2dArena *arena) {
+    ArenaOverflow *node = (ArenaOverflow*)arena->overflow;
+    while (node) {
+        ArenaOverflow *next = node->next;
+        free(node);
+        node = next;
+    }
+    free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
+
+/**
+ * Allocate bytes from the arena, 64-byte aligned. Contents are uninitialised.
+ * Returns NULL only if an overflow allocation fails.
+ */
+void* conv2d_arena_alloc(Conv2dArena *arena, size_t bytes) {
+    bytes = align_up(bytes > 0 ? bytes : 1, ARENA_ALIGN);
+    arena->allocs++;
+    arena->bytes += (long long)bytes;
+
+    void *ptr;
+    if (arena->used + bytes <= arena->capacity) {
+        ptr = arena->base + arena->used;
+        arena->used += bytes;
+    } else {
+        void *block = NULL;
+        if (posix_memalign(&block, ARENA_ALIGN, ARENA_HEADER + bytes) != 0) return NULL;
+        ArenaOverflow *node = (ArenaOverflow*)block;
+        node->next = (ArenaOverflow*)arena->overflow;
+        node->bytes = bytes;
+        arena->overflow = node;
+        arena->overflow_bytes += bytes;
+        arena->heap_allocs++;
+        ptr = (char*)block + ARENA_HEADER;
+    }
+
+    size_t demand = arena->used + arena->overflow_bytes;
+    if (demand > arena->high_water) arena->high_water = demand;
+    return ptr;
+}
+
+/**
+ * Allocate a rows x cols float array from the arena, laid out like
+ * allocate_2d_array (row pointers) but contiguous, with every row padded
+ * to the arena alignment. Released by rewinding, never by free_2d_array.
+ */
+float** conv2d_arena_alloc_2d(Conv2dArena *arena, int rows, int cols) {
+    size_t stride = align_up((size_t)cols * sizeof(float), ARENA_ALIGN);
+    float **array = (float**)conv2d_arena_alloc(arena, (size_t)rows * sizeof(float*));
+    char *data = (char*)conv2d_arena_alloc(arena, (size_t)rows * stride);
+    if (!array || !data) return NULL;
+    for (int i = 0; i < rows; i++) {
+        array[i] = (float*)(data + (size_t)i * stride);
+    }
+    return array;
+}
+
+Conv2dArenaMark conv2d_arena_mark(const Conv2dArena *arena) {
+    Conv2dArenaMark mark = { arena->used, arena->overflow };
+    return mark;
+}
+
+/**
+ * Release everything allocated since mark. When the arena becomes empty and
+ * the last calls spilled to overflow buffers, the block is regrown to the
+ * high-water mark so the next call of the same size fits without malloc.
+ */
+void conv2d_arena_rewind(Conv2dArena *arena, Conv2dArenaMark mark) {
+    ArenaOverflow *node = (ArenaOverflow*)arena->overflow;
+    while (node && node != (ArenaOverflow*)mark.overflow) {
+        ArenaOverflow *next = node->next;
+        arena->overflow_bytes -= node->bytes;
+        free(node);
+        node = next;
+    }
+    arena->overflow = node;
+    arena->used = mark.used;
+
+    if (arena->used == 0 && !arena->overflow && arena->high_water > arena->capacity) {
+        size_t capacity = align_up(arena->high_water, ARENA_GROW_STEP);
+        void *block = NULL;
+        if (posix_memalign(&block, ARENA_ALIGN, capacity) == 0) {
+            free(arena->base);
+            arena->base = (char*)block;
+            arena->capacity = capacity;
+            arena->heap_allocs++;
+        }
+    }
+}
+
+/**
+ * Release every allocation (explicit reset between calls)
+ */
+void conv2d_arena_reset(Conv2dArena *arena) {
+    Conv2dArenaMark empty = { 0, NULL };
+    conv2d_arena_rewind(arena, empty);
+}
+
+/**
+ * The calling thread's arena (per-thread pool inside OpenMP regions)
+ */
+Conv2dArena* conv2d_thread_arena(void) {
+    return &thread_arena;
+}
+
+/**
+ * Free the arenas of the calling thread and its OpenMP team. The team's
+ * threads outlive every parallel region, so their blocks would otherwise
+ * stay allocated until exit. Call once no engine is running (before
+ * MPI_Finalize); the arenas start empty again if used afterwards.
+ */
+void conv2d_arena_release_all(void) {
+    #pragma omp parallel
+    conv2d_arena_free(conv2d_thread_arena());
+    conv2d_arena_free(conv2d_thread_arena());
+}
+
+/**
+ * Snapshot the arena counters before a call
+ */
+void conv2d_arena_stats_begin(const Conv2dArena *arena, PerfStats *stats) {
+    stats->scratch_allocs = -arena->allocs;
+    stats->scratch_bytes = -arena->bytes;
+    stats->heap_allocs = -arena->heap_allocs;
+}
+
+/**
+ * Turn the snapshot into the allocations made during the call
+ */
+void conv2d_arena_stats_end(const Conv2dArena *arena, PerfStats *stats) {
+    stats->scratch_allocs += arena->allocs;
+    stats->scratch_bytes += arena->bytes;
+    stats->heap_allocs += arena->heap_allocs;
+}
@@ -0,0 +1,368 @@
+#include "conv2d.h"
+#include <math.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Backward pass: gradients with respect to the input and the kernel
+ *
+ * For out = conv2d_stride(f, g) and an upstream gradient grad_out (same
+ * shape as out):
+ * - grad_in[y][x] = sum of g[ki][kj] * grad_out[i][j] over every output
+ *   (i, j) that read f[y][x] through tap (ki, kj). This is the transposed
+ *   strided convolution. It is computed as a gather: each input row y picks
+ *   the kernel rows ki with (y + pad_top - ki) divisible by sH, and each of
+ *   its nonzero taps adds one strided run of grad_out row i. So every grad_in
+ *   row is written by exactly one thread, with no atomics, and MPI ranks
+ *   split the input rows like the forward engines split the output rows.
+ * - grad_g[ki][kj] = sum over all outputs of grad_out[i][j] * f[input of
+ *   (i, j) at tap (ki, kj)], a correlation of f with grad_out reduced over
+ *   the image. Ranks split the output rows, threads accumulate per-thread
+ *   partial kernels in double precision (OpenMP array reduction), and the
+ *   rank partials are summed with MPI_Allreduce.
+ *
+ * The epilogue is not part of the differentiated function: these are the
+ * gradients of the plain convolution.
+ */
+
+/**
+ * Naive grad_in: scatter every grad_out value through every tap
+ */
+void conv2d_grad_input_serial(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) grad_in[y][x] = 0.0f;
+    }
+    for (int i = 0; i < out_H; i++) {
+        for (int j = 0; j < out_W; j++) {
+            for (int ki = 0; ki < kH; ki++) {
+                for (int kj = 0; kj < kW; kj++) {
+                    int y = i * sH + ki - pad_top;
+                    int x = j * sW + kj - pad_left;
+                    if (y >= 0 && y < H && x >= 0 && x < W) {
+                        grad_in[y][x] += g[ki][kj] * grad_out[i][j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Naive grad_g: one pass over the outputs per tap
+ */
+void conv2d_grad_kernel_serial(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            double sum = 0.0;
+            for (int i = 0; i < out_H; i++) {
+                for (int j = 0; j < out_W; j++) {
+                    int y = i * sH + ki - pad_top;
+                    int x = j * sW + kj - pad_left;
+                    if (y >= 0 && y < H && x >= 0 && x < W) {
+                        sum += (double)grad_out[i][j] * f[y][x];
+                    }
+                }
+            }
+            grad_g[ki][kj] = (float)sum;
+        }
+    }
+}
+
+/**
+ * grad_in row y by gather from grad_out (tap list of g)
+ */
+static void grad_input_row(float **grad_out, int out_H, int out_W, const SparseKernel *sk, int sH, int sW,
+                           int W, int y, float *dst) {
+    int pad_top = (sk->kH - 1) / 2;
+    int pad_left = (sk->kW - 1) / 2;
+    for (int x = 0; x < W; x++) dst[x] = 0.0f;
+
+    for (int r = 0; r < sk->num_rows; r++) {
+        int t_i = y + pad_top - sk->row_dy[r];
+        if (t_i < 0 || t_i % sH != 0) continue;
+        int i = t_i / sH;
+        if (i >= out_H) continue;
+        const float *src = grad_out[i];
+
+        for (int t = sk->row_first[r]; t < sk->row_first[r + 1]; t++) {
+            // Output column j feeds x = j * sW + dx
+            int dx = sk->tap_dx[t] - pad_left;
+            float w = sk->tap_w[t];
+            int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+            int hi = W - 1 - dx >= 0 ? (W - 1 - dx) / sW + 1 : 0;
+            if (hi > out_W) hi = out_W;
+
+            if (sW == 1) {
+                float *d = dst + dx;
+                #pragma omp simd
+                for (int j = lo; j < hi; j++) {
+                    d[j] += w * src[j];
+                }
+            } else {
+                #pragma omp simd
+                for (int j = lo; j < hi; j++) {
+                    dst[j * sW + dx] += w * src[j];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Hybrid MPI+OpenMP gradient with respect to the input (transposed strided
+ * convolution of grad_out with g), with performance statistics
+ *
+ * H x W is the forward input size; grad_out (out_H x out_W) and g must be
+ * valid on every rank; grad_in (H x W) is complete on every rank afterwards.
+ */
+void conv2d_grad_input_stats(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    stats->output_elements = (long long)H * W;
+
+    // Input rows by modelled cost: one stride-1 output row per input row
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, 1, 1, size, comm);
+    SparseKernel sk;
+    if (conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for input gradient\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, 1, 1, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime)
+    for (int y = local_start; y < local_end; y++) {
+        grad_input_row(grad_out, out_H, out_W, &sk, sH, sW, W, y, grad_in[y]);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather the gradient rows to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            for (int y = row_starts[p]; y < row_starts[p + 1]; y++) {
+                MPI_Bcast(grad_in[y], W, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)W * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    conv2d_sparse_free(&sk);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP gradient with respect to the input (see
+ * conv2d_grad_input_stats)
+ */
+void conv2d_grad_input(float **grad_out, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_in, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_grad_input_stats(grad_out, H, W, g, kH, kW, sH, sW, grad_in, comm, &stats);
+}
+
+/**
+ * Hybrid MPI+OpenMP gradient with respect to the kernel, with performance
+ * statistics
+ *
+ * f (H x W) and grad_out (out_H x out_W) must be valid on every rank;
+ * grad_g (kH x kW) is complete on every rank afterwards.
+ */
+void conv2d_grad_kernel_stats(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+    int out_W = (W + sW - 1) / sW;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int taps = kH * kW;
+    stats->output_elements = taps;
+
+    // Output rows by modelled cost, as for the forward pass
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    double *acc = (double*)calloc(taps, sizeof(double));
+    if (!acc) {
+        fprintf(stderr, "Error: Failed to allocate memory for kernel gradient\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    // Per-thread partial kernels, summed by the reduction clause
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime) reduction(+:acc[:taps])
+    for (int i = local_start; i < local_end; i++) {
+        const float *d = grad_out[i];
+        for (int ki = 0; ki < kH; ki++) {
+            int y = i * sH + ki - pad_top;
+            if (y < 0 || y >= H) continue;
+            const float *src = f[y];
+
+            for (int kj = 0; kj < kW; kj++) {
+                int dx = kj - pad_left;
+                int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+                int hi = W - 1 - dx >= 0 ? (W - 1 - dx) / sW + 1 : 0;
+                if (hi > out_W) hi = out_W;
+
+                // Row dot product in float, accumulated in double per row
+                float sum = 0.0f;
+                if (sW == 1) {
+                    const float *s = src + dx;
+                    #pragma omp simd reduction(+:sum)
+                    for (int j = lo; j < hi; j++) {
+                        sum += d[j] * s[j];
+                    }
+                } else {
+                    #pragma omp simd reduction(+:sum)
+                    for (int j = lo; j < hi; j++) {
+                        sum += d[j] * src[j * sW + dx];
+                    }
+                }
+                acc[ki * kW + kj] += sum;
+            }
+        }
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Sum the rank partials
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        MPI_Allreduce(MPI_IN_PLACE, acc, taps, MPI_DOUBLE, MPI_SUM, comm);
+        stats->num_communications++;
+        stats->bytes_communicated += (long long)taps * sizeof(double);
+        stats->communication_time = MPI_Wtime() - t_comm_start;
+    }
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) grad_g[ki][kj] = (float)acc[ki * kW + kj];
+    }
+
+    free(acc);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP gradient with respect to the kernel (see
+ * conv2d_grad_kernel_stats)
+ */
+void conv2d_grad_kernel(float **f, int H, int W, float **grad_out, int kH, int kW, int sH, int sW, float **grad_g, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_grad_kernel_stats(f, H, W, grad_out, kH, kW, sH, sW, grad_g, comm, &stats);
+}
+
+/**
+ * Loss L = sum(out * grad_out) restricted to output rows [i0, i1) and
+ * columns [j0, j1), with the forward convolution evaluated in double
+ */
+static double grad_check_loss(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW,
+                              float **grad_out, int i0, int i1, int j0, int j1) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    double loss = 0.0;
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            double sum = 0.0;
+            for (int ki = 0; ki < kH; ki++) {
+                int y = i * sH + ki - pad_top;
+                if (y < 0 || y >= H) continue;
+                for (int kj = 0; kj < kW; kj++) {
+                    int x = j * sW + kj - pad_left;
+                    if (x >= 0 && x < W) sum += (double)g[ki][kj] * f[y][x];
+                }
+            }
+            loss += sum * grad_out[i][j];
+        }
+    }
+    return loss;
+}
+
+/**
+ * Central finite-difference check of grad_in at samples pseudo-random input
+ * pixels and of grad_g at every tap, for L = sum(conv2d_stride(f, g) *
+ * grad_out). Only the outputs a perturbed value reaches are re-evaluated,
+ * in double, so the differences are not drowned by rounding of the whole
+ * sum. Returns the largest relative errors |analytic - numeric| /
+ * max(1, |numeric|) in *err_in and *err_g. A NULL grad_g skips the taps,
+ * which cost a full-image loss each.
+ */
+void conv2d_grad_check(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **grad_out,
+                       float **grad_in, float **grad_g, int samples, double *err_in, double *err_g) {
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    const float eps = 1e-2f;
+    *err_in = 0.0;
+    *err_g = 0.0;
+
+    unsigned int seed = 12345u;
+    for (int n = 0; n < samples; n++) {
+        seed = seed * 1103515245u + 12345u;
+        int y = (int)((seed >> 8) % (unsigned int)H);
+        seed = seed * 1103515245u + 12345u;
+        int x = (int)((seed >> 8) % (unsigned int)W);
+
+        // Outputs that read f[y][x]
+        Conv2dRect in_rect = { y, x, 1, 1 }, out_rect;
+        if (!conv2d_dirty_output_rect(in_rect, H, W, kH, kW, sH, sW, &out_rect)) continue;
+        int i0 = out_rect.y, i1 = out_rect.y + out_rect.h;
+        int j0 = out_rect.x, j1 = out_rect.x + out_rect.w;
+
+        float saved = f[y][x];
+        f[y][x] = saved + eps;
+        double plus = grad_check_loss(f, H, W, g, kH, kW, sH, sW, grad_out, i0, i1, j0, j1);
+        f[y][x] = saved - eps;
+        double minus = grad_check_loss(f, H, W, g, kH, kW, sH, sW, grad_out, i0, i1, j0, j1);
+        f[y][x] = saved;
+        double numeric = (plus - minus) / ((double)(saved + eps) - (double)(saved - eps));
+        double err = fabs(grad_in[y][x] - numeric) / fmax(1.0, fabs(numeric));
+        if (err > *err_in) *err_in = err;
+    }
+
+    for (int ki = 0; grad_g && ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            float saved = g[ki][kj];
+            g[ki][kj] = saved + eps;
+            double plus = grad_check_loss(f, H, W, g, kH, kW, sH, sW, grad_out, 0, out_H, 0, out_W);
+            g[ki][kj] = saved - eps;
+            double minus = grad_check_loss(f, H, W, g, kH, kW, sH, sW, grad_out, 0, out_H, 0, out_W);
+            g[ki][kj] = saved;
+            double numeric = (plus - minus) / ((double)(saved + eps) - (double)(saved - eps));
+            double err = fabs(grad_g[ki][kj] - numeric) / fmax(1.0, fabs(numeric));
+            if (err > *err_g) *err_g = err;
+        }
+    }
+}
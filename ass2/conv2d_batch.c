@@ -0,0 +1,463 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Batched throughput mode for many independent images
+ *
+ * One MPI job processes a whole list of inputs with the same kernel:
+ * - small images (at most split_pixels pixels) are assigned whole to ranks,
+ *   largest first to the least-loaded rank; each rank reads, convolves
+ *   (OpenMP) and writes its own images with no broadcast at all
+ * - large images are processed one at a time by all ranks with the usual
+ *   row split (conv2d_stride)
+ * Input/output buffers grow to the largest image seen and are reused across
+ * the batch instead of being reallocated per image.
+ */
+
+/*
+ * Grow-only 2D buffer reused across images
+ */
+typedef struct {
+    float **data;
+    int rows;
+    int cols;
+} BatchBuffer;
+
+/**
+ * Make sure the buffer holds at least rows x cols; reallocate only when it
+ * has to grow. Returns 0 on success.
+ */
+static int batch_buffer_reserve(BatchBuffer *buf, int rows, int cols) {
+    if (buf->data && rows <= buf->rows && cols <= buf->cols) return 0;
+
+    int new_rows = rows > buf->rows ? rows : buf->rows;
+    int new_cols = cols > buf->cols ? cols : buf->cols;
+    free_2d_array(buf->data, buf->rows);
+    buf->data = allocate_2d_array(new_rows, new_cols);
+    if (!buf->data) {
+        buf->rows = buf->cols = 0;
+        return -1;
+    }
+    buf->rows = new_rows;
+    buf->cols = new_cols;
+    return 0;
+}
+
+static void batch_buffer_free(BatchBuffer *buf) {
+    free_2d_array(buf->data, buf->rows);
+    buf->data = NULL;
+    buf->rows = buf->cols = 0;
+}
+
+/**
+ * Read an array file into a reusable buffer. Text files are parsed straight
+ * into it (no per-image allocation); binary files (CONV2D_BIN_MAGIC) go
+ * through read_array_from_file and are copied in.
+ */
+static int read_array_into(const char *filename, BatchBuffer *buf, int *rows, int *cols) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    char magic[4];
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, CONV2D_BIN_MAGIC, sizeof(magic)) == 0) {
+        fclose(file);
+        float **array;
+        if (read_array_from_file(filename, &array, rows, cols) != 0) return -1;
+        if (batch_buffer_reserve(buf, *rows, *cols) != 0) {
+            free_2d_array(array, *rows);
+            return -1;
+        }
+        for (int i = 0; i < *rows; i++) {
+            memcpy(buf->data[i], array[i], (size_t)*cols * sizeof(float));
+        }
+        free_2d_array(array, *rows);
+        return 0;
+    }
+    rewind(file);
+
+    if (fscanf(file, "%d %d", rows, cols) != 2 || *rows <= 0 || *cols <= 0) {
+        fprintf(stderr, "Error: Cannot read array dimensions from %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+    if (batch_buffer_reserve(buf, *rows, *cols) != 0) {
+        fclose(file);
+        return -1;
+    }
+    for (int i = 0; i < *rows; i++) {
+        for (int j = 0; j < *cols; j++) {
+            if (fscanf(file, "%f", &buf->data[i][j]) != 1) {
+                fprintf(stderr, "Error: Cannot read element [%d][%d] from %s\n", i, j, filename);
+                fclose(file);
+                return -1;
+            }
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Write one output, binary if its name ends in .bin (like the input it is
+ * named after), text otherwise
+ */
+static void write_batch_output(const char *path, float **array, int rows, int cols) {
+    if (is_binary_filename(path)) {
+        write_array_to_binary(path, array, rows, cols, CONV2D_DTYPE_F32);
+    } else {
+        write_array_to_file(path, array, rows, cols);
+    }
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void batch_free_paths(char **paths, int count) {
+    for (int n = 0; n < count; n++) free(paths[n]);
+    free(paths);
+}
+
+/**
+ * Append a copy of path to a growing list. Returns 0 on success.
+ */
+static int batch_add_path(char ***paths, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 64;
+        char **grown = (char**)realloc(*paths, new_capacity * sizeof(char*));
+        if (!grown) {
+            fprintf(stderr, "Error: Failed to allocate memory for batch list\n");
+            return -1;
+        }
+        *paths = grown;
+        *capacity = new_capacity;
+    }
+    char *copy = strdup(path);
+    if (!copy) {
+        fprintf(stderr, "Error: Failed to allocate memory for batch list\n");
+        return -1;
+    }
+    (*paths)[(*count)++] = copy;
+    return 0;
+}
+
+/**
+ * List the batch inputs: every regular file of a directory (sorted), or one
+ * path per line of a manifest file (blank lines and # comments skipped)
+ */
+static char** list_batch_inputs(const char *source, int *count) {
+    char **paths = NULL;
+    int capacity = 0;
+    *count = 0;
+
+    struct stat st;
+    if (stat(source, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open batch source %s\n", source);
+        return NULL;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(source);
+        if (!dir) {
+            fprintf(stderr, "Error: Cannot open directory %s\n", source);
+            return NULL;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+
+            char full[4096];
+            snprintf(full, sizeof(full), "%s/%s", source, entry->d_name);
+            struct stat entry_st;
+            if (stat(full, &entry_st) != 0 || !S_ISREG(entry_st.st_mode)) continue;
+
+            if (batch_add_path(&paths, count, &capacity, full) != 0) {
+                closedir(dir);
+                batch_free_paths(paths, *count);
+                *count = 0;
+                return NULL;
+            }
+        }
+        closedir(dir);
+        if (*count > 0) qsort(paths, *count, sizeof(char*), compare_paths);
+        return paths;
+    }
+
+    FILE *file = fopen(source, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open manifest %s\n", source);
+        return NULL;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0' || *start == '#') continue;
+
+        if (batch_add_path(&paths, count, &capacity, start) != 0) {
+            fclose(file);
+            batch_free_paths(paths, *count);
+            *count = 0;
+            return NULL;
+        }
+    }
+    fclose(file);
+    return paths;
+}
+
+/**
+ * Output path for an input: <output_dir>/<input basename>
+ */
+static void batch_output_path(const char *output_dir, const char *input, char *path, size_t len) {
+    const char *base = strrchr(input, '/');
+    base = base ? base + 1 : input;
+    snprintf(path, len, "%s/%s", output_dir, base);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Percentile of an ascending array (nearest rank)
+ */
+static double percentile(const double *sorted, int n, double pct) {
+    if (n == 0) return 0.0;
+    int idx = (int)(pct / 100.0 * n + 0.5) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return sorted[idx];
+}
+
+/**
+ * Run a batch of convolutions with one kernel (g must be valid on every rank).
+ *
+ * source is a directory or a manifest file (read on rank 0). Images with at
+ * most split_pixels pixels are distributed whole across ranks; larger ones
+ * use the spatial split. If output_dir is not NULL each output is written as
+ * <output_dir>/<input basename>. Per-image latency covers read, convolution
+ * and write. Results are reported on rank 0. Returns 0 on success.
+ */
+int conv2d_batch_run(const char *source, float **g, int kH, int kW, int sH, int sW,
+                     long long split_pixels, const char *output_dir, MPI_Comm comm, BatchStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    memset(stats, 0, sizeof(*stats));
+
+    // Rank 0 lists the inputs and reads their headers
+    char **paths = NULL;
+    int count = 0;
+    int *dims = NULL;
+    if (rank == 0) {
+        paths = list_batch_inputs(source, &count);
+        dims = (int*)malloc((count > 0 ? count : 1) * 2 * sizeof(int));
+        for (int n = 0; n < count; n++) {
+            if (read_array_dims(paths[n], &dims[2 * n], &dims[2 * n + 1]) != 0) {
+                dims[2 * n] = dims[2 * n + 1] = 0;
+            }
+        }
+    }
+    MPI_Bcast(&count, 1, MPI_INT, 0, comm);
+    if (count == 0) {
+        if (rank == 0) fprintf(stderr, "Error: No batch inputs found in %s\n", source);
+        free(paths);
+        free(dims);
+        return -1;
+    }
+    if (rank != 0) {
+        paths = (char**)malloc(count * sizeof(char*));
+        dims = (int*)malloc(count * 2 * sizeof(int));
+    }
+    MPI_Bcast(dims, count * 2, MPI_INT, 0, comm);
+
+    // Share the path list as one packed buffer
+    int packed_len = 0;
+    if (rank == 0) {
+        for (int n = 0; n < count; n++) packed_len += (int)strlen(paths[n]) + 1;
+    }
+    MPI_Bcast(&packed_len, 1, MPI_INT, 0, comm);
+    char *packed = (char*)malloc(packed_len);
+    if (rank == 0) {
+        char *p = packed;
+        for (int n = 0; n < count; n++) {
+            size_t len = strlen(paths[n]) + 1;
+            memcpy(p, paths[n], len);
+            p += len;
+        }
+    }
+    MPI_Bcast(packed, packed_len, MPI_CHAR, 0, comm);
+    if (rank != 0) {
+        char *p = packed;
+        for (int n = 0; n < count; n++) {
+            paths[n] = strdup(p);
+            p += strlen(p) + 1;
+        }
+    }
+    free(packed);
+
+    // Assign small images whole: largest first to the least-loaded rank
+    int *owner = (int*)malloc(count * sizeof(int));
+    int *order = (int*)malloc(count * sizeof(int));
+    double *load = (double*)calloc(size, sizeof(double));
+    for (int n = 0; n < count; n++) order[n] = n;
+    for (int a = 1; a < count; a++) {
+        int key = order[a], b = a - 1;
+        long long key_px = (long long)dims[2 * key] * dims[2 * key + 1];
+        while (b >= 0 && (long long)dims[2 * order[b]] * dims[2 * order[b] + 1] < key_px) {
+            order[b + 1] = order[b];
+            b--;
+        }
+        order[b + 1] = key;
+    }
+    for (int a = 0; a < count; a++) {
+        int n = order[a];
+        long long px = (long long)dims[2 * n] * dims[2 * n + 1];
+        if (px == 0 || px > split_pixels) {
+            owner[n] = -1;  // spatial split across all ranks (or unreadable)
+            continue;
+        }
+        int best = 0;
+        for (int p = 1; p < size; p++) {
+            if (load[p] < load[best]) best = p;
+        }
+        owner[n] = best;
+        load[best] += (double)px;
+    }
+    free(order);
+    free(load);
+
+    double *latency = (double*)malloc(count * sizeof(double));
+    for (int n = 0; n < count; n++) latency[n] = -1.0;
+
+    BatchBuffer in_buf = {NULL, 0, 0}, out_buf = {NULL, 0, 0};
+    int failures = 0;
+
+    MPI_Barrier(comm);
+    double t_batch = MPI_Wtime();
+
+    // Phase 1: whole small images, each rank independently
+    for (int n = 0; n < count; n++) {
+        if (owner[n] != rank) continue;
+
+        double t0 = MPI_Wtime();
+        int H, W;
+        if (read_array_into(paths[n], &in_buf, &H, &W) != 0) {
+            failures++;
+            continue;
+        }
+        int out_H = (H + sH - 1) / sH;
+        int out_W = (W + sW - 1) / sW;
+        if (batch_buffer_reserve(&out_buf, out_H, out_W) != 0) {
+            failures++;
+            continue;
+        }
+        conv2d_omp_stride(in_buf.data, H, W, g, kH, kW, sH, sW, out_buf.data);
+        if (output_dir) {
+            char out_path[4096];
+            batch_output_path(output_dir, paths[n], out_path, sizeof(out_path));
+            write_batch_output(out_path, out_buf.data, out_H, out_W);
+        }
+        latency[n] = MPI_Wtime() - t0;
+    }
+
+    // Phase 2: large images, all ranks together
+    for (int n = 0; n < count; n++) {
+        if (owner[n] != -1) continue;
+        if (dims[2 * n] == 0) {
+            // Header could not be read
+            if (rank == 0) failures++;
+            continue;
+        }
+
+        double t0 = MPI_Wtime();
+        int H = dims[2 * n], W = dims[2 * n + 1];
+        int ok = 1;
+        if (rank == 0) {
+            int rows, cols;
+            ok = read_array_into(paths[n], &in_buf, &rows, &cols) == 0;
+        } else {
+            ok = batch_buffer_reserve(&in_buf, H, W) == 0;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+        if (!ok) {
+            if (rank == 0) failures++;
+            continue;
+        }
+        for (int i = 0; i < H; i++) {
+            MPI_Bcast(in_buf.data[i], W, MPI_FLOAT, 0, comm);
+        }
+
+        int out_H = (H + sH - 1) / sH;
+        int out_W = (W + sW - 1) / sW;
+        ok = batch_buffer_reserve(&out_buf, out_H, out_W) == 0;
+        MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+        if (!ok) {
+            if (rank == 0) {
+                fprintf(stderr, "Error: Failed to allocate memory for batch output %s\n", paths[n]);
+                failures++;
+            }
+            continue;
+        }
+        conv2d_stride(in_buf.data, H, W, g, kH, kW, sH, sW, out_buf.data, comm);
+
+        if (rank == 0) {
+            if (output_dir) {
+                char out_path[4096];
+                batch_output_path(output_dir, paths[n], out_path, sizeof(out_path));
+                write_batch_output(out_path, out_buf.data, out_H, out_W);
+            }
+            latency[n] = MPI_Wtime() - t0;
+        }
+    }
+
+    MPI_Barrier(comm);
+    t_batch = MPI_Wtime() - t_batch;
+
+    // Combine latencies (each image was timed on exactly one rank)
+    MPI_Allreduce(MPI_IN_PLACE, latency, count, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &failures, 1, MPI_INT, MPI_SUM, comm);
+
+    double *done = (double*)malloc(count * sizeof(double));
+    int num_done = 0;
+    double latency_sum = 0.0;
+    for (int n = 0; n < count; n++) {
+        if (latency[n] >= 0.0) {
+            done[num_done++] = latency[n];
+            latency_sum += latency[n];
+        }
+        if (owner[n] >= 0) {
+            stats->small_images++;
+        } else if (dims[2 * n] > 0) {
+            stats->large_images++;
+        }
+    }
+    qsort(done, num_done, sizeof(double), compare_doubles);
+
+    stats->images = num_done;
+    stats->failures = failures;
+    stats->total_time = t_batch;
+    stats->images_per_second = t_batch > 0 ? num_done / t_batch : 0.0;
+    stats->latency_mean = num_done > 0 ? latency_sum / num_done : 0.0;
+    stats->latency_p50 = percentile(done, num_done, 50.0);
+    stats->latency_p90 = percentile(done, num_done, 90.0);
+    stats->latency_p99 = percentile(done, num_done, 99.0);
+    stats->latency_max = num_done > 0 ? done[num_done - 1] : 0.0;
+
+    free(done);
+    free(latency);
+    free(owner);
+    batch_buffer_free(&in_buf);
+    batch_buffer_free(&out_buf);
+    batch_free_paths(paths, count);
+    free(dims);
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,262 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Box and block-constant kernels via summed-area tables
+ *
+ * A uniform kH x kW box average costs kH * kW multiply-adds per output in
+ * the direct loops, yet the sum of any input rectangle is four lookups in a
+ * summed-area table (integral image). A kernel made of a few rectangles of
+ * constant weight (a box, a box with a different centre, a difference of
+ * boxes) is compiled into those rectangles; each output is then the weighted
+ * sum of one table rectangle per block, O(blocks) instead of O(kH * kW).
+ * Rectangles are clipped to the image, which is exactly the "same" zero
+ * padding, and strides only change where the rectangles start.
+ *
+ * The table covers only the input rows of the caller's output rows (a
+ * rank's band plus its kernel halo), built in chunks of about BOX_BAND_ROWS
+ * input rows, so no prefix scan ever crosses ranks and the table stays
+ * small. It is accumulated in double precision from the first row of each
+ * chunk, so the differences of large prefix sums keep their low bits. Rows
+ * are scanned in parallel, then columns in parallel strips.
+ *
+ * conv2d_omp_stride, conv2d_stride and conv2d_stride_stats use this path
+ * automatically when the kernel is at most conv2d_get_box_max_blocks()
+ * rectangles and the modelled cost is below the tap count.
+ */
+
+// Table columns summed down together by one thread
+#define BOX_COL_STRIP 256
+
+static int box_max_blocks = BOX_MAX_BLOCKS;
+
+/**
+ * Set the largest number of constant rectangles a kernel may have to use
+ * the summed-area table engine. 0 disables it.
+ */
+void conv2d_set_box_max_blocks(int max_blocks) {
+    box_max_blocks = max_blocks;
+}
+
+int conv2d_get_box_max_blocks(void) {
+    return box_max_blocks;
+}
+
+/**
+ * Compile g into at most max_blocks constant rectangles (zeros are left out).
+ * Rectangles are grown greedily: right along a row of equal weights, then
+ * down while the whole row segment repeats. Returns 0 on success, -1 if g
+ * needs more rectangles or memory runs out.
+ */
+int conv2d_box_compile(float **g, int kH, int kW, int max_blocks, BoxKernel *bk) {
+    memset(bk, 0, sizeof(*bk));
+    bk->kH = kH;
+    bk->kW = kW;
+    if (max_blocks <= 0) return -1;
+
+    char *used = (char*)calloc((size_t)kH * kW, 1);
+    bk->block_y = (int*)malloc(max_blocks * sizeof(int));
+    bk->block_x = (int*)malloc(max_blocks * sizeof(int));
+    bk->block_h = (int*)malloc(max_blocks * sizeof(int));
+    bk->block_w = (int*)malloc(max_blocks * sizeof(int));
+    bk->block_v = (float*)malloc(max_blocks * sizeof(float));
+    if (!used || !bk->block_y || !bk->block_x || !bk->block_h || !bk->block_w || !bk->block_v) {
+        free(used);
+        conv2d_box_free(bk);
+        return -1;
+    }
+
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            float v = g[ki][kj];
+            if (v == 0.0f || used[ki * kW + kj]) continue;
+            if (bk->num_blocks == max_blocks) {
+                free(used);
+                conv2d_box_free(bk);
+                return -1;
+            }
+
+            int w = 1;
+            while (kj + w < kW && g[ki][kj + w] == v && !used[ki * kW + kj + w]) w++;
+            int h = 1;
+            for (; ki + h < kH; h++) {
+                int same = 1;
+                for (int x = kj; x < kj + w && same; x++) {
+                    same = g[ki + h][x] == v && !used[(ki + h) * kW + x];
+                }
+                if (!same) break;
+            }
+            for (int y = ki; y < ki + h; y++) {
+                memset(used + y * kW + kj, 1, w);
+            }
+
+            int b = bk->num_blocks++;
+            bk->block_y[b] = ki;
+            bk->block_x[b] = kj;
+            bk->block_h[b] = h;
+            bk->block_w[b] = w;
+            bk->block_v[b] = v;
+            bk->nnz += h * w;
+        }
+    }
+    free(used);
+    return 0;
+}
+
+void conv2d_box_free(BoxKernel *bk) {
+    free(bk->block_y);
+    free(bk->block_x);
+    free(bk->block_h);
+    free(bk->block_w);
+    free(bk->block_v);
+    memset(bk, 0, sizeof(*bk));
+}
+
+/**
+ * Compile g if the summed-area table engine should be used for it at this
+ * stride: at most conv2d_get_box_max_blocks() rectangles, and four lookups
+ * per rectangle plus the table build (BOX_BUILD_COST per input pixel)
+ * cheaper than one multiply-add per nonzero tap. Returns 1 (and a compiled
+ * kernel to free) when it should, 0 otherwise.
+ */
+int conv2d_box_select(float **g, int kH, int kW, int sH, int sW, BoxKernel *bk) {
+    if (box_max_blocks <= 0) return 0;
+    if (conv2d_box_compile(g, kH, kW, box_max_blocks, bk) != 0) return 0;
+    if (4.0 * bk->num_blocks + (double)BOX_BUILD_COST * sH * sW >= bk->nnz) {
+        conv2d_box_free(bk);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Summed-area table of input rows [in0, in1): sat[r * (W + 1) + c] is the
+ * sum of rows [in0, in0 + r) and columns [0, c)
+ */
+static void box_build_table(float **f, int f_row0, int W, int in0, int in1, double *sat) {
+    int rows = in1 - in0;
+    size_t stride = (size_t)W + 1;
+
+    for (int c = 0; c <= W; c++) sat[c] = 0.0;
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows; r++) {
+        const float *src = f[in0 + r - f_row0];
+        double *dst = sat + (size_t)(r + 1) * stride;
+        double run = 0.0;
+        dst[0] = 0.0;
+        for (int c = 0; c < W; c++) {
+            run += src[c];
+            dst[c + 1] = run;
+        }
+    }
+
+    int strips = (W + 1 + BOX_COL_STRIP - 1) / BOX_COL_STRIP;
+    #pragma omp parallel for schedule(static)
+    for (int s = 0; s < strips; s++) {
+        int c0 = s * BOX_COL_STRIP;
+        int c1 = c0 + BOX_COL_STRIP < W + 1 ? c0 + BOX_COL_STRIP : W + 1;
+        for (int r = 2; r <= rows; r++) {
+            double *dst = sat + (size_t)r * stride;
+            const double *above = dst - stride;
+            #pragma omp simd
+            for (int c = c0; c < c1; c++) {
+                dst[c] += above[c];
+            }
+        }
+    }
+}
+
+/**
+ * Output row out_i from the table of input rows [in0, in1), into out
+ * (indexed by output column); acc holds out_W doubles of scratch
+ */
+static void box_row(const double *sat, int in0, int in1, int W, const BoxKernel *bk, int sH, int sW,
+                    int out_i, double *acc, float *out) {
+    int pad_top = (bk->kH - 1) / 2;
+    int pad_left = (bk->kW - 1) / 2;
+    int out_W = (W + sW - 1) / sW;
+    size_t stride = (size_t)W + 1;
+    for (int j = 0; j < out_W; j++) acc[j] = 0.0;
+
+    for (int b = 0; b < bk->num_blocks; b++) {
+        // Rows and columns of the block, clipped to the table (zero padding)
+        int y0 = out_i * sH - pad_top + bk->block_y[b];
+        int y1 = y0 + bk->block_h[b];
+        if (y0 < in0) y0 = in0;
+        if (y1 > in1) y1 = in1;
+        if (y1 <= y0) continue;
+        const double *top = sat + (size_t)(y0 - in0) * stride;
+        const double *bottom = sat + (size_t)(y1 - in0) * stride;
+        double v = bk->block_v[b];
+        int dx = bk->block_x[b] - pad_left;
+        int bw = bk->block_w[b];
+
+        #pragma omp simd
+        for (int j = 0; j < out_W; j++) {
+            int x0 = j * sW + dx;
+            int x1 = x0 + bw;
+            x0 = x0 < 0 ? 0 : (x0 > W ? W : x0);
+            x1 = x1 < 0 ? 0 : (x1 > W ? W : x1);
+            acc[j] += v * ((bottom[x1] - bottom[x0]) - (top[x1] - top[x0]));
+        }
+    }
+
+    for (int j = 0; j < out_W; j++) out[j] = (float)acc[j];
+}
+
+/**
+ * Summed-area table convolution of output rows [row_start, row_end)
+ *
+ * f[input_i - f_row0] is input row input_i (so a rank's local band can be
+ * passed with its first row), output[out_i] receives output row out_i. The
+ * table is built for the rows these outputs read, chunk by chunk, and each
+ * chunk's rows are OpenMP-parallel with the tuned runtime schedule.
+ */
+void conv2d_box_rows(float **f, int f_row0, int H, int W, const BoxKernel *bk, int sH, int sW, float **output, int row_start, int row_end) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_top = (bk->kH - 1) / 2;
+    int out_W = (W + sW - 1) / sW;
+    if (row_end <= row_start) return;
+
+    // Output rows per chunk so that a chunk reads about BOX_BAND_ROWS input rows
+    int chunk = (BOX_BAND_ROWS - bk->kH) / sH + 1;
+    if (chunk < 1) chunk = 1;
+    int max_rows = (chunk - 1) * sH + bk->kH;
+    double *sat = (double*)malloc(((size_t)max_rows + 1) * ((size_t)W + 1) * sizeof(double));
+    if (!sat) {
+        fprintf(stderr, "Error: Failed to allocate memory for summed-area table\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    for (int c0 = row_start; c0 < row_end; c0 += chunk) {
+        int c1 = c0 + chunk < row_end ? c0 + chunk : row_end;
+        int in0 = c0 * sH - pad_top;
+        int in1 = (c1 - 1) * sH - pad_top + bk->kH;
+        if (in0 < 0) in0 = 0;
+        if (in1 > H) in1 = H;
+        if (in1 < in0) in1 = in0;
+        box_build_table(f, f_row0, W, in0, in1, sat);
+
+        #pragma omp parallel
+        {
+            Conv2dArena *arena = conv2d_thread_arena();
+            Conv2dArenaMark mark = conv2d_arena_mark(arena);
+            double *acc = (double*)conv2d_arena_alloc(arena, (size_t)out_W * sizeof(double));
+            if (!acc) {
+                fprintf(stderr, "Error: Failed to allocate memory for summed-area row\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            #pragma omp for schedule(runtime)
+            for (int out_i = c0; out_i < c1; out_i++) {
+                box_row(sat, in0, in1, W, bk, sH, sW, out_i, acc, output[out_i]);
+                if (ep) conv2d_epilogue_row(ep, output[out_i], out_W);
+            }
+            conv2d_arena_rewind(arena, mark);
+        }
+    }
+    free(sat);
+}
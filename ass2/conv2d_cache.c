@@ -0,0 +1,303 @@
+#include "conv2d.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Content-addressed result cache
+ *
+ * Batch reruns and parameter sweeps often resubmit exactly the same input,
+ * kernel and stride. The cache stores each output as a binary array file
+ * (Conv2dBinHeader + fp32 rows) named after a 64-bit key, a hash of the shape
+ * and stride parameters, the kernel and the input. Input rows are hashed
+ * independently in parallel (OpenMP) and the row hashes are combined in
+ * order, so checking the cache costs one parallel read of the input. A hit
+ * maps the stored file read-only and returns row pointers into the mapping,
+ * so nothing is copied or computed.
+ *
+ * Eviction is LRU by file modification time: a hit touches its entry, and
+ * every store removes the oldest entries until the directory is within its
+ * byte budget. Entries are written to a temporary name and renamed, so
+ * concurrent jobs sharing a directory never see partial files.
+ */
+
+// Multiplicative constants of the 64-bit row hash (xxHash64 primes)
+#define HASH_P1 0x9E3779B185EBCA87ULL
+#define HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define HASH_P3 0x165667B19E3779F9ULL
+#define HASH_P4 0x85EBCA77C2B2AE63ULL
+#define HASH_P5 0x27D4EB2F165667C5ULL
+
+// Cache file names are 16 hex digits + ".bin"
+#define CACHE_NAME_LEN 20
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * HASH_P2;
+    acc = rotl64(acc, 31);
+    return acc * HASH_P1;
+}
+
+static uint64_t hash_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= HASH_P2;
+    h ^= h >> 29;
+    h *= HASH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * 64-bit hash of len bytes: four independent lanes over 32-byte stripes so
+ * the multiply chains overlap, then the tail word by word
+ */
+static uint64_t hash_bytes(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char*)data;
+    size_t n = len;
+    uint64_t h;
+
+    if (n >= 32) {
+        uint64_t v1 = seed + HASH_P1 + HASH_P2, v2 = seed + HASH_P2;
+        uint64_t v3 = seed, v4 = seed - HASH_P1;
+        while (n >= 32) {
+            uint64_t w[4];
+            memcpy(w, p, sizeof(w));
+            v1 = hash_round(v1, w[0]);
+            v2 = hash_round(v2, w[1]);
+            v3 = hash_round(v3, w[2]);
+            v4 = hash_round(v4, w[3]);
+            p += 32;
+            n -= 32;
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    } else {
+        h = seed + HASH_P5;
+    }
+    h += (uint64_t)len;
+
+    while (n >= 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        h ^= hash_round(0, w);
+        h = rotl64(h, 27) * HASH_P1 + HASH_P4;
+        p += 8;
+        n -= 8;
+    }
+    while (n > 0) {
+        h ^= (uint64_t)(*p) * HASH_P5;
+        h = rotl64(h, 11) * HASH_P1;
+        p++;
+        n--;
+    }
+    return hash_avalanche(h);
+}
+
+/**
+ * Hash of a rows x cols array: rows hashed in parallel, combined in order.
+ * Returns 0 on success, -1 if the row hashes cannot be allocated.
+ */
+int conv2d_hash_array(float **a, int rows, int cols, uint64_t *hash) {
+    Conv2dArena *arena = conv2d_thread_arena();
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    uint64_t *row_hash = (uint64_t*)conv2d_arena_alloc(arena, (size_t)(rows > 0 ? rows : 1) * sizeof(uint64_t));
+    if (!row_hash) {
+        fprintf(stderr, "Error: Failed to allocate memory for row hashes\n");
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++) {
+        row_hash[i] = hash_bytes(a[i], (size_t)cols * sizeof(float), (uint64_t)i);
+    }
+
+    int dims[2] = { rows, cols };
+    uint64_t h = hash_bytes(dims, sizeof(dims), 0);
+    h = hash_bytes(row_hash, (size_t)rows * sizeof(uint64_t), h);
+
+    conv2d_arena_rewind(arena, mark);
+    *hash = h;
+    return 0;
+}
+
+/**
+ * Cache key of one convolution: shape, stride, dilation, epilogue, kernel and
+ * input. Returns 0 on success, -1 if the data could not be hashed (the cache
+ * must then be skipped).
+ */
+int conv2d_cache_key(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, uint64_t *key) {
+    int params[8] = { H, W, kH, kW, sH, sW, dH, dW };
+    uint64_t h = hash_bytes(params, sizeof(params), CONV2D_CACHE_VERSION);
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    if (ep) {
+        float values[5] = { ep->bias, ep->alpha, ep->scale, ep->clamp_min, ep->clamp_max };
+        h = hash_bytes(values, sizeof(values), h ^ (uint64_t)(ep->activation + 1));
+    }
+    uint64_t g_hash, f_hash;
+    if (conv2d_hash_array(g, kH, kW, &g_hash) != 0 || conv2d_hash_array(f, H, W, &f_hash) != 0) return -1;
+    h ^= rotl64(g_hash, 17);
+    h = hash_round(h, f_hash);
+    *key = hash_avalanche(h);
+    return 0;
+}
+
+static void cache_entry_path(const char *dir, uint64_t key, char *path, size_t len) {
+    snprintf(path, len, "%s/%016llx.bin", dir, (unsigned long long)key);
+}
+
+/**
+ * Map the stored output for key. Returns 1 on a hit (entry holds rows x cols
+ * row pointers into a read-only mapping; release with conv2d_cache_release),
+ * 0 on a miss.
+ */
+int conv2d_cache_lookup(const char *dir, uint64_t key, int rows, int cols, Conv2dCacheEntry *entry) {
+    memset(entry, 0, sizeof(*entry));
+    char path[1100];
+    cache_entry_path(dir, key, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    size_t bytes = sizeof(Conv2dBinHeader) + (size_t)rows * cols * sizeof(float);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != bytes) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const Conv2dBinHeader *header = (const Conv2dBinHeader*)map;
+    float **row_ptrs = (float**)malloc((size_t)rows * sizeof(float*));
+    if (!row_ptrs || memcmp(header->magic, CONV2D_BIN_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CONV2D_BIN_VERSION || header->dtype != CONV2D_DTYPE_F32 ||
+        header->rows != rows || header->cols != cols) {
+        free(row_ptrs);
+        munmap(map, bytes);
+        return 0;
+    }
+
+    float *data = (float*)((char*)map + sizeof(Conv2dBinHeader));
+    for (int i = 0; i < rows; i++) {
+        row_ptrs[i] = data + (size_t)i * cols;
+    }
+
+    // Mark as most recently used
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    entry->map = map;
+    entry->map_bytes = bytes;
+    entry->rows = rows;
+    entry->cols = cols;
+    entry->output = row_ptrs;
+    return 1;
+}
+
+void conv2d_cache_release(Conv2dCacheEntry *entry) {
+    if (entry->map) munmap(entry->map, entry->map_bytes);
+    free(entry->output);
+    memset(entry, 0, sizeof(*entry));
+}
+
+typedef struct {
+    char name[CACHE_NAME_LEN + 1];
+    long long bytes;
+    struct timespec mtime;
+} CacheFile;
+
+static int compare_mtime(const void *a, const void *b) {
+    const CacheFile *x = (const CacheFile*)a, *y = (const CacheFile*)b;
+    if (x->mtime.tv_sec != y->mtime.tv_sec) return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec) return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static int is_cache_name(const char *name) {
+    if (strlen(name) != CACHE_NAME_LEN || strcmp(name + 16, ".bin") != 0) return 0;
+    for (int i = 0; i < 16; i++) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Remove least recently used entries until the directory holds at most
+ * max_bytes of cache files, never removing keep. Returns entries removed.
+ */
+int conv2d_cache_evict(const char *dir, long long max_bytes, uint64_t keep) {
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    char keep_name[32];
+    snprintf(keep_name, sizeof(keep_name), "%016llx.bin", (unsigned long long)keep);
+
+    int count = 0, capacity = 64;
+    long long total = 0;
+    CacheFile *files = (CacheFile*)malloc(capacity * sizeof(CacheFile));
+    struct dirent *ent;
+    while (files && (ent = readdir(d)) != NULL) {
+        if (!is_cache_name(ent->d_name)) continue;
+        char path[1100];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        total += st.st_size;
+        if (strcmp(ent->d_name, keep_name) == 0) continue;
+
+        if (count == capacity) {
+            capacity *= 2;
+            CacheFile *grown = (CacheFile*)realloc(files, capacity * sizeof(CacheFile));
+            if (!grown) break;
+            files = grown;
+        }
+        snprintf(files[count].name, sizeof(files[count].name), "%s", ent->d_name);
+        files[count].bytes = st.st_size;
+        files[count].mtime = st.st_mtim;
+        count++;
+    }
+    closedir(d);
+    if (!files) return 0;
+
+    qsort(files, count, sizeof(CacheFile), compare_mtime);
+    int removed = 0;
+    for (int k = 0; k < count && total > max_bytes; k++) {
+        char path[1100];
+        snprintf(path, sizeof(path), "%s/%s", dir, files[k].name);
+        if (remove(path) == 0) {
+            total -= files[k].bytes;
+            removed++;
+        }
+    }
+    free(files);
+    return removed;
+}
+
+/**
+ * Store an output under key, then evict down to max_bytes (0 = no limit).
+ * Returns 0 on success.
+ */
+int conv2d_cache_store(const char *dir, uint64_t key, float **output, int rows, int cols, long long max_bytes) {
+    mkdir(dir, 0755);
+
+    char path[1100], tmp_path[1200];
+    cache_entry_path(dir, key, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", path, (int)getpid());
+
+    if (write_array_to_binary(tmp_path, output, rows, cols, CONV2D_DTYPE_F32) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    if (rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Warning: Cannot update result cache %s\n", path);
+        remove(tmp_path);
+        return -1;
+    }
+
+    if (max_bytes > 0) conv2d_cache_evict(dir, max_bytes, key);
+    return 0;
+}
@@ -0,0 +1,385 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Multi-layer convolution chains with depth-first tile fusion
+ *
+ * A chain applies layers 0..n-1 in turn, each a "same"-padded strided
+ * convolution of the previous layer's output. Run layer by layer, every
+ * intermediate is written out in full and read back by the next layer (and
+ * gathered to every rank in between). The fused engine instead walks the
+ * final output in tile x tile tiles. For each tile it maps the rectangle back
+ * through the layers to the region of every intermediate it depends on (the
+ * accumulated receptive field), then computes those regions forward into two
+ * small per-thread buffers, so intermediates never leave the cache. Halo
+ * regions shared by neighbouring tiles are recomputed, which is the price
+ * for not materialising the intermediates.
+ *
+ * With MPI each rank owns a band of final output rows, cut by the shared
+ * cost-model partitioner for the chain's composite receptive field. The
+ * input is replicated, so a rank reads its band (with the halo of the whole
+ * chain) in place; no data moves until the final output is gathered.
+ */
+
+/**
+ * Output size of every layer: dims_H[l], dims_W[l] is the input of layer l,
+ * dims_H[n], dims_W[n] the final output
+ */
+void conv2d_chain_dims(int H, int W, const Conv2dLayer *layers, int num_layers, int *dims_H, int *dims_W) {
+    dims_H[0] = H;
+    dims_W[0] = W;
+    for (int l = 0; l < num_layers; l++) {
+        dims_H[l + 1] = (dims_H[l] + layers[l].sH - 1) / layers[l].sH;
+        dims_W[l + 1] = (dims_W[l] + layers[l].sW - 1) / layers[l].sW;
+    }
+}
+
+/**
+ * Input rows [*lo, *hi) of an in_n-row layer input read by output rows [a, b)
+ */
+static void chain_input_range(int a, int b, int k, int s, int in_n, int *lo, int *hi) {
+    int pad = (k - 1) / 2;
+    *lo = a * s - pad;
+    *hi = (b - 1) * s - pad + k;
+    if (*lo < 0) *lo = 0;
+    if (*hi > in_n) *hi = in_n;
+}
+
+/**
+ * Region of every layer input that output rectangle r of the last layer
+ * depends on: rects[l] for the input of layer l, rects[n] = r
+ */
+static void chain_regions(Conv2dRect r, const Conv2dLayer *layers, int num_layers,
+                          const int *dims_H, const int *dims_W, Conv2dRect *rects) {
+    rects[num_layers] = r;
+    for (int l = num_layers - 1; l >= 0; l--) {
+        Conv2dRect o = rects[l + 1];
+        int y0, y1, x0, x1;
+        chain_input_range(o.y, o.y + o.h, layers[l].kH, layers[l].sH, dims_H[l], &y0, &y1);
+        chain_input_range(o.x, o.x + o.w, layers[l].kW, layers[l].sW, dims_W[l], &x0, &x1);
+        rects[l].y = y0;
+        rects[l].x = x0;
+        rects[l].h = y1 - y0;
+        rects[l].w = x1 - x0;
+    }
+}
+
+/**
+ * Compute output rectangle r of one layer. in[y - in_y0][x - in_x0] is input
+ * pixel (y, x) of the in_H x in_W layer input, and out[i - r.y][j - out_x0]
+ * receives output pixel (i, j). The epilogue, if any, follows every layer.
+ */
+static void chain_layer_rect(float **in, int in_y0, int in_x0, int in_H, int in_W, const Conv2dLayer *layer,
+                             Conv2dRect r, float **out, int out_x0, const Conv2dEpilogue *ep) {
+    int kH = layer->kH, kW = layer->kW, sH = layer->sH, sW = layer->sW;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int j0 = r.x, j1 = r.x + r.w;
+
+    for (int i = r.y; i < r.y + r.h; i++) {
+        float *dst = out[i - r.y] - out_x0;
+        for (int j = j0; j < j1; j++) dst[j] = 0.0f;
+
+        for (int ki = 0; ki < kH; ki++) {
+            int y = i * sH + ki - pad_top;
+            if (y < 0 || y >= in_H) continue;
+            const float *src = in[y - in_y0] - in_x0;
+
+            for (int kj = 0; kj < kW; kj++) {
+                int dx = kj - pad_left;
+                float w = layer->g[ki][kj];
+
+                // Columns whose input x = j * sW + dx is inside the row
+                int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+                int hi = in_W - 1 - dx >= 0 ? (in_W - 1 - dx) / sW + 1 : 0;
+                if (lo < j0) lo = j0;
+                if (hi > j1) hi = j1;
+
+                if (sW == 1) {
+                    const float *s = src + dx;
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        dst[j] += w * s[j];
+                    }
+                } else {
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        dst[j] += w * src[j * sW + dx];
+                    }
+                }
+            }
+        }
+        if (ep) conv2d_epilogue_row(ep, dst + j0, r.w);
+    }
+}
+
+/**
+ * Serial reference: the layers one after another with conv2d_serial_stride
+ */
+void conv2d_chain_serial(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, float **output) {
+    int dims_H[CONV2D_CHAIN_MAX_LAYERS + 1], dims_W[CONV2D_CHAIN_MAX_LAYERS + 1];
+    conv2d_chain_dims(H, W, layers, num_layers, dims_H, dims_W);
+
+    float **in = f;
+    for (int l = 0; l < num_layers; l++) {
+        const Conv2dLayer *L = &layers[l];
+        float **out = l == num_layers - 1 ? output : allocate_2d_array(dims_H[l + 1], dims_W[l + 1]);
+        if (!out) {
+            fprintf(stderr, "Error: Failed to allocate memory for chain intermediate\n");
+            exit(1);
+        }
+        conv2d_serial_stride(in, dims_H[l], dims_W[l], L->g, L->kH, L->kW, L->sH, L->sW, out);
+        if (in != f) free_2d_array(in, dims_H[l]);
+        in = out;
+    }
+}
+
+static void chain_stats_init(PerfStats *stats, ChainStats *chain) {
+    conv2d_stats_begin(stats);
+    memset(chain, 0, sizeof(*chain));
+}
+
+/**
+ * Gather the final output rows to every rank
+ */
+static void chain_gather(float **output, int out_W, const int *row_starts, int size, MPI_Comm comm, PerfStats *stats) {
+    for (int p = 0; p < size; p++) {
+        for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+            MPI_Bcast(output[i], out_W, MPI_FLOAT, p, comm);
+            stats->num_communications++;
+            stats->bytes_communicated += (long long)out_W * sizeof(float);
+        }
+    }
+}
+
+/**
+ * Fused hybrid MPI+OpenMP chain with performance statistics
+ *
+ * f and every layer kernel must be valid on every rank; output (the final
+ * layer's size, see conv2d_chain_dims) is complete on every rank afterwards.
+ * tile is the edge of the final-output tiles computed depth-first (0 uses
+ * CONV2D_CHAIN_TILE). chain may be NULL.
+ */
+void conv2d_chain_stats(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, int tile,
+                        float **output, MPI_Comm comm, PerfStats *stats, ChainStats *chain) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ChainStats local_chain;
+    if (!chain) chain = &local_chain;
+    chain_stats_init(stats, chain);
+    Conv2dArena *arena = conv2d_thread_arena();
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    if (num_layers < 1 || num_layers > CONV2D_CHAIN_MAX_LAYERS) {
+        fprintf(stderr, "Error: A chain needs 1 to %d layers\n", CONV2D_CHAIN_MAX_LAYERS);
+        MPI_Abort(comm, 1);
+    }
+    if (tile <= 0) tile = CONV2D_CHAIN_TILE;
+    int dims_H[CONV2D_CHAIN_MAX_LAYERS + 1], dims_W[CONV2D_CHAIN_MAX_LAYERS + 1];
+    conv2d_chain_dims(H, W, layers, num_layers, dims_H, dims_W);
+    int out_H = dims_H[num_layers];
+    int out_W = dims_W[num_layers];
+    stats->output_elements = (long long)out_H * out_W;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    // Largest intermediate region of a full tile, for the per-thread buffers
+    int buf_h = 1, buf_w = 1;
+    {
+        int h = tile, w = tile;
+        for (int l = num_layers - 1; l >= 1; l--) {
+            h = (h - 1) * layers[l].sH + layers[l].kH;
+            w = (w - 1) * layers[l].sW + layers[l].kW;
+            if (h > dims_H[l]) h = dims_H[l];
+            if (w > dims_W[l]) w = dims_W[l];
+            if (h > buf_h) buf_h = h;
+            if (w > buf_w) buf_w = w;
+        }
+    }
+    chain->tile_buffer_bytes = 2LL * buf_h * buf_w * sizeof(float);
+
+    // Receptive field and stride of one final output pixel in input pixels
+    int rf = 1, step = 1, rf_w = 1, step_w = 1;
+    for (int l = 0; l < num_layers; l++) {
+        rf += (layers[l].kH - 1) * step;
+        step *= layers[l].sH;
+        rf_w += (layers[l].kW - 1) * step_w;
+        step_w *= layers[l].sW;
+    }
+    chain->receptive_field = rf;
+
+    // The chain acts as one rf x rf_w kernel at stride step x step_w (with the
+    // same out_H), so the shared partitioner's cost model applies
+    int *row_starts = conv2d_create_row_partition(H, W, rf, rf_w, step, step_w, size, comm);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    long long tiles = 0, macs = 0, reads = 0;
+    if (local_end > local_start) {
+        // This rank's input band with the halo of the whole chain, read in
+        // place from the replicated input
+        Conv2dRect band_rect = { local_start, 0, local_end - local_start, out_W };
+        Conv2dRect rects[CONV2D_CHAIN_MAX_LAYERS + 1];
+        chain_regions(band_rect, layers, num_layers, dims_H, dims_W, rects);
+        int input_start = rects[0].y;
+        int input_rows = rects[0].h;
+        chain->band_rows = input_rows;
+
+        float **band = f + input_start;
+
+        int tiles_y = (local_end - local_start + tile - 1) / tile;
+        int tiles_x = (out_W + tile - 1) / tile;
+        tiles = (long long)tiles_y * tiles_x;
+
+        t_comp_start = MPI_Wtime();
+        TuneParams tune;
+        conv2d_get_tune_params(&tune);
+        omp_set_schedule(tune.schedule, tune.chunk_size);
+        #pragma omp parallel reduction(+:macs, reads)
+        {
+            // Ping-pong intermediate tile buffers, per thread
+            Conv2dArena *thread_arena = conv2d_thread_arena();
+            Conv2dArenaMark thread_mark = conv2d_arena_mark(thread_arena);
+            float **buf[2];
+            buf[0] = conv2d_arena_alloc_2d(thread_arena, buf_h, buf_w);
+            buf[1] = conv2d_arena_alloc_2d(thread_arena, buf_h, buf_w);
+            if (!buf[0] || !buf[1]) {
+                fprintf(stderr, "Error: Failed to allocate memory for chain tile buffers\n");
+                MPI_Abort(comm, 1);
+            }
+
+            #pragma omp for schedule(runtime) collapse(2)
+            for (int ty = 0; ty < tiles_y; ty++) {
+                for (int tx = 0; tx < tiles_x; tx++) {
+                    int i0 = local_start + ty * tile;
+                    int i1 = i0 + tile < local_end ? i0 + tile : local_end;
+                    int j0 = tx * tile;
+                    int j1 = j0 + tile < out_W ? j0 + tile : out_W;
+                    Conv2dRect r = { i0, j0, i1 - i0, j1 - j0 };
+                    Conv2dRect tr[CONV2D_CHAIN_MAX_LAYERS + 1];
+                    chain_regions(r, layers, num_layers, dims_H, dims_W, tr);
+                    reads += (long long)tr[0].h * tr[0].w;
+
+                    // Depth-first through the layers
+                    float **in = band;
+                    int in_y0 = input_start, in_x0 = 0;
+                    for (int l = 0; l < num_layers; l++) {
+                        const Conv2dLayer *L = &layers[l];
+                        int last = l == num_layers - 1;
+                        float **out = last ? output + tr[l + 1].y : buf[l & 1];
+                        chain_layer_rect(in, in_y0, in_x0, dims_H[l], dims_W[l], L, tr[l + 1],
+                                         out, last ? 0 : tr[l + 1].x, ep);
+                        macs += (long long)tr[l + 1].h * tr[l + 1].w * L->kH * L->kW;
+                        in = out;
+                        in_y0 = tr[l + 1].y;
+                        in_x0 = tr[l + 1].x;
+                    }
+                }
+            }
+            conv2d_arena_rewind(thread_arena, thread_mark);
+        }
+        stats->computation_time = MPI_Wtime() - t_comp_start;
+    }
+
+    // Gather the final output to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        chain_gather(output, out_W, row_starts, size, comm, stats);
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    // Modelled footprint: input, final output and the thread buffers;
+    // traffic: every tile's input region and the final output
+    chain->tiles = tiles;
+    chain->macs = macs;
+    chain->peak_bytes = ((long long)H * W + (long long)out_H * out_W) * sizeof(float) +
+                        (long long)omp_get_max_threads() * chain->tile_buffer_bytes;
+    chain->traffic_bytes = (reads + (long long)out_H * out_W) * (long long)sizeof(float);
+
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Fused hybrid MPI+OpenMP chain (see conv2d_chain_stats)
+ */
+void conv2d_chain(float **f, int H, int W, const Conv2dLayer *layers, int num_layers, int tile,
+                  float **output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_chain_stats(f, H, W, layers, num_layers, tile, output, comm, &stats, NULL);
+}
+
+/**
+ * Layer-at-a-time chain with conv2d_stride_stats, the baseline for the fused
+ * engine: every intermediate is materialised in full on every rank
+ */
+void conv2d_chain_layered_stats(float **f, int H, int W, const Conv2dLayer *layers, int num_layers,
+                                float **output, MPI_Comm comm, PerfStats *stats, ChainStats *chain) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ChainStats local_chain;
+    if (!chain) chain = &local_chain;
+    chain_stats_init(stats, chain);
+    long long scratch_allocs = 0, scratch_bytes = 0, heap_allocs = 0;
+
+    double t_start = MPI_Wtime();
+    if (num_layers < 1 || num_layers > CONV2D_CHAIN_MAX_LAYERS) {
+        fprintf(stderr, "Error: A chain needs 1 to %d layers\n", CONV2D_CHAIN_MAX_LAYERS);
+        MPI_Abort(comm, 1);
+    }
+    int dims_H[CONV2D_CHAIN_MAX_LAYERS + 1], dims_W[CONV2D_CHAIN_MAX_LAYERS + 1];
+    conv2d_chain_dims(H, W, layers, num_layers, dims_H, dims_W);
+    stats->output_elements = (long long)dims_H[num_layers] * dims_W[num_layers];
+
+    float **in = f;
+    for (int l = 0; l < num_layers; l++) {
+        const Conv2dLayer *L = &layers[l];
+        int last = l == num_layers - 1;
+        long long in_bytes = (long long)dims_H[l] * dims_W[l] * sizeof(float);
+        long long out_bytes = (long long)dims_H[l + 1] * dims_W[l + 1] * sizeof(float);
+        float **out = last ? output : allocate_2d_array(dims_H[l + 1], dims_W[l + 1]);
+        if (!out) {
+            fprintf(stderr, "Error: Failed to allocate memory for chain intermediate\n");
+            MPI_Abort(comm, 1);
+        }
+
+        PerfStats layer;
+        conv2d_stride_stats(in, dims_H[l], dims_W[l], L->g, L->kH, L->kW, L->sH, L->sW, out, comm, &layer);
+        stats->computation_time += layer.computation_time;
+        stats->communication_time += layer.communication_time;
+        stats->broadcast_time += layer.broadcast_time;
+        stats->memory_copy_time += layer.memory_copy_time;
+        stats->bytes_communicated += layer.bytes_communicated;
+        stats->num_communications += layer.num_communications;
+        scratch_allocs += layer.scratch_allocs;
+        scratch_bytes += layer.scratch_bytes;
+        heap_allocs += layer.heap_allocs;
+
+        // Live at once: the chain input, this layer's input and output and
+        // the local band copy; traffic: band copy, band read, full output
+        // write (own rows plus gathered rows)
+        int lo, hi, rows = (dims_H[l + 1] + size - 1) / size;
+        chain_input_range(0, rows, L->kH, L->sH, dims_H[l], &lo, &hi);
+        long long band_bytes = size > 1 ? (long long)(hi - lo) * dims_W[l] * sizeof(float) : 0;
+        long long live = (long long)H * W * sizeof(float) + (in != f ? in_bytes : 0) + out_bytes + band_bytes;
+        if (live > chain->peak_bytes) chain->peak_bytes = live;
+        chain->traffic_bytes += 3 * band_bytes + (size > 1 ? 0 : in_bytes) + out_bytes;
+        chain->macs += (long long)dims_H[l + 1] * dims_W[l + 1] * L->kH * L->kW / size;
+
+        if (in != f) free_2d_array(in, dims_H[l]);
+        in = out;
+    }
+
+    stats->scratch_allocs = scratch_allocs;
+    stats->scratch_bytes = scratch_bytes;
+    stats->heap_allocs = heap_allocs;
+    stats->total_time = MPI_Wtime() - t_start;
+}
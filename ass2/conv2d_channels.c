@@ -0,0 +1,395 @@
+#include "conv2d.h"
+#include <limits.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Multi-channel convolution layer (C_in -> C_out) with "same" padding and stride
+ *
+ * Memory layout: activations are stored NHWC (channels innermost), so all
+ * channels of one pixel are contiguous. API weights are OIHW
+ * ([C_out][C_in][kH][kW]); they are repacked into a tap-major HWIO layout
+ * ([kH][kW][C_in][C_out]) so that the innermost loop runs unit-stride over
+ * output channels and vectorizes. With C_in = C_out = 1 every layout is
+ * plain row-major and the result equals conv2d_serial_stride.
+ */
+
+// Output channels accumulated together per pixel
+#define MC_COUT_BLOCK 16
+
+/**
+ * Repack OIHW weights into HWIO (tap-major, output channel innermost)
+ */
+static float* pack_weights_hwio(const float *weights, int kH, int kW, int C_in, int C_out) {
+    float *packed = (float*)malloc((size_t)kH * kW * C_in * C_out * sizeof(float));
+    if (!packed) {
+        fprintf(stderr, "Error: Failed to allocate memory for packed weights\n");
+        return NULL;
+    }
+    for (int co = 0; co < C_out; co++) {
+        for (int ci = 0; ci < C_in; ci++) {
+            for (int ki = 0; ki < kH; ki++) {
+                for (int kj = 0; kj < kW; kj++) {
+                    packed[(((size_t)ki * kW + kj) * C_in + ci) * C_out + co] =
+                        weights[(((size_t)co * C_in + ci) * kH + ki) * kW + kj];
+                }
+            }
+        }
+    }
+    return packed;
+}
+
+/**
+ * Compute output rows [row_start, row_end) and output channels
+ * [co_start, co_end) of a multi-channel layer. out points at the NHWC output
+ * with out_C channels per pixel; channel co is stored at offset co - co_base.
+ */
+static void mc_rows(const float *in, int H, int W, int C_in, const float *packed, int kH, int kW,
+                    int C_out, int sH, int sW, float *out, int out_C, int co_base,
+                    int row_start, int row_end, int co_start, int co_end) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_W = (W + sW - 1) / sW;
+
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime) collapse(2)
+    for (int out_i = row_start; out_i < row_end; out_i++) {
+        for (int out_j = 0; out_j < out_W; out_j++) {
+            int i = out_i * sH;
+            int j = out_j * sW;
+            float *out_px = out + ((size_t)(out_i - row_start) * out_W + out_j) * out_C;
+
+            for (int co0 = co_start; co0 < co_end; co0 += MC_COUT_BLOCK) {
+                int nc = co_end - co0;
+                if (nc > MC_COUT_BLOCK) nc = MC_COUT_BLOCK;
+                float sum[MC_COUT_BLOCK] = {0.0f};
+
+                for (int ki = 0; ki < kH; ki++) {
+                    int input_i = i + ki - pad_top;
+                    if (input_i < 0 || input_i >= H) continue;
+
+                    for (int kj = 0; kj < kW; kj++) {
+                        int input_j = j + kj - pad_left;
+                        if (input_j < 0 || input_j >= W) continue;
+
+                        const float *x = in + ((size_t)input_i * W + input_j) * C_in;
+                        const float *w = packed + ((size_t)ki * kW + kj) * C_in * C_out + co0;
+
+                        // Reduce over input channels, vectorized across output channels
+                        for (int ci = 0; ci < C_in; ci++) {
+                            float xv = x[ci];
+                            const float *wc = w + (size_t)ci * C_out;
+                            #pragma omp simd
+                            for (int c = 0; c < nc; c++) {
+                                sum[c] += xv * wc[c];
+                            }
+                        }
+                    }
+                }
+
+                for (int c = 0; c < nc; c++) {
+                    out_px[co0 - co_base + c] = ep ? conv2d_epilogue_value(ep, sum[c]) : sum[c];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Compute output rows [row_start, row_end) and channels [c_start, c_end) of
+ * a depthwise layer (each channel convolved with its own kH x kW kernel).
+ * packed is tap-major ([kH][kW][C]); the channel loop is unit stride.
+ */
+static void dw_rows(const float *in, int H, int W, int C, const float *packed, int kH, int kW,
+                    int sH, int sW, float *out, int out_C, int c_base,
+                    int row_start, int row_end, int c_start, int c_end) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_W = (W + sW - 1) / sW;
+    int nc = c_end - c_start;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime) collapse(2)
+    for (int out_i = row_start; out_i < row_end; out_i++) {
+        for (int out_j = 0; out_j < out_W; out_j++) {
+            int i = out_i * sH;
+            int j = out_j * sW;
+            float *out_px = out + ((size_t)(out_i - row_start) * out_W + out_j) * out_C + (c_start - c_base);
+
+            for (int c = 0; c < nc; c++) out_px[c] = 0.0f;
+
+            for (int ki = 0; ki < kH; ki++) {
+                int input_i = i + ki - pad_top;
+                if (input_i < 0 || input_i >= H) continue;
+
+                for (int kj = 0; kj < kW; kj++) {
+                    int input_j = j + kj - pad_left;
+                    if (input_j < 0 || input_j >= W) continue;
+
+                    const float *x = in + ((size_t)input_i * W + input_j) * C + c_start;
+                    const float *w = packed + ((size_t)ki * kW + kj) * C + c_start;
+                    #pragma omp simd
+                    for (int c = 0; c < nc; c++) {
+                        out_px[c] += x[c] * w[c];
+                    }
+                }
+            }
+            if (ep) conv2d_epilogue_row(ep, out_px, nc);
+        }
+    }
+}
+
+/**
+ * Repack depthwise weights [C][kH][kW] into tap-major [kH][kW][C]
+ */
+static float* pack_weights_depthwise(const float *weights, int kH, int kW, int C) {
+    float *packed = (float*)malloc((size_t)kH * kW * C * sizeof(float));
+    if (!packed) {
+        fprintf(stderr, "Error: Failed to allocate memory for packed weights\n");
+        return NULL;
+    }
+    for (int c = 0; c < C; c++) {
+        for (int t = 0; t < kH * kW; t++) {
+            packed[(size_t)t * C + c] = weights[(size_t)c * kH * kW + t];
+        }
+    }
+    return packed;
+}
+
+/**
+ * OpenMP multi-channel convolution layer
+ *
+ * in:      H x W x C_in (NHWC)
+ * weights: C_out x C_in x kH x kW (OIHW)
+ * out:     ceil(H/sH) x ceil(W/sW) x C_out (NHWC)
+ */
+void conv2d_mc_stride(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out) {
+    float *packed = pack_weights_hwio(weights, kH, kW, C_in, C_out);
+    if (!packed) return;
+
+    int out_H = (H + sH - 1) / sH;
+    mc_rows(in, H, W, C_in, packed, kH, kW, C_out, sH, sW, out, C_out, 0, 0, out_H, 0, C_out);
+    free(packed);
+}
+
+/**
+ * OpenMP depthwise convolution layer
+ *
+ * in:      H x W x C (NHWC)
+ * weights: C x kH x kW
+ * out:     ceil(H/sH) x ceil(W/sW) x C (NHWC)
+ */
+void conv2d_mc_depthwise(const float *in, int H, int W, int C, const float *weights, int kH, int kW, int sH, int sW, float *out) {
+    float *packed = pack_weights_depthwise(weights, kH, kW, C);
+    if (!packed) return;
+
+    int out_H = (H + sH - 1) / sH;
+    dw_rows(in, H, W, C, packed, kH, kW, sH, sW, out, C, 0, 0, out_H, 0, C);
+    free(packed);
+}
+
+/**
+ * Contiguous datatype of count floats, so that gathers are counted in rows
+ * or channel planes and C x H x W beyond INT_MAX still fits the int counts.
+ * Aborts if one row or plane alone is too large.
+ */
+static MPI_Datatype mc_slice_type(size_t count, MPI_Comm comm) {
+    if (count > INT_MAX) {
+        fprintf(stderr, "Error: Multi-channel slice of %zu elements exceeds the MPI count limit\n", count);
+        MPI_Abort(comm, 1);
+    }
+    MPI_Datatype slice;
+    MPI_Type_contiguous((int)count, MPI_FLOAT, &slice);
+    MPI_Type_commit(&slice);
+    return slice;
+}
+
+/**
+ * Hybrid MPI+OpenMP multi-channel layer with performance statistics
+ *
+ * Every rank holds the full input and weights (as with conv2d_stride).
+ * split selects the decomposition:
+ *   MC_SPLIT_SPATIAL  - cost-weighted bands of output rows (as conv2d_stride);
+ *                       bands are contiguous in NHWC and gathered with
+ *                       MPI_Allgatherv
+ *   MC_SPLIT_CHANNELS - contiguous blocks of output channels; each rank
+ *                       computes every pixel for its channels and the blocks
+ *                       are interleaved back into NHWC after the gather
+ * Gathers count whole rows or channel planes, so element counts above INT_MAX
+ * are fine as long as one row or plane fits an int.
+ * depthwise selects a depthwise layer (C_out must equal C_in; weights C x kH x kW).
+ * The full output is available on every rank afterwards.
+ */
+void conv2d_mc_stride_mpi_stats(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out, int depthwise, int split, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    if (depthwise) C_out = C_in;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    size_t pixels = (size_t)out_H * out_W;
+
+    stats->output_elements = (long long)pixels * C_out;
+
+    float *packed = depthwise ? pack_weights_depthwise(weights, kH, kW, C_in)
+                              : pack_weights_hwio(weights, kH, kW, C_in, C_out);
+    if (!packed) MPI_Abort(comm, 1);
+
+    int *counts = (int*)malloc(size * sizeof(int));
+    int *displs = (int*)malloc(size * sizeof(int));
+    int *starts = (int*)malloc((size + 1) * sizeof(int));
+    if (!counts || !displs || !starts) {
+        fprintf(stderr, "Error: Failed to allocate memory for decomposition\n");
+        MPI_Abort(comm, 1);
+    }
+
+    if (split == MC_SPLIT_CHANNELS) {
+        // Contiguous output channel blocks
+        for (int p = 0; p <= size; p++) {
+            starts[p] = (int)((long long)C_out * p / size);
+        }
+        int c_start = starts[rank], c_end = starts[rank + 1];
+        int local_C = c_end - c_start;
+
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float *local_out = (float*)conv2d_arena_alloc(arena, pixels * (local_C > 0 ? local_C : 1) * sizeof(float));
+        if (!local_out) {
+            fprintf(stderr, "Error: Failed to allocate memory for local output\n");
+            MPI_Abort(comm, 1);
+        }
+
+        t_comp_start = MPI_Wtime();
+        if (local_C > 0) {
+            if (depthwise) {
+                dw_rows(in, H, W, C_in, packed, kH, kW, sH, sW, local_out, local_C, c_start,
+                        0, out_H, c_start, c_end);
+            } else {
+                mc_rows(in, H, W, C_in, packed, kH, kW, C_out, sH, sW, local_out, local_C, c_start,
+                        0, out_H, c_start, c_end);
+            }
+        }
+        stats->computation_time = MPI_Wtime() - t_comp_start;
+
+        // Gather channel blocks, then interleave them back into NHWC
+        t_comm_start = MPI_Wtime();
+        float *blocks = (float*)conv2d_arena_alloc(arena, pixels * C_out * sizeof(float));
+        if (!blocks) {
+            fprintf(stderr, "Error: Failed to allocate memory for channel blocks\n");
+            MPI_Abort(comm, 1);
+        }
+        MPI_Datatype plane = mc_slice_type(pixels, comm);
+        for (int p = 0; p < size; p++) {
+            counts[p] = starts[p + 1] - starts[p];
+            displs[p] = starts[p];
+        }
+        MPI_Allgatherv(local_out, counts[rank], plane, blocks, counts, displs, plane, comm);
+        MPI_Type_free(&plane);
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->num_communications = 1;
+        stats->bytes_communicated = (long long)pixels * C_out * sizeof(float);
+
+        double t_copy = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            int pc = starts[p + 1] - starts[p];
+            const float *src = blocks + pixels * starts[p];
+            #pragma omp parallel for schedule(static)
+            for (size_t px = 0; px < pixels; px++) {
+                memcpy(out + px * C_out + starts[p], src + px * pc, pc * sizeof(float));
+            }
+        }
+        stats->memory_copy_time = MPI_Wtime() - t_copy;
+
+        conv2d_arena_rewind(arena, mark);
+    } else {
+        // Cost- and speed-weighted output row bands, contiguous in NHWC
+        conv2d_partition_rows(H, W, kH, kW, sH, sW, size, conv2d_get_rank_weights(size), starts);
+        int row_start = starts[rank], row_end = starts[rank + 1];
+        float *local_out = out + (size_t)row_start * out_W * C_out;
+
+        t_comp_start = MPI_Wtime();
+        if (row_end > row_start) {
+            if (depthwise) {
+                dw_rows(in, H, W, C_in, packed, kH, kW, sH, sW, local_out, C_out, 0,
+                        row_start, row_end, 0, C_out);
+            } else {
+                mc_rows(in, H, W, C_in, packed, kH, kW, C_out, sH, sW, local_out, C_out, 0,
+                        row_start, row_end, 0, C_out);
+            }
+        }
+        stats->computation_time = MPI_Wtime() - t_comp_start;
+
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            counts[p] = starts[p + 1] - starts[p];
+            displs[p] = starts[p];
+        }
+        if (size > 1) {
+            MPI_Datatype row = mc_slice_type((size_t)out_W * C_out, comm);
+            MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, out, counts, displs, row, comm);
+            MPI_Type_free(&row);
+            stats->num_communications = 1;
+            stats->bytes_communicated = (long long)pixels * C_out * sizeof(float);
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+    }
+    stats->communication_time = stats->broadcast_time + stats->memory_copy_time;
+
+    free(counts);
+    free(displs);
+    free(starts);
+    free(packed);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP multi-channel layer (see conv2d_mc_stride_mpi_stats)
+ */
+void conv2d_mc_stride_mpi(const float *in, int H, int W, int C_in, const float *weights, int kH, int kW, int C_out, int sH, int sW, float *out, int depthwise, int split, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_mc_stride_mpi_stats(in, H, W, C_in, weights, kH, kW, C_out, sH, sW, out, depthwise, split, comm, &stats);
+}
+
+/**
+ * Convert a C x H x W (planar, NCHW) tensor to H x W x C (NHWC)
+ */
+void conv2d_nchw_to_nhwc(const float *src, int C, int H, int W, float *dst) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < H; i++) {
+        for (int j = 0; j < W; j++) {
+            for (int c = 0; c < C; c++) {
+                dst[((size_t)i * W + j) * C + c] = src[((size_t)c * H + i) * W + j];
+            }
+        }
+    }
+}
+
+/**
+ * Convert an H x W x C (NHWC) tensor back to C x H x W (planar, NCHW)
+ */
+void conv2d_nhwc_to_nchw(const float *src, int C, int H, int W, float *dst) {
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < C; c++) {
+        for (int i = 0; i < H; i++) {
+            for (int j = 0; j < W; j++) {
+                dst[((size_t)c * H + i) * W + j] = src[((size_t)i * W + j) * C + c];
+            }
+        }
+    }
+}
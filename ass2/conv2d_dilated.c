@@ -0,0 +1,235 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Dilated (atrous) convolution
+ *
+ * With dilation (dH, dW) tap (ki, kj) reads input pixel
+ * (i * sH + ki * dH - pad_top, j * sW + kj * dW - pad_left). "Same" padding
+ * centres the dilated extent (kH - 1) * dH + 1, so pad_top = (kH - 1) * dH / 2,
+ * the output stays ceil(H/sH) x ceil(W/sW), and a rank's halo grows to
+ * (kH - 1) * dH input rows.
+ *
+ * The engines apply one tap at a time to a block of output columns (as the
+ * tap-list engine does), so a dilation only changes each tap's row and column
+ * offset. What would break unit-stride access is the column stride: output
+ * column j reads input column j * sW + c. The input band is therefore
+ * deinterleaved once into sW column phases (phase q holds columns q, q + sW,
+ * ...), after which every tap is a unit-stride axpy over phase
+ * (c mod sW) starting at floor(c / sW). With sW = 1 the rows are used as is.
+ */
+
+// Output columns accumulated together (16 KB of floats)
+#define DILATED_COL_BLOCK 4096
+
+/**
+ * Serial reference implementation with stride and dilation
+ */
+void conv2d_serial_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_top = (kH - 1) * dH / 2;
+    int pad_left = (kW - 1) * dW / 2;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    for (int out_i = 0; out_i < out_H; out_i++) {
+        for (int out_j = 0; out_j < out_W; out_j++) {
+            float sum = 0.0f;
+            int i = out_i * sH;
+            int j = out_j * sW;
+
+            for (int ki = 0; ki < kH; ki++) {
+                for (int kj = 0; kj < kW; kj++) {
+                    int input_i = i + ki * dH - pad_top;
+                    int input_j = j + kj * dW - pad_left;
+
+                    if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
+                        sum += f[input_i][input_j] * g[ki][kj];
+                    }
+                }
+            }
+            output[out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
+        }
+    }
+}
+
+/**
+ * One output row from the phase-deinterleaved band: band[input_i - row0]
+ * holds sW phases of phase_W floats each
+ */
+static void dilated_row(float **band, int row0, int H, int W, const SparseKernel *sk,
+                        int sH, int sW, int dH, int dW, int phase_W, int out_i, float *out) {
+    int pad_top = (sk->kH - 1) * dH / 2;
+    int pad_left = (sk->kW - 1) * dW / 2;
+    int out_W = (W + sW - 1) / sW;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    for (int j0 = 0; j0 < out_W; j0 += DILATED_COL_BLOCK) {
+        int j1 = j0 + DILATED_COL_BLOCK < out_W ? j0 + DILATED_COL_BLOCK : out_W;
+        for (int j = j0; j < j1; j++) out[j] = 0.0f;
+
+        for (int r = 0; r < sk->num_rows; r++) {
+            int input_i = out_i * sH + sk->row_dy[r] * dH - pad_top;
+            if (input_i < 0 || input_i >= H) continue;
+            const float *src_row = band[input_i - row0];
+
+            for (int t = sk->row_first[r]; t < sk->row_first[r + 1]; t++) {
+                int c = sk->tap_dx[t] * dW - pad_left;
+                float w = sk->tap_w[t];
+
+                // Columns whose input_j = j * sW + c is inside the row
+                int lo = c < 0 ? (-c + sW - 1) / sW : 0;
+                int hi = W - 1 - c >= 0 ? (W - 1 - c) / sW + 1 : 0;
+                if (lo < j0) lo = j0;
+                if (hi > j1) hi = j1;
+
+                // Input column j * sW + c is entry j + base of phase q
+                int q = ((c % sW) + sW) % sW;
+                int base = (c - q) / sW;
+                const float *src = src_row + (size_t)q * phase_W + base;
+
+                #pragma omp simd
+                for (int j = lo; j < hi; j++) {
+                    out[j] += w * src[j];
+                }
+            }
+        }
+        if (ep) conv2d_epilogue_row(ep, out + j0, j1 - j0);
+    }
+}
+
+/**
+ * Shared engine: output rows split across the ranks of comm, OpenMP over rows
+ * when use_omp is set
+ */
+static void dilated_engine(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW,
+                           int dH, int dW, float **output, MPI_Comm comm, int use_omp, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+    Conv2dArena *arena = conv2d_thread_arena();
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int pad_top = (kH - 1) * dH / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    int phase_W = (W + sW - 1) / sW;
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    SparseKernel sk;
+    if (conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for dilated convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    if (local_end > local_start) {
+        // Input band with the dilated halo
+        int input_start = local_start * sH - pad_top;
+        int input_end = (local_end - 1) * sH + (kH - 1) * dH + 1 - pad_top;
+        if (input_start < 0) input_start = 0;
+        if (input_end > H) input_end = H;
+        int input_rows = input_end - input_start;
+
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float **band = f + input_start;
+        if (size > 1 || sW > 1) {
+            double t_copy = MPI_Wtime();
+            band = conv2d_arena_alloc_2d(arena, input_rows, sW * phase_W);
+            if (!band) {
+                fprintf(stderr, "Error: Failed to allocate memory for local input\n");
+                MPI_Abort(comm, 1);
+            }
+
+            // Deinterleave each row into its sW column phases
+            #pragma omp parallel for schedule(static) if(use_omp)
+            for (int i = 0; i < input_rows; i++) {
+                const float *src = f[input_start + i];
+                if (sW == 1) {
+                    memcpy(band[i], src, (size_t)W * sizeof(float));
+                    continue;
+                }
+                for (int q = 0; q < sW; q++) {
+                    float *dst = band[i] + (size_t)q * phase_W;
+                    int n = (W - q + sW - 1) / sW;
+                    for (int m = 0; m < n; m++) dst[m] = src[m * sW + q];
+                }
+            }
+            stats->memory_copy_time = MPI_Wtime() - t_copy;
+        }
+
+        t_comp_start = MPI_Wtime();
+        TuneParams tune;
+        conv2d_get_tune_params(&tune);
+        omp_set_schedule(tune.schedule, tune.chunk_size);
+        #pragma omp parallel for schedule(runtime) if(use_omp)
+        for (int out_i = local_start; out_i < local_end; out_i++) {
+            dilated_row(band, input_start, H, W, &sk, sH, sW, dH, dW, phase_W, out_i, output[out_i]);
+        }
+        stats->computation_time = MPI_Wtime() - t_comp_start;
+
+        conv2d_arena_rewind(arena, mark);
+    }
+
+    // Gather results to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                MPI_Bcast(output[i], out_W, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)out_W * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    conv2d_sparse_free(&sk);
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * OpenMP implementation with stride and dilation
+ */
+void conv2d_omp_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output) {
+    PerfStats stats;
+    dilated_engine(f, H, W, g, kH, kW, sH, sW, dH, dW, output, MPI_COMM_SELF, 1, &stats);
+}
+
+/**
+ * MPI-only implementation with stride and dilation, with performance statistics
+ */
+void conv2d_mpi_dilated_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm, PerfStats *stats) {
+    dilated_engine(f, H, W, g, kH, kW, sH, sW, dH, dW, output, comm, 0, stats);
+}
+
+void conv2d_mpi_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    dilated_engine(f, H, W, g, kH, kW, sH, sW, dH, dW, output, comm, 0, &stats);
+}
+
+/**
+ * Hybrid MPI+OpenMP implementation with stride and dilation, with performance
+ * statistics
+ */
+void conv2d_stride_dilated_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm, PerfStats *stats) {
+    dilated_engine(f, H, W, g, kH, kW, sH, sW, dH, dW, output, comm, 1, stats);
+}
+
+void conv2d_stride_dilated(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int dH, int dW, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    dilated_engine(f, H, W, g, kH, kW, sH, sW, dH, dW, output, comm, 1, &stats);
+}
@@ -0,0 +1,203 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Fused epilogues: bias, activation, scale/clamp and 2x2 max-pooling
+ *
+ * Convolution outputs are usually post-processed with a bias add, an
+ * activation or clamp and often a 2x2 max-pool, each another full pass over
+ * the output array. The pointwise part is set once with conv2d_set_epilogue
+ * and every engine applies it where it stores a finished output value (or a
+ * finished row block, while it is still in cache), so it costs no extra
+ * pass. Pooling changes the output shape, so it has its own engine,
+ * conv2d_stride_pool: it computes two output rows into per-thread scratch,
+ * applies the pointwise epilogue and max-pools them straight into the pooled
+ * row. MPI ranks split the pooled rows, so every pooling window lies inside
+ * one rank's band and the full-resolution output is never stored or sent.
+ */
+
+static Conv2dEpilogue epilogue;
+static int epilogue_set = 0;
+
+/**
+ * Identity epilogue: no bias, no activation, scale 1, no clamp
+ */
+void conv2d_epilogue_default(Conv2dEpilogue *ep) {
+    ep->bias = 0.0f;
+    ep->activation = CONV2D_ACT_NONE;
+    ep->alpha = 0.01f;
+    ep->scale = 1.0f;
+    ep->clamp_min = -FLT_MAX;
+    ep->clamp_max = FLT_MAX;
+}
+
+/**
+ * Set the pointwise epilogue applied by every engine (NULL disables it)
+ */
+void conv2d_set_epilogue(const Conv2dEpilogue *ep) {
+    if (ep) {
+        epilogue = *ep;
+        epilogue_set = 1;
+    } else {
+        epilogue_set = 0;
+    }
+}
+
+/**
+ * The current epilogue, or NULL when none is set
+ */
+const Conv2dEpilogue* conv2d_get_epilogue(void) {
+    return epilogue_set ? &epilogue : NULL;
+}
+
+const char* conv2d_activation_name(int activation) {
+    switch (activation) {
+        case CONV2D_ACT_RELU: return "relu";
+        case CONV2D_ACT_LEAKY_RELU: return "leaky";
+        default: return "none";
+    }
+}
+
+int conv2d_activation_from_name(const char *name) {
+    if (strcmp(name, "relu") == 0) return CONV2D_ACT_RELU;
+    if (strcmp(name, "leaky") == 0) return CONV2D_ACT_LEAKY_RELU;
+    if (strcmp(name, "none") == 0) return CONV2D_ACT_NONE;
+    return -1;
+}
+
+/**
+ * Apply the epilogue to n consecutive finished values in place
+ */
+void conv2d_epilogue_row(const Conv2dEpilogue *ep, float *row, int n) {
+    #pragma omp simd
+    for (int j = 0; j < n; j++) {
+        row[j] = conv2d_epilogue_value(ep, row[j]);
+    }
+}
+
+/**
+ * Unfused 2x2 max-pool (stride 2) of a rows x cols array; windows at an odd
+ * edge use the values that exist. pooled is ceil(rows/2) x ceil(cols/2).
+ */
+void conv2d_maxpool2x2(float **in, int rows, int cols, float **pooled) {
+    int pool_H = (rows + 1) / 2;
+    int pool_W = (cols + 1) / 2;
+    for (int pi = 0; pi < pool_H; pi++) {
+        const float *r0 = in[2 * pi];
+        const float *r1 = 2 * pi + 1 < rows ? in[2 * pi + 1] : r0;
+        for (int pj = 0; pj < pool_W; pj++) {
+            int j1 = 2 * pj + 1 < cols ? 2 * pj + 1 : 2 * pj;
+            float m = r0[2 * pj];
+            if (r0[j1] > m) m = r0[j1];
+            if (r1[2 * pj] > m) m = r1[2 * pj];
+            if (r1[j1] > m) m = r1[j1];
+            pooled[pi][pj] = m;
+        }
+    }
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution with the pointwise epilogue and a fused 2x2
+ * max-pool, with performance statistics
+ *
+ * pooled is ceil(out_H/2) x ceil(out_W/2) for out_H x out_W the convolution
+ * output. Ranks split the pooled rows by modelled cost, so pooling windows
+ * never straddle two bands. Pass MPI_COMM_SELF for the OpenMP-only engine.
+ */
+void conv2d_stride_pool_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **pooled, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    int pool_H = (out_H + 1) / 2;
+    int pool_W = (out_W + 1) / 2;
+    stats->output_elements = (long long)pool_H * pool_W;
+
+    // Pooled row p covers output rows 2p and 2p + 1, i.e. a convolution with
+    // vertical stride 2 * sH for the cost model
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, 2 * sH, sW, size, comm);
+    SparseKernel sk;
+    if (conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for pooled convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, 2 * sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel
+    {
+        // The two output rows of one pooling window, per thread
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float **pair = conv2d_arena_alloc_2d(arena, 2, out_W + 1);
+        if (!pair) {
+            fprintf(stderr, "Error: Failed to allocate memory for pooling rows\n");
+            MPI_Abort(comm, 1);
+        }
+
+        #pragma omp for schedule(runtime)
+        for (int pi = local_start; pi < local_end; pi++) {
+            int rows = 2 * pi + 1 < out_H ? 2 : 1;
+            for (int r = 0; r < rows; r++) {
+                // Applies the pointwise epilogue as well
+                conv2d_sparse_row(f, 0, H, W, &sk, sH, sW, 2 * pi + r, pair[r], 0, out_W);
+            }
+            if (rows == 1) memcpy(pair[1], pair[0], (size_t)out_W * sizeof(float));
+            // An odd last column pools with itself
+            pair[0][out_W] = pair[0][out_W - 1];
+            pair[1][out_W] = pair[1][out_W - 1];
+
+            const float *r0 = pair[0], *r1 = pair[1];
+            float *dst = pooled[pi];
+            #pragma omp simd
+            for (int pj = 0; pj < pool_W; pj++) {
+                float a = r0[2 * pj] > r0[2 * pj + 1] ? r0[2 * pj] : r0[2 * pj + 1];
+                float b = r1[2 * pj] > r1[2 * pj + 1] ? r1[2 * pj] : r1[2 * pj + 1];
+                dst[pj] = a > b ? a : b;
+            }
+        }
+        conv2d_arena_rewind(arena, mark);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather the pooled rows to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                MPI_Bcast(pooled[i], pool_W, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)pool_W * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    conv2d_sparse_free(&sk);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution with fused epilogue and 2x2 max-pool (see
+ * conv2d_stride_pool_stats)
+ */
+void conv2d_stride_pool(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **pooled, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_pool_stats(f, H, W, g, kH, kW, sH, sW, pooled, comm, &stats);
+}
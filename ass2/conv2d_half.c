@@ -0,0 +1,352 @@
+#include "conv2d.h"
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HALF_HAVE_X86 1
+#endif
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Half-precision storage (fp16 / bf16) with fp32 accumulation
+ *
+ * For small kernels the large runs are bound by memory bandwidth and by the
+ * float32 output exchange. Here the input, the output and every MPI buffer
+ * hold 16-bit values; each tap loads 16-bit input, widens it to fp32 in
+ * registers and accumulates in fp32, and only the finished output row is
+ * rounded back to 16 bits.
+ *
+ * fp16 widening/narrowing uses F16C (vcvtph2ps / vcvtps2ph) when the CPU has
+ * it, selected once at run time, so the binary still runs on CPUs without
+ * F16C. bf16 is the upper half of a float32, so its conversion is a shift
+ * (plus round-to-nearest-even on the way down) that the compiler vectorizes.
+ */
+
+typedef void (*HalfAxpyFn)(const uint16_t *src, float w, float *acc, int n);
+typedef void (*HalfConvertFn)(const uint16_t *src, float *dst, size_t n);
+typedef void (*HalfNarrowFn)(const float *src, uint16_t *dst, size_t n);
+
+/*
+ * Scalar conversions (round to nearest even, inf/nan and subnormals kept)
+ */
+static inline float f16_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        // Zero or subnormal: mant * 2^-24 is exact in float
+        float v = (float)mant * (1.0f / 16777216.0f);
+        memcpy(&x, &v, sizeof(x));
+        x |= sign;
+    } else if (exp == 31) {
+        x = sign | 0x7f800000u | (mant << 13);
+    } else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline uint16_t float_to_f16(float value) {
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t biased = (x >> 23) & 0xff;
+    uint32_t mant = x & 0x7fffff;
+    int exp = (int)biased - 127 + 15;
+
+    if (biased == 0xff) return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));
+    if (exp >= 31) return (uint16_t)(sign | 0x7c00);
+    if (exp <= 0) {
+        // Subnormal half (or underflow to zero)
+        if (exp < -10) return (uint16_t)sign;
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    // A carry out of the mantissa correctly bumps the exponent (up to inf)
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+}
+
+static inline float bf16_to_float(uint16_t h) {
+    uint32_t x = (uint32_t)h << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline uint16_t float_to_bf16(float value) {
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    if ((x & 0x7fffffffu) > 0x7f800000u) return (uint16_t)((x >> 16) | 0x40);  // quiet nan
+    x += 0x7fffu + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+/*
+ * Portable kernels
+ */
+static void axpy_f16_scalar(const uint16_t *src, float w, float *acc, int n) {
+    for (int j = 0; j < n; j++) acc[j] += w * f16_to_float(src[j]);
+}
+
+static void widen_f16_scalar(const uint16_t *src, float *dst, size_t n) {
+    for (size_t j = 0; j < n; j++) dst[j] = f16_to_float(src[j]);
+}
+
+static void narrow_f16_scalar(const float *src, uint16_t *dst, size_t n) {
+    for (size_t j = 0; j < n; j++) dst[j] = float_to_f16(src[j]);
+}
+
+static void axpy_bf16(const uint16_t *src, float w, float *acc, int n) {
+    #pragma omp simd
+    for (int j = 0; j < n; j++) acc[j] += w * bf16_to_float(src[j]);
+}
+
+static void widen_bf16(const uint16_t *src, float *dst, size_t n) {
+    #pragma omp simd
+    for (size_t j = 0; j < n; j++) dst[j] = bf16_to_float(src[j]);
+}
+
+static void narrow_bf16(const float *src, uint16_t *dst, size_t n) {
+    for (size_t j = 0; j < n; j++) dst[j] = float_to_bf16(src[j]);
+}
+
+#ifdef HALF_HAVE_X86
+/*
+ * F16C kernels, compiled for F16C/FMA only and called after a CPU check
+ */
+__attribute__((target("avx,f16c,fma")))
+static void axpy_f16_f16c(const uint16_t *src, float w, float *acc, int n) {
+    __m256 vw = _mm256_set1_ps(w);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 x = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + j)));
+        _mm256_storeu_ps(acc + j, _mm256_fmadd_ps(vw, x, _mm256_loadu_ps(acc + j)));
+    }
+    for (; j < n; j++) acc[j] += w * f16_to_float(src[j]);
+}
+
+__attribute__((target("avx,f16c")))
+static void widen_f16_f16c(const uint16_t *src, float *dst, size_t n) {
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        _mm256_storeu_ps(dst + j, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + j))));
+    }
+    for (; j < n; j++) dst[j] = f16_to_float(src[j]);
+}
+
+__attribute__((target("avx,f16c")))
+static void narrow_f16_f16c(const float *src, uint16_t *dst, size_t n) {
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + j), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + j), h);
+    }
+    for (; j < n; j++) dst[j] = float_to_f16(src[j]);
+}
+#endif
+
+/**
+ * 1 if the fp16 kernels use F16C on this CPU
+ */
+int conv2d_half_has_f16c(void) {
+#ifdef HALF_HAVE_X86
+    static int has_f16c = -1;
+    if (has_f16c < 0) {
+        __builtin_cpu_init();
+        has_f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c") &&
+                   __builtin_cpu_supports("fma");
+    }
+    return has_f16c;
+#else
+    return 0;
+#endif
+}
+
+static HalfAxpyFn select_axpy(int dtype) {
+    if (dtype == CONV2D_DTYPE_BF16) return axpy_bf16;
+#ifdef HALF_HAVE_X86
+    if (conv2d_half_has_f16c()) return axpy_f16_f16c;
+#endif
+    return axpy_f16_scalar;
+}
+
+static HalfConvertFn select_widen(int dtype) {
+    if (dtype == CONV2D_DTYPE_BF16) return widen_bf16;
+#ifdef HALF_HAVE_X86
+    if (conv2d_half_has_f16c()) return widen_f16_f16c;
+#endif
+    return widen_f16_scalar;
+}
+
+static HalfNarrowFn select_narrow(int dtype) {
+    if (dtype == CONV2D_DTYPE_BF16) return narrow_bf16;
+#ifdef HALF_HAVE_X86
+    if (conv2d_half_has_f16c()) return narrow_f16_f16c;
+#endif
+    return narrow_f16_scalar;
+}
+
+/**
+ * Convert n floats to 16-bit storage (dtype CONV2D_DTYPE_F16 or _BF16)
+ */
+void conv2d_float_to_half(const float *src, uint16_t *dst, size_t n, int dtype) {
+    select_narrow(dtype)(src, dst, n);
+}
+
+/**
+ * Convert n 16-bit values (dtype CONV2D_DTYPE_F16 or _BF16) to floats
+ */
+void conv2d_half_to_float(const uint16_t *src, float *dst, size_t n, int dtype) {
+    select_widen(dtype)(src, dst, n);
+}
+
+/**
+ * Parse "f32", "f16"/"fp16" or "bf16"; returns -1 for anything else
+ */
+int conv2d_dtype_from_name(const char *name) {
+    if (strcmp(name, "f32") == 0 || strcmp(name, "fp32") == 0) return CONV2D_DTYPE_F32;
+    if (strcmp(name, "f16") == 0 || strcmp(name, "fp16") == 0) return CONV2D_DTYPE_F16;
+    if (strcmp(name, "bf16") == 0) return CONV2D_DTYPE_BF16;
+    return -1;
+}
+
+const char* conv2d_dtype_name(int dtype) {
+    return dtype == CONV2D_DTYPE_F16 ? "f16" : dtype == CONV2D_DTYPE_BF16 ? "bf16" : "f32";
+}
+
+size_t conv2d_dtype_size(int dtype) {
+    return dtype == CONV2D_DTYPE_F32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution on 16-bit storage with performance statistics
+ *
+ * f:      H x W input, contiguous, dtype storage, valid on every rank
+ * g:      kH x kW fp32 kernel
+ * output: out_H x out_W, contiguous, dtype storage; complete on every rank
+ *
+ * Output rows are split by the same cost model as conv2d_stride and
+ * exchanged as 16-bit rows, so the gather moves half the bytes.
+ */
+void conv2d_stride_half_stats(const uint16_t *f, int H, int W, int dtype, float **g, int kH, int kW, int sH, int sW, uint16_t *output, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    HalfAxpyFn axpy = select_axpy(dtype);
+    HalfConvertFn widen = select_widen(dtype);
+    HalfNarrowFn narrow = select_narrow(dtype);
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel
+    {
+        // fp32 accumulator row (and a widened input row for sW > 1) per thread
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float *acc = (float*)conv2d_arena_alloc(arena, (size_t)out_W * sizeof(float));
+        float *wide = sW > 1 ? (float*)conv2d_arena_alloc(arena, (size_t)W * sizeof(float)) : NULL;
+        if (!acc || (sW > 1 && !wide)) {
+            fprintf(stderr, "Error: Failed to allocate memory for accumulator rows\n");
+            MPI_Abort(comm, 1);
+        }
+
+        #pragma omp for schedule(runtime)
+        for (int out_i = local_start; out_i < local_end; out_i++) {
+            memset(acc, 0, (size_t)out_W * sizeof(float));
+
+            for (int ki = 0; ki < kH; ki++) {
+                int input_i = out_i * sH + ki - pad_top;
+                if (input_i < 0 || input_i >= H) continue;
+                const uint16_t *row = f + (size_t)input_i * W;
+                if (sW > 1) widen(row, wide, (size_t)W);
+
+                for (int kj = 0; kj < kW; kj++) {
+                    // Output columns whose tap kj lands inside the row
+                    int first = pad_left - kj;
+                    int lo = first > 0 ? (first + sW - 1) / sW : 0;
+                    int last = W - 1 - kj + pad_left;
+                    int hi = last >= 0 ? last / sW + 1 : 0;
+                    if (hi > out_W) hi = out_W;
+                    if (hi <= lo) continue;
+
+                    float w = g[ki][kj];
+                    if (sW == 1) {
+                        axpy(row + lo + kj - pad_left, w, acc + lo, hi - lo);
+                    } else {
+                        const float *src = wide + kj - pad_left;
+                        for (int out_j = lo; out_j < hi; out_j++) {
+                            acc[out_j] += w * src[out_j * sW];
+                        }
+                    }
+                }
+            }
+            if (ep) conv2d_epilogue_row(ep, acc, out_W);
+            narrow(acc, output + (size_t)out_i * out_W, (size_t)out_W);
+        }
+        conv2d_arena_rewind(arena, mark);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather results to all processes as 16-bit rows
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
+
+            for (int i = 0; i < p_rows; i++) {
+                MPI_Bcast(output + (size_t)(p_start + i) * out_W, out_W, MPI_UINT16_T, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)out_W * sizeof(uint16_t);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution on 16-bit storage (see conv2d_stride_half_stats)
+ */
+void conv2d_stride_half(const uint16_t *f, int H, int W, int dtype, float **g, int kH, int kW, int sH, int sW, uint16_t *output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_half_stats(f, H, W, dtype, g, kH, kW, sH, sW, output, comm, &stats);
+}
@@ -0,0 +1,211 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Incremental recomputation for dirty input rectangles
+ *
+ * When successive inputs differ only in small regions, only the output
+ * pixels whose receptive field overlaps a changed rectangle need to be
+ * recomputed. Each dirty input rectangle is expanded by the kernel footprint
+ * and mapped through the stride to an output rectangle; those are rasterised
+ * onto a grid of CONV2D_DIRTY_TILE output tiles so overlapping regions are
+ * computed once. Every rank recomputes the dirty tiles inside its own output
+ * rows (OpenMP over tiles, tap-list kernel), then the updated pixels are
+ * packed and exchanged with one MPI_Allgatherv. All ranks derive the same
+ * tile list and partition, so no sizes have to be exchanged.
+ */
+
+/**
+ * Output rectangle whose receptive fields overlap the input rectangle r,
+ * clipped to the output. Returns 0 if it is empty.
+ */
+int conv2d_dirty_output_rect(Conv2dRect r, int H, int W, int kH, int kW, int sH, int sW, Conv2dRect *out) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    // Clip the input rectangle first
+    int y0 = r.y > 0 ? r.y : 0, y1 = r.y + r.h < H ? r.y + r.h : H;
+    int x0 = r.x > 0 ? r.x : 0, x1 = r.x + r.w < W ? r.x + r.w : W;
+    if (y0 >= y1 || x0 >= x1) return 0;
+
+    // out_i reads input rows [out_i*sH - pad_top, out_i*sH - pad_top + kH - 1]
+    int lo_i = y0 - (kH - 1) + pad_top;
+    int i0 = lo_i > 0 ? (lo_i + sH - 1) / sH : 0;
+    int i1 = (y1 - 1 + pad_top) / sH + 1;
+    int lo_j = x0 - (kW - 1) + pad_left;
+    int j0 = lo_j > 0 ? (lo_j + sW - 1) / sW : 0;
+    int j1 = (x1 - 1 + pad_left) / sW + 1;
+    if (i1 > out_H) i1 = out_H;
+    if (j1 > out_W) j1 = out_W;
+    if (i0 >= i1 || j0 >= j1) return 0;
+
+    out->y = i0;
+    out->x = j0;
+    out->h = i1 - i0;
+    out->w = j1 - j0;
+    return 1;
+}
+
+/**
+ * Recompute the output pixels affected by the dirty input rectangles, with
+ * performance statistics
+ *
+ * f is the new input and output holds the result for the previous input, on
+ * every rank (as for conv2d_stride). On return output is up to date on every
+ * rank. Returns the number of output pixels recomputed.
+ */
+long long conv2d_update_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, const Conv2dRect *dirty, int num_dirty, float **output, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+    Conv2dArena *arena = conv2d_thread_arena();
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    int tile = CONV2D_DIRTY_TILE;
+    int tiles_y = (out_H + tile - 1) / tile;
+    int tiles_x = (out_W + tile - 1) / tile;
+
+    // Output rows are owned as in conv2d_stride (cost-weighted split)
+    const double *weights = conv2d_get_rank_weights(size);
+    int *row_starts = (int*)malloc((size + 1) * sizeof(int));
+    int *counts = (int*)malloc(size * sizeof(int));
+    int *displs = (int*)malloc(size * sizeof(int));
+    SparseKernel sk;
+    if (!row_starts || !counts || !displs || conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for incremental update\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_partition_rows(H, W, kH, kW, sH, sW, size, weights, row_starts);
+
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    size_t cells = (size_t)tiles_y * tiles_x;
+    uint8_t *mask = (uint8_t*)conv2d_arena_alloc(arena, cells > 0 ? cells : 1);
+    // A tile split by a band boundary becomes one piece per owning rank
+    int max_pieces = (int)cells + size * tiles_x;
+    Conv2dRect *pieces = (Conv2dRect*)conv2d_arena_alloc(arena, (size_t)(max_pieces > 0 ? max_pieces : 1) * sizeof(Conv2dRect));
+    int *piece_owner = (int*)conv2d_arena_alloc(arena, (size_t)(max_pieces > 0 ? max_pieces : 1) * sizeof(int));
+    if (!mask || !pieces || !piece_owner) {
+        fprintf(stderr, "Error: Failed to allocate memory for dirty tiles\n");
+        MPI_Abort(comm, 1);
+    }
+    memset(mask, 0, cells);
+
+    // Rasterise the affected output rectangles onto the tile grid
+    for (int d = 0; d < num_dirty; d++) {
+        Conv2dRect o;
+        if (!conv2d_dirty_output_rect(dirty[d], H, W, kH, kW, sH, sW, &o)) continue;
+        for (int ty = o.y / tile; ty <= (o.y + o.h - 1) / tile; ty++) {
+            memset(mask + (size_t)ty * tiles_x + o.x / tile, 1, (size_t)((o.x + o.w - 1) / tile - o.x / tile + 1));
+        }
+    }
+
+    // Dirty tiles in rank order, split at band boundaries
+    int num_pieces = 0;
+    long long recomputed = 0;
+    for (int p = 0; p < size; p++) {
+        int p_start = row_starts[p], p_end = row_starts[p + 1];
+        displs[p] = 0;
+        counts[p] = 0;
+        if (p_start >= p_end) continue;
+        for (int ty = p_start / tile; ty <= (p_end - 1) / tile; ty++) {
+            int i0 = ty * tile > p_start ? ty * tile : p_start;
+            int i1 = (ty + 1) * tile < p_end ? (ty + 1) * tile : p_end;
+            for (int tx = 0; tx < tiles_x; tx++) {
+                if (!mask[(size_t)ty * tiles_x + tx]) continue;
+                int j0 = tx * tile;
+                int j1 = j0 + tile < out_W ? j0 + tile : out_W;
+                Conv2dRect piece = { i0, j0, i1 - i0, j1 - j0 };
+                pieces[num_pieces] = piece;
+                piece_owner[num_pieces] = p;
+                num_pieces++;
+                counts[p] += piece.h * piece.w;
+            }
+        }
+        recomputed += counts[p];
+    }
+    for (int p = 1; p < size; p++) {
+        displs[p] = displs[p - 1] + counts[p - 1];
+    }
+
+    // Recompute this rank's pieces
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime)
+    for (int k = 0; k < num_pieces; k++) {
+        if (piece_owner[k] != rank) continue;
+        Conv2dRect r = pieces[k];
+        conv2d_sparse_block(f, 0, H, W, &sk, sH, sW, output, r.y, r.y + r.h, r.x, r.x + r.w);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+    stats->output_elements = counts[rank];
+
+    // Pack the updated pixels, exchange them and unpack the other ranks' pieces
+    if (size > 1 && recomputed > 0) {
+        t_comm_start = MPI_Wtime();
+        float *packed = (float*)conv2d_arena_alloc(arena, (size_t)recomputed * sizeof(float));
+        if (!packed) {
+            fprintf(stderr, "Error: Failed to allocate memory for packed tiles\n");
+            MPI_Abort(comm, 1);
+        }
+
+        double t_copy = MPI_Wtime();
+        size_t offset = displs[rank];
+        for (int k = 0; k < num_pieces; k++) {
+            if (piece_owner[k] != rank) continue;
+            Conv2dRect r = pieces[k];
+            for (int i = r.y; i < r.y + r.h; i++) {
+                memcpy(packed + offset, output[i] + r.x, (size_t)r.w * sizeof(float));
+                offset += r.w;
+            }
+        }
+        stats->memory_copy_time = MPI_Wtime() - t_copy;
+
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_FLOAT, packed, counts, displs, MPI_FLOAT, comm);
+        stats->num_communications++;
+        stats->bytes_communicated += recomputed * (long long)sizeof(float);
+
+        t_copy = MPI_Wtime();
+        offset = 0;
+        for (int k = 0; k < num_pieces; k++) {
+            Conv2dRect r = pieces[k];
+            size_t n = (size_t)r.h * r.w;
+            if (piece_owner[k] != rank) {
+                for (int i = 0; i < r.h; i++) {
+                    memcpy(output[r.y + i] + r.x, packed + offset + (size_t)i * r.w, (size_t)r.w * sizeof(float));
+                }
+            }
+            offset += n;
+        }
+        stats->memory_copy_time += MPI_Wtime() - t_copy;
+        stats->communication_time = MPI_Wtime() - t_comm_start;
+    }
+
+    conv2d_arena_rewind(arena, mark);
+    conv2d_sparse_free(&sk);
+    free(displs);
+    free(counts);
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+    return recomputed;
+}
+
+/**
+ * Incremental update of output for the dirty input rectangles (see
+ * conv2d_update_stats)
+ */
+long long conv2d_update(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, const Conv2dRect *dirty, int num_dirty, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    return conv2d_update_stats(f, H, W, g, kH, kW, sH, sW, dirty, num_dirty, output, comm, &stats);
+}
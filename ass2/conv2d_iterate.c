@@ -0,0 +1,362 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Iterated convolution with temporal blocking
+ *
+ * A diffusion or smoothing iteration applies the same "same"-padded,
+ * stride-1 kernel T times. As T conv2d_stride calls, every step sweeps the
+ * whole array through memory and gathers the whole output to every rank.
+ * Here each rank keeps its own band of rows plus ghost rows, block * halo
+ * deep, above and below. One MPI_Sendrecv pair per block refreshes the
+ * ghosts; then the band advances block steps with no communication, because
+ * each step only invalidates one halo of ghost rows. Inside the band the
+ * steps are time-skewed over tile x tile tiles: a tile's region grows by one
+ * halo per remaining step, and all block steps of a tile are computed in
+ * per-thread ping-pong buffers before the last step is written back. Each
+ * block then costs one read and one write of the band instead of one per
+ * step, in exchange for recomputing the overlap of neighbouring tiles.
+ */
+
+/**
+ * One step over rectangle r (rows and columns of the H x W image, stride 1)
+ * with zero padding at the image border. in[y - in_y0][x - in_x0] is the
+ * previous step at (y, x); out[i - out_y0][j - out_x0] receives this step.
+ */
+static void iterate_rect(float **in, int in_y0, int in_x0, int H, int W, float **g, int kH, int kW,
+                         Conv2dRect r, float **out, int out_y0, int out_x0, const Conv2dEpilogue *ep) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int j0 = r.x, j1 = r.x + r.w;
+
+    for (int i = r.y; i < r.y + r.h; i++) {
+        float *dst = out[i - out_y0] - out_x0;
+        for (int j = j0; j < j1; j++) dst[j] = 0.0f;
+
+        for (int ki = 0; ki < kH; ki++) {
+            int y = i + ki - pad_top;
+            if (y < 0 || y >= H) continue;
+            const float *src = in[y - in_y0] - in_x0;
+
+            for (int kj = 0; kj < kW; kj++) {
+                int dx = kj - pad_left;
+                float w = g[ki][kj];
+                int lo = -dx > j0 ? -dx : j0;
+                int hi = W - dx < j1 ? W - dx : j1;
+                const float *s = src + dx;
+                #pragma omp simd
+                for (int j = lo; j < hi; j++) {
+                    dst[j] += w * s[j];
+                }
+            }
+        }
+        if (ep) conv2d_epilogue_row(ep, dst + j0, r.w);
+    }
+}
+
+/**
+ * Region of step k (of a block of n steps) that tile r of step n depends
+ * on: r grown by n - k halos, clipped to the image
+ */
+static Conv2dRect iterate_region(Conv2dRect r, int k, int n, int H, int W, int kH, int kW) {
+    int pad_top = (kH - 1) / 2, pad_bottom = kH - 1 - pad_top;
+    int pad_left = (kW - 1) / 2, pad_right = kW - 1 - pad_left;
+    int d = n - k;
+    int y0 = r.y - d * pad_top, y1 = r.y + r.h + d * pad_bottom;
+    int x0 = r.x - d * pad_left, x1 = r.x + r.w + d * pad_right;
+    if (y0 < 0) y0 = 0;
+    if (x0 < 0) x0 = 0;
+    if (y1 > H) y1 = H;
+    if (x1 > W) x1 = W;
+    Conv2dRect out = { y0, x0, y1 - y0, x1 - x0 };
+    return out;
+}
+
+static void iterate_stats_init(PerfStats *stats, IterStats *iter, int steps) {
+    conv2d_stats_begin(stats);
+    memset(iter, 0, sizeof(*iter));
+    iter->steps = steps;
+}
+
+/**
+ * Serial reference: steps conv2d_serial_stride calls with stride 1
+ */
+void conv2d_iterate_serial(float **f, int H, int W, float **g, int kH, int kW, int steps, float **output) {
+    float **tmp = allocate_2d_array(H, W);
+    if (!tmp) {
+        fprintf(stderr, "Error: Failed to allocate memory for iteration\n");
+        exit(1);
+    }
+    for (int i = 0; i < H; i++) memcpy(output[i], f[i], (size_t)W * sizeof(float));
+    for (int t = 0; t < steps; t++) {
+        conv2d_serial_stride(output, H, W, g, kH, kW, 1, 1, tmp);
+        for (int i = 0; i < H; i++) memcpy(output[i], tmp[i], (size_t)W * sizeof(float));
+    }
+    free_2d_array(tmp, H);
+}
+
+/**
+ * Temporally blocked hybrid MPI+OpenMP iteration with performance statistics
+ *
+ * Applies the stride-1 convolution with g steps times to f. f and g must be
+ * valid on every rank; output (H x W) is complete on every rank afterwards.
+ * block is the number of steps per ghost exchange (0 uses CONV2D_ITER_BLOCK)
+ * and is reduced so that the ghost region of a rank comes from its direct
+ * neighbours only; tile is the edge of the time-skewed tiles (0 uses
+ * CONV2D_ITER_TILE). iter may be NULL.
+ */
+void conv2d_iterate_stats(float **f, int H, int W, float **g, int kH, int kW, int steps, int block, int tile,
+                          float **output, MPI_Comm comm, PerfStats *stats, IterStats *iter) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    IterStats local_iter;
+    if (!iter) iter = &local_iter;
+    iterate_stats_init(stats, iter, steps);
+    Conv2dArena *arena = conv2d_thread_arena();
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+    stats->output_elements = (long long)H * W;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    if (block <= 0) block = CONV2D_ITER_BLOCK;
+    if (tile <= 0) tile = CONV2D_ITER_TILE;
+    int pad_top = (kH - 1) / 2, pad_bottom = kH - 1 - pad_top;
+    int halo = pad_top > pad_bottom ? pad_top : pad_bottom;
+
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, 1, 1, size, comm);
+    conv2d_record_partition_stats(H, W, kH, kW, 1, 1, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    // Ghost rows must come from the direct neighbours: block * halo is at
+    // most the smallest band
+    int min_rows = H;
+    for (int p = 0; p < size; p++) {
+        int rows = row_starts[p + 1] - row_starts[p];
+        if (rows < min_rows) min_rows = rows;
+    }
+    if (size > 1 && halo > 0) {
+        if (min_rows < halo) {
+            if (rank == 0) fprintf(stderr, "Error: %d ranks leave bands thinner than the %d-row halo\n", size, halo);
+            MPI_Abort(comm, 1);
+        }
+        if (block * halo > min_rows) block = min_rows / halo;
+    }
+    if (block > steps && steps > 0) block = steps;
+    iter->block = block;
+
+    // This rank's band with full-depth ghost rows, twice (ping-pong steps)
+    int band_start = local_start - block * pad_top;
+    int band_end = local_end + block * pad_bottom;
+    if (band_start < 0) band_start = 0;
+    if (band_end > H) band_end = H;
+    int band_rows = band_end - band_start;
+    iter->ghost_rows = band_rows - (local_end - local_start);
+
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    float **band[2];
+    for (int b = 0; b < 2; b++) {
+        float *data = (float*)conv2d_arena_alloc(arena, (size_t)band_rows * W * sizeof(float));
+        band[b] = (float**)conv2d_arena_alloc(arena, (size_t)band_rows * sizeof(float*));
+        if (!data || !band[b]) {
+            fprintf(stderr, "Error: Failed to allocate memory for iteration band\n");
+            MPI_Abort(comm, 1);
+        }
+        for (int i = 0; i < band_rows; i++) band[b][i] = data + (size_t)i * W;
+    }
+    double t_copy = MPI_Wtime();
+    for (int i = 0; i < band_rows; i++) {
+        memcpy(band[0][i], f[band_start + i], (size_t)W * sizeof(float));
+    }
+    stats->memory_copy_time = MPI_Wtime() - t_copy;
+
+    // Largest region of a tile at the first step of a block
+    int buf_h = tile + (block - 1) * (kH - 1);
+    int buf_w = tile + (block - 1) * (kW - 1);
+    if (buf_h > band_rows) buf_h = band_rows;
+    if (buf_w > W) buf_w = W;
+    iter->tile_buffer_bytes = 2LL * buf_h * buf_w * sizeof(float);
+
+    int up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+    int cur = 0;
+    long long macs = 0, reads = 0;
+    for (int t = 0; t < steps; t += block) {
+        int n = steps - t < block ? steps - t : block;
+
+        // Refresh the ghost rows n halos deep; the first block starts from f
+        if (t > 0 && size > 1) {
+            t_comm_start = MPI_Wtime();
+            float **b = band[cur];
+            int top = n * pad_top, bottom = n * pad_bottom;
+            int top_rows = local_start - top < 0 ? local_start : top;
+            int bottom_rows = local_end + bottom > H ? H - local_end : bottom;
+            int send_up = up != MPI_PROC_NULL ? bottom : 0;
+            int send_down = down != MPI_PROC_NULL ? top : 0;
+
+            // Own top rows to the rank above, its bottom ghosts; then own
+            // bottom rows to the rank below
+            MPI_Sendrecv(send_up > 0 ? b[local_start - band_start] : NULL, send_up * W, MPI_FLOAT, up, 0,
+                         bottom_rows > 0 ? b[local_end - band_start] : NULL, down != MPI_PROC_NULL ? bottom_rows * W : 0,
+                         MPI_FLOAT, down, 0, comm, MPI_STATUS_IGNORE);
+            MPI_Sendrecv(send_down > 0 ? b[local_end - top - band_start] : NULL, send_down * W, MPI_FLOAT, down, 1,
+                         top_rows > 0 ? b[local_start - top_rows - band_start] : NULL, up != MPI_PROC_NULL ? top_rows * W : 0,
+                         MPI_FLOAT, up, 1, comm, MPI_STATUS_IGNORE);
+            iter->exchanges += 2;
+            iter->exchange_bytes += (long long)(send_up + send_down) * W * sizeof(float);
+            stats->num_communications += 2;
+            stats->bytes_communicated += (long long)(send_up + send_down) * W * sizeof(float);
+            stats->communication_time += MPI_Wtime() - t_comm_start;
+        }
+
+        // n steps per tile of own rows, depth-first through the steps
+        int tiles_y = (local_end - local_start + tile - 1) / tile;
+        int tiles_x = (W + tile - 1) / tile;
+        float **src = band[cur], **dst = band[cur ^ 1];
+        t_comp_start = MPI_Wtime();
+        TuneParams tune;
+        conv2d_get_tune_params(&tune);
+        omp_set_schedule(tune.schedule, tune.chunk_size);
+        #pragma omp parallel reduction(+:macs, reads)
+        {
+            Conv2dArena *thread_arena = conv2d_thread_arena();
+            Conv2dArenaMark thread_mark = conv2d_arena_mark(thread_arena);
+            float **buf[2] = { NULL, NULL };
+            if (n > 1) {
+                buf[0] = conv2d_arena_alloc_2d(thread_arena, buf_h, buf_w);
+                buf[1] = conv2d_arena_alloc_2d(thread_arena, buf_h, buf_w);
+                if (!buf[0] || !buf[1]) {
+                    fprintf(stderr, "Error: Failed to allocate memory for iteration tile buffers\n");
+                    MPI_Abort(comm, 1);
+                }
+            }
+
+            #pragma omp for schedule(runtime) collapse(2)
+            for (int ty = 0; ty < tiles_y; ty++) {
+                for (int tx = 0; tx < tiles_x; tx++) {
+                    int i0 = local_start + ty * tile;
+                    int i1 = i0 + tile < local_end ? i0 + tile : local_end;
+                    int j0 = tx * tile;
+                    int j1 = j0 + tile < W ? j0 + tile : W;
+                    Conv2dRect r = { i0, j0, i1 - i0, j1 - j0 };
+                    Conv2dRect first = iterate_region(r, 0, n, H, W, kH, kW);
+                    reads += (long long)first.h * first.w;
+
+                    float **in = src;
+                    int in_y0 = band_start, in_x0 = 0;
+                    for (int k = 1; k <= n; k++) {
+                        Conv2dRect rk = iterate_region(r, k, n, H, W, kH, kW);
+                        int last = k == n;
+                        float **out = last ? dst : buf[k & 1];
+                        int out_y0 = last ? band_start : rk.y;
+                        int out_x0 = last ? 0 : rk.x;
+                        iterate_rect(in, in_y0, in_x0, H, W, g, kH, kW, rk, out, out_y0, out_x0, ep);
+                        macs += (long long)rk.h * rk.w * kH * kW;
+                        in = out;
+                        in_y0 = out_y0;
+                        in_x0 = out_x0;
+                    }
+                }
+            }
+            conv2d_arena_rewind(thread_arena, thread_mark);
+        }
+        stats->computation_time += MPI_Wtime() - t_comp_start;
+        cur ^= 1;
+        iter->blocks++;
+    }
+
+    // Own rows to the output, then gather to all processes
+    for (int i = local_start; i < local_end; i++) {
+        memcpy(output[i], band[cur][i - band_start], (size_t)W * sizeof(float));
+    }
+    conv2d_arena_rewind(arena, mark);
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                MPI_Bcast(output[i], W, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)W * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time += stats->broadcast_time;
+    }
+
+    // Modelled DRAM traffic: every block reads each tile's first region and
+    // writes the own rows once
+    iter->macs = macs;
+    iter->traffic_bytes = (reads + (long long)iter->blocks * (local_end - local_start) * W) * (long long)sizeof(float);
+
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Temporally blocked hybrid MPI+OpenMP iteration (see conv2d_iterate_stats)
+ */
+void conv2d_iterate(float **f, int H, int W, float **g, int kH, int kW, int steps, int block, int tile,
+                    float **output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_iterate_stats(f, H, W, g, kH, kW, steps, block, tile, output, comm, &stats, NULL);
+}
+
+/**
+ * One conv2d_stride_stats call per step, the baseline for the blocked
+ * engine: every step sweeps the whole array and gathers it to every rank
+ */
+void conv2d_iterate_stepwise_stats(float **f, int H, int W, float **g, int kH, int kW, int steps,
+                                   float **output, MPI_Comm comm, PerfStats *stats, IterStats *iter) {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    IterStats local_iter;
+    if (!iter) iter = &local_iter;
+    iterate_stats_init(stats, iter, steps);
+    long long scratch_allocs = 0, scratch_bytes = 0, heap_allocs = 0;
+    double t_start = MPI_Wtime();
+    stats->output_elements = (long long)H * W;
+    iter->block = 1;
+
+    float **tmp = allocate_2d_array(H, W);
+    if (!tmp) {
+        fprintf(stderr, "Error: Failed to allocate memory for iteration\n");
+        MPI_Abort(comm, 1);
+    }
+    for (int i = 0; i < H; i++) memcpy(output[i], f[i], (size_t)W * sizeof(float));
+    float **in = output, **out = tmp;
+    for (int t = 0; t < steps; t++) {
+        PerfStats step;
+        conv2d_stride_stats(in, H, W, g, kH, kW, 1, 1, out, comm, &step);
+        stats->computation_time += step.computation_time;
+        stats->communication_time += step.communication_time;
+        stats->broadcast_time += step.broadcast_time;
+        stats->bytes_communicated += step.bytes_communicated;
+        stats->num_communications += step.num_communications;
+        scratch_allocs += step.scratch_allocs;
+        scratch_bytes += step.scratch_bytes;
+        heap_allocs += step.heap_allocs;
+        iter->exchanges += step.num_communications;
+        iter->exchange_bytes += step.bytes_communicated;
+        iter->macs += (long long)H * W * kH * kW / size;
+        iter->blocks++;
+        float **swap = in;
+        in = out;
+        out = swap;
+    }
+    if (in != output) {
+        for (int i = 0; i < H; i++) memcpy(output[i], in[i], (size_t)W * sizeof(float));
+    }
+    free_2d_array(tmp, H);
+
+    // Every step reads the band and writes the full output
+    iter->traffic_bytes = (long long)steps * ((long long)H * W / size + (long long)H * W) * sizeof(float);
+    stats->scratch_allocs = scratch_allocs;
+    stats->scratch_bytes = scratch_bytes;
+    stats->heap_allocs = heap_allocs;
+    stats->total_time = MPI_Wtime() - t_start;
+}
@@ -0,0 +1,319 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Zero-tile skipping for sparse inputs
+ *
+ * Masks and detection heatmaps are mostly zeros, but the engines still run
+ * the full kernel loop for every output pixel. A cheap pre-pass marks which
+ * tile x tile blocks of the input hold a nonzero pixel and builds a 2D prefix
+ * sum over that bitmap, so "is any input pixel in this rectangle nonzero?"
+ * costs four lookups. Output tiles whose whole receptive field is empty are
+ * written as zeros; the rest go through the tap-list kernel
+ * (conv2d_sparse_block). The answer is conservative at tile granularity, so
+ * skipping never changes the result.
+ *
+ * Rows that are entirely zero are not sent either: conv2d_bcast_nonzero_rows
+ * broadcasts a row flag array and then only the occupied rows, and the
+ * engine's gather skips output rows that came out all zero.
+ */
+
+/**
+ * Build the occupancy map of input rows [row_start, row_end) (widened to
+ * whole tiles). Tile rows outside that range are marked empty. Storage comes
+ * from the arena and is released by rewinding it. Returns 0 on success.
+ */
+int conv2d_occupancy_build(float **f, int H, int W, int tile, int row_start, int row_end, Conv2dArena *arena, OccupancyMap *occ) {
+    memset(occ, 0, sizeof(*occ));
+    occ->H = H;
+    occ->W = W;
+    occ->tile = tile;
+    occ->tiles_y = (H + tile - 1) / tile;
+    occ->tiles_x = (W + tile - 1) / tile;
+
+    size_t cells = (size_t)occ->tiles_y * occ->tiles_x;
+    occ->bits = (uint8_t*)conv2d_arena_alloc(arena, cells);
+    occ->prefix = (int*)conv2d_arena_alloc(arena, (size_t)(occ->tiles_y + 1) * (occ->tiles_x + 1) * sizeof(int));
+    if (!occ->bits || !occ->prefix) return -1;
+    memset(occ->bits, 0, cells);
+
+    int ty_start = row_start / tile;
+    int ty_end = (row_end + tile - 1) / tile;
+    if (ty_end > occ->tiles_y) ty_end = occ->tiles_y;
+
+    // One tile row per iteration; a tile stops scanning at its first nonzero
+    #pragma omp parallel for schedule(dynamic)
+    for (int ty = ty_start; ty < ty_end; ty++) {
+        uint8_t *bits = occ->bits + (size_t)ty * occ->tiles_x;
+        int i1 = (ty + 1) * tile < H ? (ty + 1) * tile : H;
+        for (int i = ty * tile; i < i1; i++) {
+            const float *row = f[i];
+            for (int tx = 0; tx < occ->tiles_x; tx++) {
+                if (bits[tx]) continue;
+                int j1 = (tx + 1) * tile < W ? (tx + 1) * tile : W;
+                for (int j = tx * tile; j < j1; j++) {
+                    if (row[j] != 0.0f) {
+                        bits[tx] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // prefix[(ty + 1) * (tiles_x + 1) + tx + 1] = occupied tiles in [0, ty] x [0, tx]
+    int stride = occ->tiles_x + 1;
+    memset(occ->prefix, 0, (size_t)stride * sizeof(int));
+    for (int ty = 0; ty < occ->tiles_y; ty++) {
+        int *prev = occ->prefix + (size_t)ty * stride;
+        int *cur = prev + stride;
+        int run = 0;
+        cur[0] = 0;
+        for (int tx = 0; tx < occ->tiles_x; tx++) {
+            run += occ->bits[(size_t)ty * occ->tiles_x + tx];
+            cur[tx + 1] = prev[tx + 1] + run;
+        }
+    }
+    occ->occupied = occ->prefix[(size_t)occ->tiles_y * stride + occ->tiles_x];
+    return 0;
+}
+
+/**
+ * 1 if any input pixel in rows [y0, y1) x columns [x0, x1) may be nonzero
+ * (the rectangle is clipped to the image), 0 if all of them are zero
+ */
+int conv2d_occupancy_any(const OccupancyMap *occ, int y0, int y1, int x0, int x1) {
+    if (y0 < 0) y0 = 0;
+    if (x0 < 0) x0 = 0;
+    if (y1 > occ->H) y1 = occ->H;
+    if (x1 > occ->W) x1 = occ->W;
+    if (y0 >= y1 || x0 >= x1) return 0;
+
+    int ty0 = y0 / occ->tile, ty1 = (y1 - 1) / occ->tile + 1;
+    int tx0 = x0 / occ->tile, tx1 = (x1 - 1) / occ->tile + 1;
+    int stride = occ->tiles_x + 1;
+    const int *p = occ->prefix;
+    int count = p[(size_t)ty1 * stride + tx1] - p[(size_t)ty0 * stride + tx1]
+              - p[(size_t)ty1 * stride + tx0] + p[(size_t)ty0 * stride + tx0];
+    return count > 0;
+}
+
+/**
+ * Broadcast the rows of an H x W array from root, sending only rows with a
+ * nonzero element; the other ranks zero the remaining rows. Returns the
+ * number of bytes broadcast (flags included).
+ */
+long long conv2d_bcast_nonzero_rows(float **f, int H, int W, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    Conv2dArena *arena = conv2d_thread_arena();
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    uint8_t *flags = (uint8_t*)conv2d_arena_alloc(arena, H > 0 ? (size_t)H : 1);
+    if (!flags) {
+        fprintf(stderr, "Error: Failed to allocate memory for row flags\n");
+        MPI_Abort(comm, 1);
+    }
+
+    if (rank == root) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < H; i++) {
+            flags[i] = 0;
+            for (int j = 0; j < W; j++) {
+                if (f[i][j] != 0.0f) {
+                    flags[i] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    MPI_Bcast(flags, H, MPI_UINT8_T, root, comm);
+
+    long long bytes = H;
+    for (int i = 0; i < H; i++) {
+        if (flags[i]) {
+            MPI_Bcast(f[i], W, MPI_FLOAT, root, comm);
+            bytes += (long long)W * sizeof(float);
+        } else if (rank != root) {
+            memset(f[i], 0, (size_t)W * sizeof(float));
+        }
+    }
+
+    conv2d_arena_rewind(arena, mark);
+    return bytes;
+}
+
+static void fill_row(float *row, int n, float value) {
+    if (value == 0.0f) {
+        memset(row, 0, (size_t)n * sizeof(float));
+        return;
+    }
+    for (int j = 0; j < n; j++) row[j] = value;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution that skips output tiles with an all-zero
+ * receptive field, with performance statistics
+ *
+ * Output rows are split by modelled cost as in conv2d_stride_stats. Each rank
+ * builds the occupancy map of its own input band only, then convolves its
+ * rows in tile x tile output tiles (OpenMP over tiles), and the gather
+ * exchanges one flag per output row and broadcasts only the rows that are
+ * not all zero. tile = 0 computes every tile and gathers every row with the
+ * same kernel, which is the baseline for the speedup. skip may be NULL.
+ */
+void conv2d_stride_skip_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int tile, float **output, MPI_Comm comm, PerfStats *stats, SkipStats *skip) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+    Conv2dArena *arena = conv2d_thread_arena();
+    SkipStats local_skip;
+    if (!skip) skip = &local_skip;
+    memset(skip, 0, sizeof(*skip));
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Value of an output whose receptive field is all zero (0 unless an
+    // epilogue adds a bias or clamps)
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    float fill = ep ? conv2d_epilogue_value(ep, 0.0f) : 0.0f;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    int *counts = (int*)malloc(size * sizeof(int));
+    if (!counts) {
+        fprintf(stderr, "Error: Failed to allocate memory for row partition\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    Conv2dArenaMark mark = conv2d_arena_mark(arena);
+    uint8_t *row_flags = (uint8_t*)conv2d_arena_alloc(arena, out_H > 0 ? (size_t)out_H : 1);
+    SparseKernel sk;
+    if (!row_flags || conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for zero skipping\n");
+        MPI_Abort(comm, 1);
+    }
+
+    t_comp_start = MPI_Wtime();
+    if (local_end > local_start) {
+        // Occupancy of this rank's input band
+        int input_start = local_start * sH - pad_top;
+        int input_end = (local_end - 1) * sH + kH - pad_top;
+        if (input_start < 0) input_start = 0;
+        if (input_end > H) input_end = H;
+
+        OccupancyMap occ;
+        int out_tile = tile > 0 ? tile : CONV2D_SKIP_TILE;
+        if (tile > 0) {
+            double t_build = MPI_Wtime();
+            if (conv2d_occupancy_build(f, H, W, tile, input_start, input_end, arena, &occ) != 0) {
+                fprintf(stderr, "Error: Failed to allocate memory for occupancy map\n");
+                MPI_Abort(comm, 1);
+            }
+            skip->build_time = MPI_Wtime() - t_build;
+        }
+
+        int tiles_y = (local_end - local_start + out_tile - 1) / out_tile;
+        int tiles_x = (out_W + out_tile - 1) / out_tile;
+        long long skipped = 0;
+
+        TuneParams tune;
+        conv2d_get_tune_params(&tune);
+        omp_set_schedule(tune.schedule, tune.chunk_size);
+        #pragma omp parallel for schedule(runtime) collapse(2) reduction(+:skipped)
+        for (int ty = 0; ty < tiles_y; ty++) {
+            for (int tx = 0; tx < tiles_x; tx++) {
+                int i0 = local_start + ty * out_tile;
+                int i1 = i0 + out_tile < local_end ? i0 + out_tile : local_end;
+                int j0 = tx * out_tile;
+                int j1 = j0 + out_tile < out_W ? j0 + out_tile : out_W;
+
+                // Receptive field of the output tile
+                if (tile > 0 && !conv2d_occupancy_any(&occ, i0 * sH - pad_top, (i1 - 1) * sH + kH - pad_top,
+                                                      j0 * sW - pad_left, (j1 - 1) * sW + kW - pad_left)) {
+                    for (int i = i0; i < i1; i++) {
+                        fill_row(output[i] + j0, j1 - j0, fill);
+                    }
+                    skipped++;
+                    continue;
+                }
+                conv2d_sparse_block(f, 0, H, W, &sk, sH, sW, output, i0, i1, j0, j1);
+            }
+        }
+        skip->tiles_total = (long long)tiles_y * tiles_x;
+        skip->tiles_skipped = skipped;
+
+        // Flag output rows that came out entirely the fill value
+        #pragma omp parallel for schedule(static)
+        for (int i = local_start; i < local_end; i++) {
+            row_flags[i] = tile <= 0;
+            if (tile <= 0) continue;
+            for (int j = 0; j < out_W; j++) {
+                if (output[i][j] != fill) {
+                    row_flags[i] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather results to all processes, skipping rows of the fill value
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            counts[p] = row_starts[p + 1] - row_starts[p];
+        }
+        if (tile > 0) {
+            MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_UINT8_T, row_flags, counts, row_starts, MPI_UINT8_T, comm);
+            stats->num_communications++;
+            stats->bytes_communicated += out_H;
+        } else {
+            memset(row_flags, 1, (size_t)out_H);
+        }
+
+        for (int p = 0; p < size; p++) {
+            for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                if (row_flags[i]) {
+                    MPI_Bcast(output[i], out_W, MPI_FLOAT, p, comm);
+                    stats->num_communications++;
+                    stats->bytes_communicated += (long long)out_W * sizeof(float);
+                } else {
+                    if (p != rank) fill_row(output[i], out_W, fill);
+                    skip->rows_skipped++;
+                }
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    conv2d_sparse_free(&sk);
+    conv2d_arena_rewind(arena, mark);
+    free(counts);
+    free(row_starts);
+    conv2d_arena_stats_end(arena, stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution with zero-tile skipping (see
+ * conv2d_stride_skip_stats)
+ */
+void conv2d_stride_skip(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, int tile, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_skip_stats(f, H, W, g, kH, kW, sH, sW, tile, output, comm, &stats, NULL);
+}
@@ -0,0 +1,357 @@
+#include "conv2d.h"
+#include <math.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Plan/execute API
+ *
+ * conv2d_stride recomputes the row partition, allocates the local input copy
+ * and re-derives everything on every call. A plan does that work once per
+ * problem shape:
+ *   - chooses the engine (direct or separable) and the rank/thread split
+ *   - allocates the persistent output staging and scratch buffers
+ *   - factorizes the kernel (rank-1 / separable kernels) once and reuses the
+ *     factors for as long as the kernel passed to conv2d_execute is unchanged
+ *   - sets up persistent MPI point-to-point requests for the output exchange
+ * conv2d_execute then only runs the arithmetic and starts the requests.
+ */
+
+// Relative tolerance for accepting a kernel as separable (rank 1)
+#define PLAN_SEPARABLE_TOL 1e-6f
+
+struct Conv2dPlan {
+    MPI_Comm comm;
+    int rank, size;
+    int H, W, kH, kW, sH, sW;
+    int out_H, out_W;
+    unsigned flags;
+
+    // Output rows owned by each rank
+    int *row_starts;
+    int local_start, local_end;
+
+    // Contiguous staging for the full output (row pointers into it)
+    float *staging;
+    float **staging_rows;
+
+    // Row-pass scratch for the separable engine: input rows x out_W
+    float *row_pass;
+    int row_pass_rows;
+
+    // Cached kernel and its factorization
+    float *kernel_copy;
+    int kernel_valid;
+    int separable;
+    float *col_factor;  // kH entries
+    float *row_factor;  // kW entries
+
+    // Persistent output exchange
+    MPI_Request *requests;
+    int num_requests;
+
+    int executions;
+};
+
+/**
+ * Try to write g as col_factor (kH) x row_factor (kW). Returns 1 if the
+ * kernel is rank 1 within PLAN_SEPARABLE_TOL of its largest entry.
+ */
+static int factorize_separable(float **g, int kH, int kW, float *col_factor, float *row_factor) {
+    int pi = 0, pj = 0;
+    float max_abs = 0.0f;
+    for (int i = 0; i < kH; i++) {
+        for (int j = 0; j < kW; j++) {
+            if (fabsf(g[i][j]) > max_abs) {
+                max_abs = fabsf(g[i][j]);
+                pi = i;
+                pj = j;
+            }
+        }
+    }
+    if (max_abs == 0.0f) return 0;
+
+    // g[i][j] = g[i][pj] * g[pi][j] / g[pi][pj] for a rank-1 kernel
+    for (int i = 0; i < kH; i++) col_factor[i] = g[i][pj];
+    for (int j = 0; j < kW; j++) row_factor[j] = g[pi][j] / g[pi][pj];
+
+    for (int i = 0; i < kH; i++) {
+        for (int j = 0; j < kW; j++) {
+            if (fabsf(g[i][j] - col_factor[i] * row_factor[j]) > PLAN_SEPARABLE_TOL * max_abs) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Create a plan for H x W inputs, kH x kW kernels and sH x sW stride on comm.
+ * Collective over comm. Returns NULL on failure.
+ */
+Conv2dPlan* conv2d_plan_create(int H, int W, int kH, int kW, int sH, int sW, MPI_Comm comm, unsigned flags) {
+    if (H <= 0 || W <= 0 || kH <= 0 || kW <= 0 || sH <= 0 || sW <= 0) return NULL;
+
+    Conv2dPlan *plan = (Conv2dPlan*)calloc(1, sizeof(Conv2dPlan));
+    if (!plan) return NULL;
+
+    MPI_Comm_dup(comm, &plan->comm);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+    MPI_Comm_size(plan->comm, &plan->size);
+
+    plan->H = H; plan->W = W;
+    plan->kH = kH; plan->kW = kW;
+    plan->sH = sH; plan->sW = sW;
+    plan->out_H = (H + sH - 1) / sH;
+    plan->out_W = (W + sW - 1) / sW;
+    plan->flags = flags;
+
+    // Decomposition: cost-weighted row bands (with any installed rank weights)
+    plan->row_starts = (int*)malloc((plan->size + 1) * sizeof(int));
+    if (!plan->row_starts) {
+        fprintf(stderr, "Error: Failed to allocate memory for convolution plan\n");
+        conv2d_plan_destroy(plan);
+        return NULL;
+    }
+    conv2d_partition_rows(H, W, kH, kW, sH, sW, plan->size,
+                          conv2d_get_rank_weights(plan->size), plan->row_starts);
+    plan->local_start = plan->row_starts[plan->rank];
+    plan->local_end = plan->row_starts[plan->rank + 1];
+
+    // Persistent buffers
+    int pad_top = (kH - 1) / 2;
+    size_t staging_rows = plan->size > 1 ? (size_t)plan->out_H : 0;
+    plan->staging = (float*)malloc((staging_rows > 0 ? staging_rows : 1) * plan->out_W * sizeof(float));
+    plan->staging_rows = (float**)malloc((plan->out_H > 0 ? plan->out_H : 1) * sizeof(float*));
+
+    if (plan->local_end > plan->local_start) {
+        int first = plan->local_start * sH - pad_top;
+        int last = (plan->local_end - 1) * sH + kH - pad_top;
+        if (first < 0) first = 0;
+        if (last > H) last = H;
+        plan->row_pass_rows = last - first;
+    }
+    if (!(flags & CONV2D_PLAN_NO_SEPARABLE)) {
+        plan->row_pass = (float*)malloc(((size_t)plan->row_pass_rows + 1) * plan->out_W * sizeof(float));
+    }
+    plan->kernel_copy = (float*)malloc((size_t)kH * kW * sizeof(float));
+    plan->col_factor = (float*)malloc(kH * sizeof(float));
+    plan->row_factor = (float*)malloc(kW * sizeof(float));
+
+    if (!plan->staging || !plan->staging_rows || !plan->kernel_copy ||
+        !plan->col_factor || !plan->row_factor ||
+        (!(flags & CONV2D_PLAN_NO_SEPARABLE) && !plan->row_pass)) {
+        fprintf(stderr, "Error: Failed to allocate memory for convolution plan\n");
+        conv2d_plan_destroy(plan);
+        return NULL;
+    }
+    for (size_t i = 0; i < staging_rows; i++) {
+        plan->staging_rows[i] = plan->staging + i * plan->out_W;
+    }
+
+    // Persistent exchange: send my band to every rank, receive theirs
+    if (plan->size > 1 && !(flags & CONV2D_PLAN_NO_GATHER)) {
+        plan->requests = (MPI_Request*)malloc(2 * plan->size * sizeof(MPI_Request));
+        int local_count = (plan->local_end - plan->local_start) * plan->out_W;
+        for (int p = 0; p < plan->size; p++) {
+            if (p == plan->rank) continue;
+            int p_count = (plan->row_starts[p + 1] - plan->row_starts[p]) * plan->out_W;
+            if (local_count > 0) {
+                MPI_Send_init(plan->staging + (size_t)plan->local_start * plan->out_W, local_count,
+                              MPI_FLOAT, p, 0, plan->comm, &plan->requests[plan->num_requests++]);
+            }
+            if (p_count > 0) {
+                MPI_Recv_init(plan->staging + (size_t)plan->row_starts[p] * plan->out_W, p_count,
+                              MPI_FLOAT, p, 0, plan->comm, &plan->requests[plan->num_requests++]);
+            }
+        }
+    }
+
+    return plan;
+}
+
+/**
+ * Release a plan and its persistent requests. Collective over the plan's comm.
+ */
+void conv2d_plan_destroy(Conv2dPlan *plan) {
+    if (!plan) return;
+    for (int r = 0; r < plan->num_requests; r++) {
+        MPI_Request_free(&plan->requests[r]);
+    }
+    free(plan->requests);
+    free(plan->row_starts);
+    free(plan->staging);
+    free(plan->staging_rows);
+    free(plan->row_pass);
+    free(plan->kernel_copy);
+    free(plan->col_factor);
+    free(plan->row_factor);
+    MPI_Comm_free(&plan->comm);
+    free(plan);
+}
+
+/**
+ * Refresh the cached kernel factorization if g differs from the last kernel
+ */
+static void plan_update_kernel(Conv2dPlan *plan, float **g) {
+    int kH = plan->kH, kW = plan->kW;
+    int same = plan->kernel_valid;
+    for (int i = 0; i < kH && same; i++) {
+        if (memcmp(plan->kernel_copy + (size_t)i * kW, g[i], kW * sizeof(float)) != 0) same = 0;
+    }
+    if (same) return;
+
+    for (int i = 0; i < kH; i++) {
+        memcpy(plan->kernel_copy + (size_t)i * kW, g[i], kW * sizeof(float));
+    }
+    plan->kernel_valid = 1;
+
+    // Separable only pays off when kH + kW < kH * kW
+    plan->separable = 0;
+    if (!(plan->flags & CONV2D_PLAN_NO_SEPARABLE) && kH > 1 && kW > 1) {
+        plan->separable = factorize_separable(g, kH, kW, plan->col_factor, plan->row_factor);
+    }
+}
+
+/**
+ * Direct engine: output rows [row_start, row_end) into out (full-size row pointers)
+ */
+static void plan_direct_rows(const Conv2dPlan *plan, float **f, float **g, float **out) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int H = plan->H, W = plan->W, kH = plan->kH, kW = plan->kW, sH = plan->sH, sW = plan->sW;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_W = plan->out_W;
+
+    #pragma omp parallel for schedule(runtime) collapse(2)
+    for (int out_i = plan->local_start; out_i < plan->local_end; out_i++) {
+        for (int out_j = 0; out_j < out_W; out_j++) {
+            float sum = 0.0f;
+            int i = out_i * sH;
+            int j = out_j * sW;
+
+            for (int ki = 0; ki < kH; ki++) {
+                for (int kj = 0; kj < kW; kj++) {
+                    int input_i = i + ki - pad_top;
+                    int input_j = j + kj - pad_left;
+
+                    if (input_i >= 0 && input_i < H && input_j >= 0 && input_j < W) {
+                        sum += f[input_i][input_j] * g[ki][kj];
+                    }
+                }
+            }
+            out[out_i][out_j] = ep ? conv2d_epilogue_value(ep, sum) : sum;
+        }
+    }
+}
+
+/**
+ * Separable engine: a horizontal pass with row_factor over the band's input
+ * rows (only the strided output columns), then a vertical pass with
+ * col_factor. Zero padding is exact because out-of-range taps are skipped
+ * in both passes.
+ */
+static void plan_separable_rows(const Conv2dPlan *plan, float **f, float **out) {
+    int H = plan->H, W = plan->W, kH = plan->kH, kW = plan->kW, sH = plan->sH, sW = plan->sW;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_W = plan->out_W;
+
+    int first = plan->local_start * sH - pad_top;
+    if (first < 0) first = 0;
+    int rows = plan->row_pass_rows;
+    const float *row_factor = plan->row_factor;
+    const float *col_factor = plan->col_factor;
+    float *row_pass = plan->row_pass;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for (int r = 0; r < rows; r++) {
+            const float *src = f[first + r];
+            float *dst = row_pass + (size_t)r * out_W;
+            for (int out_j = 0; out_j < out_W; out_j++) {
+                int j = out_j * sW - pad_left;
+                int lo = j < 0 ? -j : 0;
+                int hi = (j + kW > W) ? W - j : kW;
+                float sum = 0.0f;
+                for (int kj = lo; kj < hi; kj++) {
+                    sum += src[j + kj] * row_factor[kj];
+                }
+                dst[out_j] = sum;
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (int out_i = plan->local_start; out_i < plan->local_end; out_i++) {
+            int i = out_i * sH - pad_top;
+            int lo = i < 0 ? -i : 0;
+            int hi = (i + kH > H) ? H - i : kH;
+            float *dst = out[out_i];
+
+            for (int out_j = 0; out_j < out_W; out_j++) dst[out_j] = 0.0f;
+            for (int ki = lo; ki < hi; ki++) {
+                const float *src = row_pass + (size_t)(i + ki - first) * out_W;
+                float c = col_factor[ki];
+                #pragma omp simd
+                for (int out_j = 0; out_j < out_W; out_j++) {
+                    dst[out_j] += c * src[out_j];
+                }
+            }
+            if (ep) conv2d_epilogue_row(ep, dst, out_W);
+        }
+    }
+}
+
+/**
+ * Run a planned convolution: output = f (*) g with the plan's shape.
+ * f and g must be valid on every rank (as for conv2d_stride). Unless the plan
+ * was created with CONV2D_PLAN_NO_GATHER, the full output is available on
+ * every rank afterwards; otherwise each rank only fills its own rows.
+ */
+void conv2d_execute(Conv2dPlan *plan, float **f, float **g, float **output) {
+    plan_update_kernel(plan, g);
+    plan->executions++;
+
+    // Compute straight into output when nothing has to be exchanged
+    int stage = plan->size > 1 && !(plan->flags & CONV2D_PLAN_NO_GATHER);
+    float **target = stage ? plan->staging_rows : output;
+
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    if (plan->local_end > plan->local_start) {
+        if (plan->separable) {
+            plan_separable_rows(plan, f, target);
+        } else {
+            plan_direct_rows(plan, f, g, target);
+        }
+    }
+
+    if (stage) {
+        if (plan->num_requests > 0) {
+            MPI_Startall(plan->num_requests, plan->requests);
+            MPI_Waitall(plan->num_requests, plan->requests, MPI_STATUSES_IGNORE);
+        }
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < plan->out_H; i++) {
+            memcpy(output[i], plan->staging_rows[i], plan->out_W * sizeof(float));
+        }
+    }
+}
+
+/**
+ * Print the plan's choices (engine, split, buffers)
+ */
+void conv2d_plan_print(const Conv2dPlan *plan) {
+    printf("Plan: %dx%d input, %dx%d kernel, stride %dx%d -> %dx%d output\n",
+           plan->H, plan->W, plan->kH, plan->kW, plan->sH, plan->sW, plan->out_H, plan->out_W);
+    printf("  Engine:            %s\n",
+           !plan->kernel_valid ? "chosen on first execute" :
+           plan->separable ? "separable (row pass + column pass)" : "direct");
+    printf("  Split:             %d MPI processes x %d OpenMP threads, rows %d-%d on rank %d\n",
+           plan->size, omp_get_max_threads(), plan->local_start, plan->local_end, plan->rank);
+    printf("  Exchange:          %d persistent requests per rank\n", plan->num_requests);
+    printf("  Executions:        %d\n", plan->executions);
+}
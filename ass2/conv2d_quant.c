@@ -0,0 +1,320 @@
+#include "conv2d.h"
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUANT_HAVE_X86 1
+#endif
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Quantized convolution: 8-bit input, int8/int16 weights, int32 accumulation
+ *
+ * 8-bit imagery used to be widened to float before convolving, which costs
+ * 4x the memory and broadcast traffic. Here the input stays uint8 (or int8)
+ * with a per-tensor scale, the kernel is quantized once to int8 or int16 with
+ * its own scale, and every output is an exact int32 dot product. The result
+ * is written as float (acc * input_scale * weight_scale) or requantized to
+ * uint8/int8 with an output scale.
+ *
+ * Each needed input row is widened once into a zero-padded int16 row, so the
+ * "same" padding needs no bounds checks. With AVX2 and unit horizontal
+ * stride, two neighbouring taps are interleaved and multiplied with
+ * _mm256_madd_epi16 (int16 x int16 pairs summed into int32 lanes, no
+ * saturation, unlike pmaddubsw) for 8 output columns at a time. Other
+ * strides and CPUs without AVX2 use the scalar int32 loop.
+ */
+
+// Extra zero columns after each padded row so vector loads never run off it
+#define QUANT_ROW_SLACK 16
+
+/**
+ * Quantize a float kernel to bits (8 or 16) signed integers with one scale.
+ * The integer range is also capped so that 255 * sum|q| fits in int32.
+ * Returns 0 on success.
+ */
+int conv2d_quantize_kernel(float **g, int kH, int kW, int bits, QuantKernel *qk) {
+    memset(qk, 0, sizeof(*qk));
+    if (bits != 8 && bits != 16) return -1;
+
+    qk->q = (int16_t*)calloc((size_t)kH * kW, sizeof(int16_t));
+    if (!qk->q) {
+        fprintf(stderr, "Error: Failed to allocate memory for quantized kernel\n");
+        return -1;
+    }
+    qk->kH = kH;
+    qk->kW = kW;
+    qk->bits = bits;
+
+    float max_abs = 0.0f;
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            if (fabsf(g[ki][kj]) > max_abs) max_abs = fabsf(g[ki][kj]);
+        }
+    }
+
+    long long qmax = bits == 8 ? 127 : 32767;
+    long long acc_limit = 2147483647LL / (255LL * kH * kW);
+    if (qmax > acc_limit) qmax = acc_limit > 0 ? acc_limit : 1;
+
+    qk->scale = max_abs > 0.0f ? max_abs / (float)qmax : 1.0f;
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            long q = lrintf(g[ki][kj] / qk->scale);
+            if (q > qmax) q = qmax;
+            if (q < -qmax) q = -qmax;
+            qk->q[ki * kW + kj] = (int16_t)q;
+        }
+    }
+    return 0;
+}
+
+void conv2d_free_quant_kernel(QuantKernel *qk) {
+    free(qk->q);
+    qk->q = NULL;
+}
+
+/**
+ * Quantize floats to 8 bits: q = round(x / scale), saturated to the type range
+ */
+void conv2d_quantize_input(const float *src, uint8_t *dst, size_t n, float scale, int input_signed) {
+    float inv = 1.0f / scale;
+    for (size_t j = 0; j < n; j++) {
+        long q = lrintf(src[j] * inv);
+        if (input_signed) {
+            if (q > 127) q = 127;
+            if (q < -128) q = -128;
+            dst[j] = (uint8_t)(int8_t)q;
+        } else {
+            if (q > 255) q = 255;
+            if (q < 0) q = 0;
+            dst[j] = (uint8_t)q;
+        }
+    }
+}
+
+/**
+ * 1 if the unit-stride path uses AVX2 on this CPU
+ */
+int conv2d_quant_has_avx2(void) {
+#ifdef QUANT_HAVE_X86
+    static int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2");
+    }
+    return has_avx2;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * acc[j] += sum_kj w[kj] * pad[j * sW + kj] for j in [0, n)
+ */
+static void quant_row_scalar(const int16_t *pad, const int16_t *w, int kW, int sW, int32_t *acc, int n) {
+    for (int j = 0; j < n; j++) {
+        const int16_t *x = pad + (size_t)j * sW;
+        int32_t sum = 0;
+        for (int kj = 0; kj < kW; kj++) {
+            sum += (int32_t)w[kj] * x[kj];
+        }
+        acc[j] += sum;
+    }
+}
+
+#ifdef QUANT_HAVE_X86
+/**
+ * Unit-stride row: taps (kj, kj + 1) are interleaved so one madd_epi16 gives
+ * w[kj] * x[j + kj] + w[kj + 1] * x[j + kj + 1] in each int32 lane.
+ * pair_w holds (w[kj], w[kj + 1]) packed per tap pair (0 for an odd last tap).
+ */
+__attribute__((target("avx2")))
+static void quant_row_avx2(const int16_t *pad, const int32_t *pair_w, const int16_t *w, int kW, int32_t *acc, int n) {
+    int pairs = (kW + 1) / 2;
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(acc + j));
+        for (int p = 0; p < pairs; p++) {
+            const int16_t *x = pad + j + 2 * p;
+            __m128i x0 = _mm_loadu_si128((const __m128i*)x);
+            __m128i x1 = _mm_loadu_si128((const __m128i*)(x + 1));
+            __m256i xx = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(x0, x1)),
+                                                 _mm_unpackhi_epi16(x0, x1), 1);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(xx, _mm256_set1_epi32(pair_w[p])));
+        }
+        _mm256_storeu_si256((__m256i*)(acc + j), sum);
+    }
+    if (j < n) quant_row_scalar(pad + j, w, kW, 1, acc + j, n - j);
+}
+#endif
+
+/**
+ * Write one int32 accumulator row in the requested output type, applying the
+ * pointwise epilogue (if any) in the real-valued domain before requantization
+ */
+static void quant_store_row(const int32_t *acc, int n, int out_type, float acc_scale, float out_scale, const Conv2dEpilogue *ep, void *dst) {
+    if (out_type == CONV2D_QOUT_FLOAT) {
+        float *out = (float*)dst;
+        for (int j = 0; j < n; j++) out[j] = (float)acc[j] * acc_scale;
+        if (ep) conv2d_epilogue_row(ep, out, n);
+        return;
+    }
+    float requant = acc_scale / out_scale;
+    int lo = out_type == CONV2D_QOUT_U8 ? 0 : -128;
+    int hi = out_type == CONV2D_QOUT_U8 ? 255 : 127;
+    uint8_t *out = (uint8_t*)dst;
+    for (int j = 0; j < n; j++) {
+        float v = ep ? conv2d_epilogue_value(ep, (float)acc[j] * acc_scale) / out_scale
+                     : (float)acc[j] * requant;
+        long q = lrintf(v);
+        if (q < lo) q = lo;
+        if (q > hi) q = hi;
+        out[j] = (uint8_t)(int8_t)q;
+    }
+}
+
+static size_t quant_out_size(int out_type) {
+    return out_type == CONV2D_QOUT_FLOAT ? sizeof(float) : sizeof(uint8_t);
+}
+
+/**
+ * Hybrid MPI+OpenMP quantized convolution with performance statistics
+ *
+ * f:           H x W contiguous 8-bit input (int8 if input_signed), valid on
+ *              every rank; float value = input_scale * q
+ * qk:          kernel from conv2d_quantize_kernel
+ * out_type:    CONV2D_QOUT_FLOAT, or CONV2D_QOUT_U8 / _I8 requantized with
+ *              out_scale (float value = out_scale * q)
+ * output:      out_H x out_W contiguous, complete on every rank
+ *
+ * Pass MPI_COMM_SELF for the OpenMP-only engine.
+ */
+void conv2d_quant_stride_stats(const uint8_t *f, int H, int W, int input_signed, float input_scale, const QuantKernel *qk, int sH, int sW, int out_type, float out_scale, void *output, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int kH = qk->kH, kW = qk->kW;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    size_t elem = quant_out_size(out_type);
+    float acc_scale = input_scale * qk->scale;
+
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    int32_t *pair_w = (int32_t*)malloc((size_t)kH * ((kW + 1) / 2) * sizeof(int32_t));
+    if (!pair_w) {
+        fprintf(stderr, "Error: Failed to allocate memory for quantized convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    // Weight pairs for madd_epi16: low half w[kj], high half w[kj + 1]
+    for (int ki = 0; ki < kH; ki++) {
+        for (int p = 0; p < (kW + 1) / 2; p++) {
+            int16_t w0 = qk->q[ki * kW + 2 * p];
+            int16_t w1 = 2 * p + 1 < kW ? qk->q[ki * kW + 2 * p + 1] : 0;
+            pair_w[ki * ((kW + 1) / 2) + p] = (int32_t)(((uint32_t)(uint16_t)w1 << 16) | (uint16_t)w0);
+        }
+    }
+#ifdef QUANT_HAVE_X86
+    int use_simd = sW == 1 && conv2d_quant_has_avx2();
+#endif
+    int pad_len = W + kW + QUANT_ROW_SLACK;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel
+    {
+        // Zero-padded int16 input row and int32 accumulator row per thread
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        int16_t *pad = (int16_t*)conv2d_arena_alloc(arena, (size_t)pad_len * sizeof(int16_t));
+        int32_t *acc = (int32_t*)conv2d_arena_alloc(arena, (size_t)out_W * sizeof(int32_t));
+        if (!pad || !acc) {
+            fprintf(stderr, "Error: Failed to allocate memory for quantized rows\n");
+            MPI_Abort(comm, 1);
+        }
+        memset(pad, 0, (size_t)pad_len * sizeof(int16_t));
+
+        #pragma omp for schedule(runtime)
+        for (int out_i = local_start; out_i < local_end; out_i++) {
+            memset(acc, 0, (size_t)out_W * sizeof(int32_t));
+
+            for (int ki = 0; ki < kH; ki++) {
+                int input_i = out_i * sH + ki - pad_top;
+                if (input_i < 0 || input_i >= H) continue;
+
+                // Widen the row into the padded buffer (the pad stays zero)
+                const uint8_t *row = f + (size_t)input_i * W;
+                int16_t *dst = pad + pad_left;
+                if (input_signed) {
+                    for (int j = 0; j < W; j++) dst[j] = (int8_t)row[j];
+                } else {
+                    for (int j = 0; j < W; j++) dst[j] = row[j];
+                }
+
+                const int16_t *w = qk->q + ki * kW;
+#ifdef QUANT_HAVE_X86
+                if (use_simd) {
+                    quant_row_avx2(pad, pair_w + ki * ((kW + 1) / 2), w, kW, acc, out_W);
+                    continue;
+                }
+#endif
+                quant_row_scalar(pad, w, kW, sW, acc, out_W);
+            }
+            quant_store_row(acc, out_W, out_type, acc_scale, out_scale, ep,
+                            (char*)output + (size_t)out_i * out_W * elem);
+        }
+        conv2d_arena_rewind(arena, mark);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather results to all processes in the output type
+    if (size > 1) {
+        MPI_Datatype type = out_type == CONV2D_QOUT_FLOAT ? MPI_FLOAT :
+                            out_type == CONV2D_QOUT_U8 ? MPI_UINT8_T : MPI_INT8_T;
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            int p_start = row_starts[p];
+            int p_rows = row_starts[p + 1] - p_start;
+
+            for (int i = 0; i < p_rows; i++) {
+                MPI_Bcast((char*)output + (size_t)(p_start + i) * out_W * elem, out_W, type, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)out_W * elem;
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    free(pair_w);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP quantized convolution (see conv2d_quant_stride_stats)
+ */
+void conv2d_quant_stride(const uint8_t *f, int H, int W, int input_signed, float input_scale, const QuantKernel *qk, int sH, int sW, int out_type, float out_scale, void *output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_quant_stride_stats(f, H, W, input_signed, input_scale, qk, sH, sW, out_type, out_scale, output, comm, &stats);
+}
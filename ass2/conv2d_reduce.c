@@ -0,0 +1,348 @@
+#include "conv2d.h"
+#include <math.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Fused output reductions: min, max, sum, squared deviations and histogram
+ *
+ * Summary statistics of an output normally take a second pass over it, and
+ * with MPI the output has to be gathered first. The fused engine
+ * accumulates them while each output row is still in cache: every thread
+ * keeps its own min, max, sum, squared deviations and histogram counts,
+ * which are combined by OpenMP reduction clauses (the moments pairwise, in
+ * a critical section) and then across ranks on the root. When no output
+ * array is passed the rows only live in a per-thread scratch row, so
+ * nothing is stored or gathered at all.
+ *
+ * The variance comes from squared deviations about each part's own mean,
+ * merged with the pairwise update of Chan et al., rather than from
+ * sum(x^2) / n - mean^2, which cancels catastrophically when the mean is
+ * large compared to the spread.
+ */
+
+/**
+ * Empty reduction with bins histogram bins over [lo, hi]
+ */
+void conv2d_reduce_init(Conv2dReduce *red, float lo, float hi, int bins) {
+    memset(red, 0, sizeof(*red));
+    red->min = FLT_MAX;
+    red->max = -FLT_MAX;
+    if (bins < 1) bins = 1;
+    if (bins > CONV2D_HIST_MAX_BINS) bins = CONV2D_HIST_MAX_BINS;
+    if (!(hi > lo)) hi = lo + 1.0f;
+    red->hist_lo = lo;
+    red->hist_hi = hi;
+    red->bins = bins;
+}
+
+/**
+ * Histogram range that holds every output: [-B, B] with
+ * B = max|f| * sum|g|, mapped through the epilogue if one is set
+ */
+void conv2d_reduce_range(float **f, int H, int W, float **g, int kH, int kW, float *lo, float *hi) {
+    float max_f = 0.0f;
+    #pragma omp parallel for schedule(static) reduction(max:max_f)
+    for (int i = 0; i < H; i++) {
+        for (int j = 0; j < W; j++) {
+            float a = fabsf(f[i][j]);
+            if (a > max_f) max_f = a;
+        }
+    }
+    double sum_g = 0.0;
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) sum_g += fabsf(g[ki][kj]);
+    }
+    float bound = (float)(max_f * sum_g);
+
+    // The epilogue is monotone, so the range maps to its end points
+    float a = -bound, b = bound;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    if (ep) {
+        a = conv2d_epilogue_value(ep, a);
+        b = conv2d_epilogue_value(ep, b);
+    }
+    *lo = a < b ? a : b;
+    *hi = a < b ? b : a;
+}
+
+/**
+ * Merge the moments of a second set of values (n_b values, sum sum_b,
+ * squared deviations m2_b about their mean) into the first
+ */
+static void merge_moments(long long *n, double *sum, double *m2, long long n_b, double sum_b, double m2_b) {
+    if (n_b == 0) return;
+    if (*n == 0) {
+        *n = n_b;
+        *sum = sum_b;
+        *m2 = m2_b;
+        return;
+    }
+    double delta = sum_b / n_b - *sum / *n;
+    *m2 += m2_b + delta * delta * ((double)*n * n_b / (double)(*n + n_b));
+    *n += n_b;
+    *sum += sum_b;
+}
+
+/**
+ * Accumulate n values into one thread's partial results; the row is
+ * summed, then its squared deviations are taken about its own mean
+ */
+static void reduce_values(const float *v, int n, float lo, float hi, float scale, int bins,
+                          float *mn, float *mx, long long *count, double *sum, double *m2,
+                          long long *below, long long *above, long long *hist) {
+    float row_min = *mn, row_max = *mx;
+    double row_sum = 0.0, row_m2 = 0.0;
+    #pragma omp simd reduction(min:row_min) reduction(max:row_max) reduction(+:row_sum)
+    for (int j = 0; j < n; j++) {
+        float x = v[j];
+        row_min = x < row_min ? x : row_min;
+        row_max = x > row_max ? x : row_max;
+        row_sum += x;
+    }
+    double row_mean = n > 0 ? row_sum / n : 0.0;
+    #pragma omp simd reduction(+:row_m2)
+    for (int j = 0; j < n; j++) {
+        double d = v[j] - row_mean;
+        row_m2 += d * d;
+    }
+    *mn = row_min;
+    *mx = row_max;
+    merge_moments(count, sum, m2, n, row_sum, row_m2);
+
+    for (int j = 0; j < n; j++) {
+        float x = v[j];
+        if (x < lo) {
+            (*below)++;
+        } else if (x > hi) {
+            (*above)++;
+        } else {
+            int b = (int)((x - lo) * scale);
+            hist[b < bins ? b : bins - 1]++;
+        }
+    }
+}
+
+/**
+ * Separate-pass reduction of a rows x cols array into red (OpenMP)
+ */
+void conv2d_reduce_rows(Conv2dReduce *red, float **a, int rows, int cols) {
+    float lo = red->hist_lo, hi = red->hist_hi;
+    float scale = red->bins / (hi - lo);
+    int bins = red->bins;
+    float mn = red->min, mx = red->max;
+    long long count = 0;
+    double sum = 0.0, m2 = 0.0;
+    long long below = 0, above = 0;
+    long long hist[CONV2D_HIST_MAX_BINS] = {0};
+
+    #pragma omp parallel reduction(min:mn) reduction(max:mx) reduction(+:below, above, hist)
+    {
+        long long t_count = 0;
+        double t_sum = 0.0, t_m2 = 0.0;
+        #pragma omp for schedule(static)
+        for (int i = 0; i < rows; i++) {
+            reduce_values(a[i], cols, lo, hi, scale, bins, &mn, &mx, &t_count, &t_sum, &t_m2, &below, &above, hist);
+        }
+        #pragma omp critical
+        merge_moments(&count, &sum, &m2, t_count, t_sum, t_m2);
+    }
+
+    merge_moments(&red->count, &red->sum, &red->m2, count, sum, m2);
+    red->min = mn;
+    red->max = mx;
+    red->below += below;
+    red->above += above;
+    for (int b = 0; b < bins; b++) red->hist[b] += hist[b];
+}
+
+/**
+ * Combine the reductions of all ranks of comm on root: MPI_Reduce for the
+ * extremes and counts, and the moments gathered and merged pairwise
+ */
+void conv2d_reduce_mpi(Conv2dReduce *red, int root, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    double mm[2] = { red->min, -red->max };
+    double moments[3] = { (double)red->count, red->sum, red->m2 };
+    long long counts[CONV2D_HIST_MAX_BINS + 3];
+    counts[0] = red->count;
+    counts[1] = red->below;
+    counts[2] = red->above;
+    memcpy(counts + 3, red->hist, (size_t)red->bins * sizeof(long long));
+    int n = red->bins + 3;
+
+    if (rank == root) {
+        double *all = (double*)malloc((size_t)size * 3 * sizeof(double));
+        if (!all) {
+            fprintf(stderr, "Error: Failed to allocate memory for reduction moments\n");
+            MPI_Abort(comm, 1);
+        }
+        MPI_Reduce(MPI_IN_PLACE, mm, 2, MPI_DOUBLE, MPI_MIN, root, comm);
+        MPI_Gather(moments, 3, MPI_DOUBLE, all, 3, MPI_DOUBLE, root, comm);
+        MPI_Reduce(MPI_IN_PLACE, counts, n, MPI_LONG_LONG, MPI_SUM, root, comm);
+        red->min = mm[0];
+        red->max = -mm[1];
+        long long total = 0;
+        double sum = 0.0, m2 = 0.0;
+        for (int p = 0; p < size; p++) {
+            merge_moments(&total, &sum, &m2, (long long)all[3 * p], all[3 * p + 1], all[3 * p + 2]);
+        }
+        free(all);
+        red->sum = sum;
+        red->m2 = m2;
+        red->count = counts[0];
+        red->below = counts[1];
+        red->above = counts[2];
+        memcpy(red->hist, counts + 3, (size_t)red->bins * sizeof(long long));
+    } else {
+        MPI_Reduce(mm, NULL, 2, MPI_DOUBLE, MPI_MIN, root, comm);
+        MPI_Gather(moments, 3, MPI_DOUBLE, NULL, 3, MPI_DOUBLE, root, comm);
+        MPI_Reduce(counts, NULL, n, MPI_LONG_LONG, MPI_SUM, root, comm);
+    }
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution with fused output reductions, with
+ * performance statistics
+ *
+ * red must be initialised (conv2d_reduce_init) with the same range and bins
+ * on every rank; on return it holds the statistics of the whole output on
+ * rank 0. If output is NULL no output is stored or gathered (each row lives
+ * in per-thread scratch); otherwise output is filled and gathered to every
+ * rank as in conv2d_stride. Pass MPI_COMM_SELF for the OpenMP-only engine.
+ */
+void conv2d_stride_reduce_stats(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, Conv2dReduce *red, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    stats->output_elements = (long long)out_H * out_W;
+
+    // Distribute output rows among processes by modelled cost
+    int *row_starts = conv2d_create_row_partition(H, W, kH, kW, sH, sW, size, comm);
+    SparseKernel sk;
+    if (conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for reduced convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(H, W, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+
+    float lo = red->hist_lo, hi = red->hist_hi;
+    float scale = red->bins / (hi - lo);
+    int bins = red->bins;
+    float mn = red->min, mx = red->max;
+    long long count = 0;
+    double sum = 0.0, m2 = 0.0;
+    long long below = 0, above = 0;
+    long long hist[CONV2D_HIST_MAX_BINS] = {0};
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel reduction(min:mn) reduction(max:mx) reduction(+:below, above, hist)
+    {
+        long long t_count = 0;
+        double t_sum = 0.0, t_m2 = 0.0;
+        // Scratch row when the output is not kept
+        Conv2dArena *arena = conv2d_thread_arena();
+        Conv2dArenaMark mark = conv2d_arena_mark(arena);
+        float *row = output ? NULL : (float*)conv2d_arena_alloc(arena, (size_t)out_W * sizeof(float));
+        if (!output && !row) {
+            fprintf(stderr, "Error: Failed to allocate memory for output row\n");
+            MPI_Abort(comm, 1);
+        }
+
+        #pragma omp for schedule(runtime)
+        for (int out_i = local_start; out_i < local_end; out_i++) {
+            float *out = output ? output[out_i] : row;
+            conv2d_sparse_row(f, 0, H, W, &sk, sH, sW, out_i, out, 0, out_W);
+            reduce_values(out, out_W, lo, hi, scale, bins, &mn, &mx, &t_count, &t_sum, &t_m2, &below, &above, hist);
+        }
+        conv2d_arena_rewind(arena, mark);
+        #pragma omp critical
+        merge_moments(&count, &sum, &m2, t_count, t_sum, t_m2);
+    }
+    merge_moments(&red->count, &red->sum, &red->m2, count, sum, m2);
+    red->min = mn;
+    red->max = mx;
+    red->below += below;
+    red->above += above;
+    for (int b = 0; b < bins; b++) red->hist[b] += hist[b];
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        conv2d_reduce_mpi(red, 0, comm);
+        stats->num_communications += 3;
+        stats->bytes_communicated += 5 * sizeof(double) + (bins + 3) * sizeof(long long);
+
+        // Gather the output only when it is kept
+        if (output) {
+            for (int p = 0; p < size; p++) {
+                for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                    MPI_Bcast(output[i], out_W, MPI_FLOAT, p, comm);
+                    stats->num_communications++;
+                    stats->bytes_communicated += (long long)out_W * sizeof(float);
+                }
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time = stats->broadcast_time;
+    }
+
+    conv2d_sparse_free(&sk);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution with fused output reductions (see
+ * conv2d_stride_reduce_stats)
+ */
+void conv2d_stride_reduce(float **f, int H, int W, float **g, int kH, int kW, int sH, int sW, float **output, Conv2dReduce *red, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_reduce_stats(f, H, W, g, kH, kW, sH, sW, output, red, comm, &stats);
+}
+
+/**
+ * Print a reduction: count, min, max, mean, standard deviation and the
+ * histogram as one bar per bin
+ */
+void conv2d_reduce_print(const Conv2dReduce *red) {
+    double mean = red->count > 0 ? red->sum / red->count : 0.0;
+    double var = red->count > 0 ? red->m2 / red->count : 0.0;
+    printf("  - Count:   %lld\n", red->count);
+    printf("  - Min:     %.6g\n", red->min);
+    printf("  - Max:     %.6g\n", red->max);
+    printf("  - Sum:     %.6g\n", red->sum);
+    printf("  - Mean:    %.6g\n", mean);
+    printf("  - Std dev: %.6g\n", var > 0.0 ? sqrt(var) : 0.0);
+    printf("  - Histogram over [%.4g, %.4g], %d bins (%lld below, %lld above):\n",
+           red->hist_lo, red->hist_hi, red->bins, red->below, red->above);
+
+    long long peak = 1;
+    for (int b = 0; b < red->bins; b++) {
+        if (red->hist[b] > peak) peak = red->hist[b];
+    }
+    double width = (red->hist_hi - red->hist_lo) / red->bins;
+    for (int b = 0; b < red->bins; b++) {
+        int bar = (int)(40 * red->hist[b] / peak);
+        printf("    [%10.4g, %10.4g) %12lld ", red->hist_lo + b * width, red->hist_lo + (b + 1) * width, red->hist[b]);
+        for (int k = 0; k < bar; k++) putchar('#');
+        putchar('\n');
+    }
+}
@@ -0,0 +1,245 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Region-of-interest convolution
+ *
+ * When only a window of the output is needed (a crop around a detection),
+ * loading, broadcasting and convolving the whole image is wasted work. The
+ * output rectangle is mapped back through stride and "same" padding to the
+ * minimal input rectangle it reads, clipped to the image; only that crop is
+ * read (seek-based for binary files, see read_array_region) and only that
+ * crop is split into bands and sent to the ranks. Rows and columns of the
+ * crop keep their global coordinates in the kernel, so taps that fall outside
+ * the image are skipped exactly as in the full convolution (zero padding)
+ * while taps inside the image always find their value in the crop. The
+ * result is bit-identical to the same window of conv2d_stride.
+ */
+
+#define ROI_COL_BLOCK 4096
+
+/**
+ * Minimal input rectangle read by the output rectangle roi, clipped to the
+ * H x W input. Returns -1 if roi is empty or not inside the output.
+ */
+int conv2d_roi_input_rect(Conv2dRect roi, int H, int W, int kH, int kW, int sH, int sW, Conv2dRect *in) {
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    if (roi.h <= 0 || roi.w <= 0 || roi.y < 0 || roi.x < 0 ||
+        roi.y + roi.h > out_H || roi.x + roi.w > out_W) {
+        return -1;
+    }
+
+    // out_i reads input rows [out_i*sH - pad_top, out_i*sH - pad_top + kH - 1]
+    int y0 = roi.y * sH - pad_top;
+    int y1 = (roi.y + roi.h - 1) * sH - pad_top + kH;
+    int x0 = roi.x * sW - pad_left;
+    int x1 = (roi.x + roi.w - 1) * sW - pad_left + kW;
+    if (y0 < 0) y0 = 0;
+    if (x0 < 0) x0 = 0;
+    if (y1 > H) y1 = H;
+    if (x1 > W) x1 = W;
+
+    in->y = y0;
+    in->x = x0;
+    in->h = y1 - y0;
+    in->w = x1 - x0;
+    return 0;
+}
+
+/**
+ * One ROI output row: global output row out_i, global output columns
+ * [x0, x0 + w) into out[0, w)
+ *
+ * f[i - f_row0][j - f_col0] is input pixel (i, j); H and W are the full input
+ * size, so padding is decided in global coordinates.
+ */
+static void roi_row(float **f, int f_row0, int f_col0, int H, int W, const SparseKernel *sk, int sH, int sW,
+                    int out_i, int x0, int w, float *out) {
+    int pad_top = (sk->kH - 1) / 2;
+    int pad_left = (sk->kW - 1) / 2;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    for (int j0 = 0; j0 < w; j0 += ROI_COL_BLOCK) {
+        int j1 = j0 + ROI_COL_BLOCK < w ? j0 + ROI_COL_BLOCK : w;
+        for (int j = j0; j < j1; j++) out[j] = 0.0f;
+
+        for (int r = 0; r < sk->num_rows; r++) {
+            int input_i = out_i * sH + sk->row_dy[r] - pad_top;
+            if (input_i < 0 || input_i >= H) continue;
+            const float *src = f[input_i - f_row0];
+
+            for (int t = sk->row_first[r]; t < sk->row_first[r + 1]; t++) {
+                int dx = sk->tap_dx[t] - pad_left;
+                float wt = sk->tap_w[t];
+
+                // Global columns whose input_j = j * sW + dx is inside the row
+                int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+                int hi = W - 1 - dx >= 0 ? (W - 1 - dx) / sW + 1 : 0;
+                lo -= x0;
+                hi -= x0;
+                if (lo < j0) lo = j0;
+                if (hi > j1) hi = j1;
+
+                const float *s = src + (x0 * sW + dx - f_col0);
+                if (sW == 1) {
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        out[j] += wt * s[j];
+                    }
+                } else {
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        out[j] += wt * s[j * sW];
+                    }
+                }
+            }
+        }
+        if (ep) conv2d_epilogue_row(ep, out + j0, j1 - j0);
+    }
+}
+
+/**
+ * Input rows [*b0, *b1) of the crop in that ROI output rows [a, b) read
+ */
+static void roi_band(Conv2dRect in, Conv2dRect roi, int kH, int sH, int a, int b, int *b0, int *b1) {
+    int pad_top = (kH - 1) / 2;
+    if (a >= b) {
+        *b0 = *b1 = in.y;
+        return;
+    }
+    int y0 = (roi.y + a) * sH - pad_top;
+    int y1 = (roi.y + b - 1) * sH - pad_top + kH;
+    *b0 = y0 > in.y ? y0 : in.y;
+    *b1 = y1 < in.y + in.h ? y1 : in.y + in.h;
+    if (*b1 < *b0) *b1 = *b0;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution of the output rectangle roi, with
+ * performance statistics
+ *
+ * crop is the input rectangle in (from conv2d_roi_input_rect) of the H x W
+ * image and is needed on rank 0 only; g is needed on every rank. Rank 0 sends
+ * each rank just the crop rows its share of the ROI reads. output is
+ * roi.h x roi.w and is filled on every rank. Pass MPI_COMM_SELF for the
+ * OpenMP-only engine.
+ */
+void conv2d_stride_roi_stats(float **crop, Conv2dRect in, int H, int W, float **g, int kH, int kW, int sH, int sW, Conv2dRect roi, float **output, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+    stats->output_elements = (long long)roi.h * roi.w;
+
+    // Split the ROI rows by modelled cost, as a roi.h x roi.w output of a
+    // (roi.h * sH) x (roi.w * sW) input
+    int *row_starts = conv2d_create_row_partition(roi.h * sH, roi.w * sW, kH, kW, sH, sW, size, comm);
+    SparseKernel sk;
+    if (conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for ROI convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(roi.h * sH, roi.w * sW, kH, kW, sH, sW, size, row_starts, stats);
+    int local_start = row_starts[rank];
+    int local_end = row_starts[rank + 1];
+    int band0, band1;
+    roi_band(in, roi, kH, sH, local_start, local_end, &band0, &band1);
+
+    // Distribute the crop bands; rank 0 computes straight from crop
+    float *band_data = NULL;
+    float **band = NULL;
+    if (rank == 0) {
+        band = crop + (band0 - in.y);
+    } else if (band1 > band0) {
+        band_data = (float*)malloc((size_t)(band1 - band0) * in.w * sizeof(float));
+        band = (float**)malloc((band1 - band0) * sizeof(float*));
+        if (!band_data || !band) {
+            fprintf(stderr, "Error: Failed to allocate memory for ROI band\n");
+            MPI_Abort(comm, 1);
+        }
+        for (int i = 0; i < band1 - band0; i++) band[i] = band_data + (size_t)i * in.w;
+    }
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        if (rank == 0) {
+            float *pack = NULL;
+            size_t pack_rows = 0;
+            for (int p = 1; p < size; p++) {
+                int p0, p1;
+                roi_band(in, roi, kH, sH, row_starts[p], row_starts[p + 1], &p0, &p1);
+                if (p1 <= p0) continue;
+                if ((size_t)(p1 - p0) > pack_rows) {
+                    free(pack);
+                    pack_rows = p1 - p0;
+                    pack = (float*)malloc(pack_rows * in.w * sizeof(float));
+                    if (!pack) {
+                        fprintf(stderr, "Error: Failed to allocate memory for ROI band\n");
+                        MPI_Abort(comm, 1);
+                    }
+                }
+                double t_copy = MPI_Wtime();
+                for (int i = p0; i < p1; i++) {
+                    memcpy(pack + (size_t)(i - p0) * in.w, crop[i - in.y], in.w * sizeof(float));
+                }
+                stats->memory_copy_time += MPI_Wtime() - t_copy;
+                MPI_Send(pack, (p1 - p0) * in.w, MPI_FLOAT, p, 0, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)(p1 - p0) * in.w * sizeof(float);
+            }
+            free(pack);
+        } else if (band1 > band0) {
+            MPI_Recv(band_data, (band1 - band0) * in.w, MPI_FLOAT, 0, 0, comm, MPI_STATUS_IGNORE);
+        }
+        stats->communication_time = MPI_Wtime() - t_comm_start;
+    }
+
+    t_comp_start = MPI_Wtime();
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime)
+    for (int i = local_start; i < local_end; i++) {
+        roi_row(band, band0, in.x, H, W, &sk, sH, sW, roi.y + i, roi.x, roi.w, output[i]);
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Gather the ROI rows to all processes
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        for (int p = 0; p < size; p++) {
+            for (int i = row_starts[p]; i < row_starts[p + 1]; i++) {
+                MPI_Bcast(output[i], roi.w, MPI_FLOAT, p, comm);
+                stats->num_communications++;
+                stats->bytes_communicated += (long long)roi.w * sizeof(float);
+            }
+        }
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time += stats->broadcast_time;
+    }
+
+    if (rank != 0) {
+        free(band);
+        free(band_data);
+    }
+    conv2d_sparse_free(&sk);
+    free(row_starts);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP convolution of the output rectangle roi (see
+ * conv2d_stride_roi_stats)
+ */
+void conv2d_stride_roi(float **crop, Conv2dRect in, int H, int W, float **g, int kH, int kW, int sH, int sW, Conv2dRect roi, float **output, MPI_Comm comm) {
+    PerfStats stats;
+    conv2d_stride_roi_stats(crop, in, H, W, g, kH, kW, sH, sW, roi, output, comm, &stats);
+}
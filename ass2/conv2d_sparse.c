@@ -0,0 +1,193 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Sparse-kernel (tap-list) engine
+ *
+ * Many production kernels are mostly zeros (edge detectors inside large
+ * windows, ring or cross masks), yet the dense loops multiply all kH x kW
+ * taps for every output. Here the kernel is compiled once into a list of its
+ * nonzero taps (dx, weight), grouped by kernel row (dy). Each output row is
+ * then accumulated tap by tap: for one tap, every output column reads the
+ * same input row at a fixed offset, so the loop over columns is a unit-stride
+ * (or sW-strided) axpy that vectorizes, and the cost is proportional to the
+ * number of nonzero taps. Columns are processed in blocks that stay in L1
+ * while all taps of the kernel are applied.
+ *
+ * conv2d_omp_stride, conv2d_stride and conv2d_stride_stats use this path
+ * automatically when the kernel's density is at or below the threshold;
+ * denser kernels keep the direct loops.
+ */
+
+// Output columns accumulated together (16 KB of floats)
+#define SPARSE_COL_BLOCK 4096
+
+static double sparse_threshold = SPARSE_DENSITY_THRESHOLD;
+
+/**
+ * Set the density (nonzero taps / all taps) at or below which the tap-list
+ * engine is used. 0 disables it, 1 uses it for every kernel.
+ */
+void conv2d_set_sparse_threshold(double threshold) {
+    sparse_threshold = threshold;
+}
+
+double conv2d_get_sparse_threshold(void) {
+    return sparse_threshold;
+}
+
+/**
+ * Fraction of nonzero taps in g
+ */
+double conv2d_kernel_density(float **g, int kH, int kW) {
+    int nnz = 0;
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            if (g[ki][kj] != 0.0f) nnz++;
+        }
+    }
+    return (double)nnz / ((double)kH * kW);
+}
+
+/**
+ * Compile g into its tap list. Returns 0 on success.
+ */
+int conv2d_sparse_compile(float **g, int kH, int kW, SparseKernel *sk) {
+    memset(sk, 0, sizeof(*sk));
+    sk->kH = kH;
+    sk->kW = kW;
+
+    int nnz = 0;
+    for (int ki = 0; ki < kH; ki++) {
+        for (int kj = 0; kj < kW; kj++) {
+            if (g[ki][kj] != 0.0f) nnz++;
+        }
+    }
+    sk->nnz = nnz;
+    sk->density = (double)nnz / ((double)kH * kW);
+
+    sk->row_dy = (int*)malloc((kH > 0 ? kH : 1) * sizeof(int));
+    sk->row_first = (int*)malloc((kH + 1) * sizeof(int));
+    sk->tap_dx = (int*)malloc((nnz > 0 ? nnz : 1) * sizeof(int));
+    sk->tap_w = (float*)malloc((nnz > 0 ? nnz : 1) * sizeof(float));
+    if (!sk->row_dy || !sk->row_first || !sk->tap_dx || !sk->tap_w) {
+        fprintf(stderr, "Error: Failed to allocate memory for sparse kernel\n");
+        conv2d_sparse_free(sk);
+        return -1;
+    }
+
+    int t = 0;
+    for (int ki = 0; ki < kH; ki++) {
+        int first = t;
+        for (int kj = 0; kj < kW; kj++) {
+            if (g[ki][kj] != 0.0f) {
+                sk->tap_dx[t] = kj;
+                sk->tap_w[t] = g[ki][kj];
+                t++;
+            }
+        }
+        if (t > first) {
+            sk->row_dy[sk->num_rows] = ki;
+            sk->row_first[sk->num_rows] = first;
+            sk->num_rows++;
+        }
+    }
+    sk->row_first[sk->num_rows] = t;
+    return 0;
+}
+
+void conv2d_sparse_free(SparseKernel *sk) {
+    free(sk->row_dy);
+    free(sk->row_first);
+    free(sk->tap_dx);
+    free(sk->tap_w);
+    memset(sk, 0, sizeof(*sk));
+}
+
+/**
+ * Compile g if it is sparse enough for the tap-list engine. Returns 1 (and a
+ * compiled kernel to free) when the engine should be used, 0 otherwise.
+ */
+int conv2d_sparse_select(float **g, int kH, int kW, SparseKernel *sk) {
+    if (sparse_threshold <= 0.0) return 0;
+    if (conv2d_kernel_density(g, kH, kW) > sparse_threshold) return 0;
+    return conv2d_sparse_compile(g, kH, kW, sk) == 0;
+}
+
+/**
+ * Tap-list convolution of output row out_i, columns [col_start, col_end),
+ * into out (indexed by output column). The pointwise epilogue, if set, is
+ * applied to each column block while it is still in cache.
+ */
+void conv2d_sparse_row(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, int out_i, float *out, int col_start, int col_end) {
+    int pad_top = (sk->kH - 1) / 2;
+    int pad_left = (sk->kW - 1) / 2;
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+
+    for (int j0 = col_start; j0 < col_end; j0 += SPARSE_COL_BLOCK) {
+        int j1 = j0 + SPARSE_COL_BLOCK < col_end ? j0 + SPARSE_COL_BLOCK : col_end;
+        for (int j = j0; j < j1; j++) out[j] = 0.0f;
+
+        for (int r = 0; r < sk->num_rows; r++) {
+            int input_i = out_i * sH + sk->row_dy[r] - pad_top;
+            if (input_i < 0 || input_i >= H) continue;
+            const float *src = f[input_i - f_row0];
+
+            for (int t = sk->row_first[r]; t < sk->row_first[r + 1]; t++) {
+                int dx = sk->tap_dx[t] - pad_left;
+                float w = sk->tap_w[t];
+
+                // Columns whose input_j = j * sW + dx is inside the row
+                int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+                int hi = W - 1 - dx >= 0 ? (W - 1 - dx) / sW + 1 : 0;
+                if (lo < j0) lo = j0;
+                if (hi > j1) hi = j1;
+
+                if (sW == 1) {
+                    const float *s = src + dx;
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        out[j] += w * s[j];
+                    }
+                } else {
+                    #pragma omp simd
+                    for (int j = lo; j < hi; j++) {
+                        out[j] += w * src[j * sW + dx];
+                    }
+                }
+            }
+        }
+        if (ep) conv2d_epilogue_row(ep, out + j0, j1 - j0);
+    }
+}
+
+/**
+ * Tap-list convolution of the output block [row_start, row_end) x
+ * [col_start, col_end), computed by the calling thread
+ *
+ * f[input_i - f_row0] is input row input_i (so a rank's local band can be
+ * passed with its first row), output[out_i] receives output row out_i.
+ */
+void conv2d_sparse_block(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, float **output, int row_start, int row_end, int col_start, int col_end) {
+    for (int out_i = row_start; out_i < row_end; out_i++) {
+        conv2d_sparse_row(f, f_row0, H, W, sk, sH, sW, out_i, output[out_i], col_start, col_end);
+    }
+}
+
+/**
+ * Tap-list convolution of output rows [row_start, row_end) (see
+ * conv2d_sparse_block), OpenMP-parallel over rows with the tuned runtime
+ * schedule.
+ */
+void conv2d_sparse_rows(float **f, int f_row0, int H, int W, const SparseKernel *sk, int sH, int sW, float **output, int row_start, int row_end) {
+    int out_W = (W + sW - 1) / sW;
+
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime)
+    for (int out_i = row_start; out_i < row_end; out_i++) {
+        conv2d_sparse_block(f, f_row0, H, W, sk, sH, sW, output, out_i, out_i + 1, 0, out_W);
+    }
+}
@@ -0,0 +1,392 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Pipelined frame-stream (video) processing
+ *
+ * Processing a frame sequence one frame at a time leaves every rank idle
+ * while the next frame is read and broadcast and the last one is gathered
+ * and written. The stream engine pipelines the frames instead. While frame
+ * k is convolved, frame k+1 is already being produced by the source and
+ * scattered into the second of two rank-local input bands, and frame k-1 is
+ * gathered and handed to the sink. The master thread of each rank drives
+ * the nonblocking collectives (MPI_Iscatterv, MPI_Igatherv) and the
+ * source/sink calls, then joins the other threads on the rows of frame k,
+ * testing the outstanding requests between row chunks so they progress.
+ *
+ * Input bands overlap by the kernel halo, and one MPI_Iscatterv may not read
+ * a root location twice, so each band arrives as three nonoverlapping
+ * scatters: the rows it owns, its top halo and its bottom halo.
+ *
+ * When a frame is too small to keep many ranks busy, the ranks are split
+ * with MPI_Comm_split into groups. Each group pipelines every groups-th
+ * frame on its own communicator, and its root calls the source and sink.
+ */
+
+#define STREAM_ROW_CHUNK 4  // Output rows claimed per grab; requests are tested in between
+
+/**
+ * Rank groups for a stream of H x W frames on size ranks: every rank of a
+ * group keeps at least STREAM_RANK_PIXELS output pixels. The result divides
+ * the ranks into groups that differ by at most one rank.
+ */
+int conv2d_stream_groups(int H, int W, int sH, int sW, int size) {
+    long long out_pixels = (long long)((H + sH - 1) / sH) * ((W + sW - 1) / sW);
+    long long group_size = out_pixels / STREAM_RANK_PIXELS;
+    if (group_size < 1) group_size = 1;
+    if (group_size > size) group_size = size;
+    return (int)((size + group_size - 1) / group_size);
+}
+
+static void stream_stats_init(StreamStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Combine the per-frame latencies (known on the root of the frame's group,
+ * 0 elsewhere) on rank 0 and fill the rate and latency fields there
+ */
+static void stream_finish_stats(double *latency, int num_frames, double total_time, MPI_Comm comm, StreamStats *stats) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : latency, latency, num_frames, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&total_time, &stats->total_time, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    if (rank != 0 || num_frames <= 0) return;
+
+    double sum = 0.0;
+    for (int k = 0; k < num_frames; k++) sum += latency[k];
+    qsort(latency, num_frames, sizeof(double), compare_doubles);
+    stats->frames = num_frames;
+    stats->frames_per_second = stats->total_time > 0 ? num_frames / stats->total_time : 0.0;
+    stats->latency_mean = sum / num_frames;
+    stats->latency_p50 = latency[(int)(0.50 * (num_frames - 1) + 0.5)];
+    stats->latency_p99 = latency[(int)(0.99 * (num_frames - 1) + 0.5)];
+    stats->latency_max = latency[num_frames - 1];
+}
+
+/**
+ * Pipeline state of one rank in its group
+ */
+typedef struct {
+    MPI_Comm group;
+    int grank, gsize;
+    int color, groups;               // Group index, number of groups
+    int H, W, out_H, out_W;
+    int band_lo;                     // First input row of this rank's band
+    const int *core;                 // Input rows owned per member, gsize + 1 bounds
+    const int *counts, *displs;      // Own rows, top halos, bottom halos: 3 x gsize
+    float **frame;                   // Input frames on the group root [2]
+    float **band_data;               // Input bands [2]
+    float **out_frame;               // Output frames on the group root [2]
+    MPI_Request (*scatter)[3];       // Three scatters per band [2]
+    MPI_Request *gather;             // [2]
+    double *frame_start, *latency;   // Per global frame, on the group root
+    Conv2dFrameFn source, sink;
+    void *ctx;
+    StreamStats *stats;
+} StreamPipe;
+
+/**
+ * Produce local frame j into frame[b] on the root and start scattering it
+ * into band b: own rows, top halo, bottom halo
+ */
+static void stream_start_scatter(StreamPipe *pp, int j, int b) {
+    int k = pp->color + j * pp->groups;
+    if (pp->grank == 0) {
+        pp->frame_start[k] = MPI_Wtime();
+        pp->source(k, pp->frame[b], pp->H, pp->W, pp->ctx);
+    }
+    int g = pp->gsize, r = pp->grank, W = pp->W;
+    size_t offset[3] = { (size_t)(pp->core[r] - pp->band_lo) * W, 0,
+                         (size_t)(pp->core[r + 1] - pp->band_lo) * W };
+    for (int s = 0; s < 3; s++) {
+        MPI_Iscatterv(pp->frame[b], pp->counts + s * g, pp->displs + s * g, MPI_FLOAT,
+                      pp->band_data[b] + offset[s], pp->counts[s * g + r], MPI_FLOAT, 0, pp->group,
+                      &pp->scatter[b][s]);
+        pp->stats->bytes_communicated += (long long)pp->counts[s * g + r] * sizeof(float);
+    }
+}
+
+/**
+ * Wait for local frame j's gather into out_frame[b] and hand it to the sink
+ */
+static void stream_finish_gather(StreamPipe *pp, int j, int b) {
+    int k = pp->color + j * pp->groups;
+    MPI_Wait(&pp->gather[b], MPI_STATUS_IGNORE);
+    if (pp->grank == 0) {
+        pp->sink(k, pp->out_frame[b], pp->out_H, pp->out_W, pp->ctx);
+        pp->latency[k] = MPI_Wtime() - pp->frame_start[k];
+    }
+}
+
+/**
+ * Pipelined hybrid MPI+OpenMP convolution of num_frames H x W frames
+ *
+ * source(k, frame, H, W, ctx) fills frame k (row-major) and sink(k, out,
+ * out_H, out_W, ctx) consumes its output; both are called on the root of
+ * the rank group that processes frame k. groups is the number of rank groups
+ * (0 picks conv2d_stream_groups). g is needed on every rank. Rates and
+ * latencies in stats are valid on rank 0 of comm.
+ */
+void conv2d_stream_stats(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW, int groups,
+                         Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm, StreamStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // The master thread calls MPI inside a parallel region, which needs at
+    // least MPI_THREAD_FUNNELED; without it, go frame by frame
+    int level;
+    MPI_Query_thread(&level);
+    if (level < MPI_THREAD_FUNNELED) {
+        if (rank == 0) fprintf(stderr, "Warning: MPI thread support below MPI_THREAD_FUNNELED, streaming frame by frame\n");
+        conv2d_stream_framewise_stats(num_frames, H, W, g, kH, kW, sH, sW, source, sink, ctx, comm, stats);
+        return;
+    }
+    stream_stats_init(stats);
+
+    double t_start = MPI_Wtime();
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    int pad_top = (kH - 1) / 2;
+    if (groups <= 0) groups = conv2d_stream_groups(H, W, sH, sW, size);
+    if (groups > size) groups = size;
+
+    // Contiguous groups of ranks, each on its own communicator
+    int color = (int)((long long)rank * groups / size);
+    int first = (int)(((long long)color * size + groups - 1) / groups);
+    MPI_Comm group;
+    MPI_Comm_split(comm, color, rank, &group);
+    int grank, gsize;
+    MPI_Comm_rank(group, &grank);
+    MPI_Comm_size(group, &gsize);
+    stats->groups = groups;
+    stats->group_size = gsize;
+
+    // Output rows by modelled cost with the members' rank weights
+    const double *world_weights = conv2d_get_rank_weights(size);
+    double *weights = world_weights ? (double*)malloc(gsize * sizeof(double)) : NULL;
+    int *row_starts = (int*)malloc((gsize + 1) * sizeof(int));
+    int *core = (int*)malloc((gsize + 1) * sizeof(int));
+    int *counts = (int*)malloc(3 * gsize * sizeof(int));
+    int *displs = (int*)malloc(3 * gsize * sizeof(int));
+    int *out_counts = (int*)malloc(gsize * sizeof(int));
+    int *out_displs = (int*)malloc(gsize * sizeof(int));
+    SparseKernel sk;
+    if ((world_weights && !weights) || !row_starts || !core || !counts || !displs || !out_counts || !out_displs ||
+        conv2d_sparse_compile(g, kH, kW, &sk) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for frame stream\n");
+        MPI_Abort(comm, 1);
+    }
+    if (weights) {
+        for (int p = 0; p < gsize; p++) weights[p] = world_weights[first + p];
+    }
+    conv2d_partition_rows(H, W, kH, kW, sH, sW, gsize, weights, row_starts);
+
+    // Input rows: core[p] .. core[p + 1] are scattered to member p as its
+    // own rows, halos above and below come in two more scatters
+    core[0] = 0;
+    core[gsize] = H;
+    for (int p = 1; p < gsize; p++) {
+        core[p] = row_starts[p] * sH < H ? row_starts[p] * sH : H;
+    }
+    for (int p = 0; p < gsize; p++) {
+        int lo = row_starts[p] * sH - pad_top;
+        int hi = row_starts[p + 1] > row_starts[p] ? (row_starts[p + 1] - 1) * sH - pad_top + kH : lo;
+        if (lo < 0) lo = 0;
+        if (hi > H) hi = H;
+        if (lo > core[p]) lo = core[p];
+        if (hi < core[p + 1]) hi = core[p + 1];
+        if ((p > 0 && lo < core[p - 1]) || (p < gsize - 1 && hi > core[p + 2])) {
+            if (rank == first) fprintf(stderr, "Error: %dx%d frames are too small for %d ranks per group\n", H, W, gsize);
+            MPI_Abort(comm, 1);
+        }
+        counts[p] = (core[p + 1] - core[p]) * W;
+        displs[p] = core[p] * W;
+        counts[gsize + p] = (core[p] - lo) * W;
+        displs[gsize + p] = lo * W;
+        counts[2 * gsize + p] = (hi - core[p + 1]) * W;
+        displs[2 * gsize + p] = core[p + 1] * W;
+        out_counts[p] = (row_starts[p + 1] - row_starts[p]) * out_W;
+        out_displs[p] = row_starts[p] * out_W;
+    }
+    int band_lo = core[grank] - counts[gsize + grank] / W;
+    int band_rows = (counts[grank] + counts[gsize + grank] + counts[2 * gsize + grank]) / W;
+    int local_start = row_starts[grank];
+    int local_end = row_starts[grank + 1];
+
+    // Double-buffered bands on every member, frames on the group root
+    float *band_data[2], **band[2], *out_band[2];
+    float *frame[2] = { NULL, NULL }, *out_frame[2] = { NULL, NULL };
+    for (int b = 0; b < 2; b++) {
+        band_data[b] = (float*)malloc(((size_t)band_rows * W + 1) * sizeof(float));
+        band[b] = (float**)malloc((band_rows + 1) * sizeof(float*));
+        out_band[b] = (float*)malloc(((size_t)(local_end - local_start) * out_W + 1) * sizeof(float));
+        if (grank == 0) {
+            frame[b] = (float*)malloc((size_t)H * W * sizeof(float));
+            out_frame[b] = (float*)malloc((size_t)out_H * out_W * sizeof(float));
+        }
+        if (!band_data[b] || !band[b] || !out_band[b] || (grank == 0 && (!frame[b] || !out_frame[b]))) {
+            fprintf(stderr, "Error: Failed to allocate memory for frame buffers\n");
+            MPI_Abort(comm, 1);
+        }
+        for (int i = 0; i < band_rows; i++) band[b][i] = band_data[b] + (size_t)i * W;
+    }
+
+    double *latency = (double*)calloc(num_frames > 0 ? num_frames : 1, sizeof(double));
+    double *frame_start = (double*)calloc(num_frames > 0 ? num_frames : 1, sizeof(double));
+    if (!latency || !frame_start) {
+        fprintf(stderr, "Error: Failed to allocate memory for frame latencies\n");
+        MPI_Abort(comm, 1);
+    }
+
+    // This group's frames are color, color + groups, ...
+    int local_frames = num_frames > color ? (num_frames - color + groups - 1) / groups : 0;
+    MPI_Request scatter[2][3], gather[2];
+    for (int b = 0; b < 2; b++) {
+        for (int s = 0; s < 3; s++) scatter[b][s] = MPI_REQUEST_NULL;
+        gather[b] = MPI_REQUEST_NULL;
+    }
+    StreamPipe pipe = { group, grank, gsize, color, groups, H, W, out_H, out_W, band_lo,
+                        core, counts, displs, frame, band_data, out_frame, scatter, gather,
+                        frame_start, latency, source, sink, ctx, stats };
+
+    if (local_frames > 0) stream_start_scatter(&pipe, 0, 0);
+    for (int j = 0; j < local_frames; j++) {
+        int b = j & 1;
+        double t_wait = MPI_Wtime();
+        MPI_Waitall(3, scatter[b], MPI_STATUSES_IGNORE);
+        stats->wait_time += MPI_Wtime() - t_wait;
+
+        double t_comp = MPI_Wtime();
+        int next_row = local_start;
+        #pragma omp parallel
+        {
+            // The master thread feeds the pipeline, then helps with the rows
+            #pragma omp master
+            {
+                if (j + 1 < local_frames) stream_start_scatter(&pipe, j + 1, b ^ 1);
+                if (j >= 1) stream_finish_gather(&pipe, j - 1, b ^ 1);
+            }
+
+            float **f = band[b];
+            float *out = out_band[b];
+            for (;;) {
+                int i0;
+                #pragma omp atomic capture
+                { i0 = next_row; next_row += STREAM_ROW_CHUNK; }
+                if (i0 >= local_end) break;
+                int i1 = i0 + STREAM_ROW_CHUNK < local_end ? i0 + STREAM_ROW_CHUNK : local_end;
+                for (int i = i0; i < i1; i++) {
+                    conv2d_sparse_row(f, band_lo, H, W, &sk, sH, sW, i,
+                                      out + (size_t)(i - local_start) * out_W, 0, out_W);
+                }
+                if (omp_get_thread_num() == 0 && j + 1 < local_frames) {
+                    int done;
+                    MPI_Testall(3, scatter[b ^ 1], &done, MPI_STATUSES_IGNORE);
+                }
+            }
+        }
+        stats->compute_time += MPI_Wtime() - t_comp;
+
+        MPI_Igatherv(out_band[b], out_counts[grank], MPI_FLOAT, out_frame[b], out_counts, out_displs,
+                     MPI_FLOAT, 0, group, &gather[b]);
+        stats->bytes_communicated += (long long)out_counts[grank] * sizeof(float);
+    }
+    if (local_frames > 0) stream_finish_gather(&pipe, local_frames - 1, (local_frames - 1) & 1);
+
+    stream_finish_stats(latency, num_frames, MPI_Wtime() - t_start, comm, stats);
+
+    for (int b = 0; b < 2; b++) {
+        free(band_data[b]);
+        free(band[b]);
+        free(out_band[b]);
+        free(frame[b]);
+        free(out_frame[b]);
+    }
+    free(latency);
+    free(frame_start);
+    conv2d_sparse_free(&sk);
+    free(weights);
+    free(row_starts);
+    free(core);
+    free(counts);
+    free(displs);
+    free(out_counts);
+    free(out_displs);
+    MPI_Comm_free(&group);
+}
+
+/**
+ * Pipelined frame stream (see conv2d_stream_stats)
+ */
+void conv2d_stream(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW, int groups,
+                   Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm) {
+    StreamStats stats;
+    conv2d_stream_stats(num_frames, H, W, g, kH, kW, sH, sW, groups, source, sink, ctx, comm, &stats);
+}
+
+/**
+ * One frame at a time, the baseline for the stream engine: rank 0 produces
+ * the frame, broadcasts it, conv2d_stride_stats computes and gathers it and
+ * rank 0 hands the output to the sink before the next frame starts
+ */
+void conv2d_stream_framewise_stats(int num_frames, int H, int W, float **g, int kH, int kW, int sH, int sW,
+                                   Conv2dFrameFn source, Conv2dFrameFn sink, void *ctx, MPI_Comm comm,
+                                   StreamStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    stream_stats_init(stats);
+    stats->groups = 1;
+    stats->group_size = size;
+
+    double t_start = MPI_Wtime();
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    float *frame = (float*)malloc((size_t)H * W * sizeof(float));
+    float *out_frame = (float*)malloc((size_t)out_H * out_W * sizeof(float));
+    float **f = (float**)malloc(H * sizeof(float*));
+    float **output = (float**)malloc(out_H * sizeof(float*));
+    double *latency = (double*)calloc(num_frames > 0 ? num_frames : 1, sizeof(double));
+    if (!frame || !out_frame || !f || !output || !latency) {
+        fprintf(stderr, "Error: Failed to allocate memory for frame buffers\n");
+        MPI_Abort(comm, 1);
+    }
+    for (int i = 0; i < H; i++) f[i] = frame + (size_t)i * W;
+    for (int i = 0; i < out_H; i++) output[i] = out_frame + (size_t)i * out_W;
+
+    for (int k = 0; k < num_frames; k++) {
+        double t_frame = MPI_Wtime();
+        if (rank == 0) source(k, frame, H, W, ctx);
+        double t_wait = MPI_Wtime();
+        for (int i = 0; i < H; i++) {
+            MPI_Bcast(f[i], W, MPI_FLOAT, 0, comm);
+        }
+        stats->wait_time += MPI_Wtime() - t_wait;
+        stats->bytes_communicated += size > 1 ? (long long)H * W * sizeof(float) : 0;
+
+        PerfStats frame_stats;
+        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, output, comm, &frame_stats);
+        stats->compute_time += frame_stats.computation_time;
+        stats->wait_time += frame_stats.communication_time;
+        stats->bytes_communicated += frame_stats.bytes_communicated;
+        if (rank == 0) {
+            sink(k, out_frame, out_H, out_W, ctx);
+            latency[k] = MPI_Wtime() - t_frame;
+        }
+    }
+
+    stream_finish_stats(latency, num_frames, MPI_Wtime() - t_start, comm, stats);
+    free(frame);
+    free(out_frame);
+    free(f);
+    free(output);
+    free(latency);
+}
@@ -0,0 +1,345 @@
+#include "conv2d.h"
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Volumetric (3D) convolution with stride and "same" zero padding
+ *
+ * Volumes are contiguous D x H x W float arrays (slice, row, column), the
+ * layout of the binary volume file. An output slice is the sum over the
+ * kernel slices kd of a 2D convolution of input slice od * sD + kd - pad_front
+ * with kernel slice kd, so each kernel slice is compiled into a tap list and
+ * an output row accumulates one SIMD run per tap and input slice. The run
+ * bounds clip the zero padding (the border split of the 2D engines), and
+ * all-zero kernel slices and taps cost nothing.
+ *
+ * Threads work on tiles of CONV3D_TILE_D output slices x CONV3D_TILE_H
+ * output rows; inside a tile, output columns are walked in blocks of
+ * CONV3D_TILE_W, so the input a tile reads stays in cache across its slices
+ * and rows.
+ *
+ * Ranks own slabs of output slices split by the row cost model (valid depth
+ * taps per slice). Rank 0 holds the volume and scatters each rank the input
+ * slices it owns with one MPI_Scatterv; the kernel halo slices then come
+ * from the neighbouring ranks by MPI_Sendrecv, and the output slabs return
+ * to rank 0 with MPI_Gatherv. Every transfer is counted in whole slices.
+ */
+
+/**
+ * Serial 3D convolution with stride and "same" padding (reference)
+ * Output size: ceil(D/sD) x ceil(H/sH) x ceil(W/sW)
+ */
+void conv3d_serial_stride(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW,
+                          int sD, int sH, int sW, float *output) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_front = (kD - 1) / 2;
+    int pad_top = (kH - 1) / 2;
+    int pad_left = (kW - 1) / 2;
+    int out_D = (D + sD - 1) / sD;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    for (int od = 0; od < out_D; od++) {
+        for (int oi = 0; oi < out_H; oi++) {
+            for (int oj = 0; oj < out_W; oj++) {
+                float sum = 0.0f;
+                for (int kd = 0; kd < kD; kd++) {
+                    for (int ki = 0; ki < kH; ki++) {
+                        for (int kj = 0; kj < kW; kj++) {
+                            int d = od * sD + kd - pad_front;
+                            int i = oi * sH + ki - pad_top;
+                            int j = oj * sW + kj - pad_left;
+                            if (d >= 0 && d < D && i >= 0 && i < H && j >= 0 && j < W) {
+                                sum += f[((size_t)d * H + i) * W + j] * g[((size_t)kd * kH + ki) * kW + kj];
+                            }
+                        }
+                    }
+                }
+                output[((size_t)od * out_H + oi) * out_W + oj] = ep ? conv2d_epilogue_value(ep, sum) : sum;
+            }
+        }
+    }
+}
+
+/**
+ * Output slices [od0, od1) x rows [oi0, oi1) of one tile
+ *
+ * slab holds input slices [slab0, ...); out holds output slices
+ * [out0, ...). sk has one tap list per kernel slice.
+ */
+static void volume_tile(const float *slab, int slab0, int D, int H, int W, const SparseKernel *sk, int kD,
+                        int sD, int sH, int sW, float *out, int out0, int od0, int od1, int oi0, int oi1) {
+    const Conv2dEpilogue *ep = conv2d_get_epilogue();
+    int pad_front = (kD - 1) / 2;
+    int pad_top = (sk[0].kH - 1) / 2;
+    int pad_left = (sk[0].kW - 1) / 2;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    for (int j0 = 0; j0 < out_W; j0 += CONV3D_TILE_W) {
+        int j1 = j0 + CONV3D_TILE_W < out_W ? j0 + CONV3D_TILE_W : out_W;
+        for (int od = od0; od < od1; od++) {
+            for (int oi = oi0; oi < oi1; oi++) {
+                float *dst = out + ((size_t)(od - out0) * out_H + oi) * out_W;
+                for (int j = j0; j < j1; j++) dst[j] = 0.0f;
+
+                for (int kd = 0; kd < kD; kd++) {
+                    int d = od * sD + kd - pad_front;
+                    if (d < 0 || d >= D) continue;
+                    const float *plane = slab + (size_t)(d - slab0) * H * W;
+
+                    for (int r = 0; r < sk[kd].num_rows; r++) {
+                        int i = oi * sH + sk[kd].row_dy[r] - pad_top;
+                        if (i < 0 || i >= H) continue;
+                        const float *src = plane + (size_t)i * W;
+
+                        for (int t = sk[kd].row_first[r]; t < sk[kd].row_first[r + 1]; t++) {
+                            int dx = sk[kd].tap_dx[t] - pad_left;
+                            float w = sk[kd].tap_w[t];
+
+                            // Output columns whose input j * sW + dx is inside the row
+                            int lo = dx < 0 ? (-dx + sW - 1) / sW : 0;
+                            int hi = W - 1 - dx >= 0 ? (W - 1 - dx) / sW + 1 : 0;
+                            if (lo < j0) lo = j0;
+                            if (hi > j1) hi = j1;
+
+                            const float *s = src + dx;
+                            if (sW == 1) {
+                                #pragma omp simd
+                                for (int j = lo; j < hi; j++) {
+                                    dst[j] += w * s[j];
+                                }
+                            } else {
+                                #pragma omp simd
+                                for (int j = lo; j < hi; j++) {
+                                    dst[j] += w * s[j * sW];
+                                }
+                            }
+                        }
+                    }
+                }
+                if (ep) conv2d_epilogue_row(ep, dst + j0, j1 - j0);
+            }
+        }
+    }
+}
+
+/**
+ * Slices [*o0, *o0 + count) shared by [a0, a1) and [b0, b1); returns count
+ */
+static int volume_overlap(int a0, int a1, int b0, int b1, int *o0) {
+    *o0 = a0 > b0 ? a0 : b0;
+    int o1 = a1 < b1 ? a1 : b1;
+    return o1 > *o0 ? o1 - *o0 : 0;
+}
+
+/**
+ * Hybrid MPI+OpenMP 3D convolution with stride and "same" padding, with
+ * performance statistics
+ *
+ * f (D x H x W) is needed on rank 0 only; g (kD x kH x kW) on every rank.
+ * output (ceil(D/sD) x ceil(H/sH) x ceil(W/sW)) is filled on rank 0 only;
+ * other ranks may pass NULL for f and output. Pass MPI_COMM_SELF for the
+ * OpenMP-only engine.
+ */
+void conv3d_stride_stats(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW,
+                         int sD, int sH, int sW, float *output, MPI_Comm comm, PerfStats *stats) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    conv2d_stats_begin(stats);
+
+    double t_start, t_comp_start, t_comm_start;
+    t_start = MPI_Wtime();
+
+    int pad_front = (kD - 1) / 2;
+    int out_D = (D + sD - 1) / sD;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    size_t in_plane = (size_t)H * W;
+    size_t out_plane = (size_t)out_H * out_W;
+    stats->output_elements = (long long)out_D * out_plane;
+
+    // Output slabs by modelled cost: one output slice as one row of valid depth taps
+    int *slab_starts = conv2d_create_row_partition(D, 1, kD, 1, sD, 1, size, comm);
+    int *own = (int*)malloc((size + 1) * sizeof(int));
+    int *need0 = (int*)malloc(size * sizeof(int));
+    int *need1 = (int*)malloc(size * sizeof(int));
+    int *counts = (int*)malloc(size * sizeof(int));
+    int *displs = (int*)malloc(size * sizeof(int));
+    SparseKernel *sk = (SparseKernel*)calloc(kD, sizeof(SparseKernel));
+    float **g_rows = (float**)malloc((size_t)kD * kH * sizeof(float*));
+    if (!own || !need0 || !need1 || !counts || !displs || !sk || !g_rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for 3D convolution\n");
+        MPI_Abort(comm, 1);
+    }
+    conv2d_record_partition_stats(D, 1, kD, 1, sD, 1, size, slab_starts, stats);
+
+    // Rank p owns input slices [own[p], own[p + 1]) and reads [need0[p], need1[p])
+    for (int p = 0; p < size; p++) {
+        int a = slab_starts[p], b = slab_starts[p + 1];
+        own[p] = p == 0 ? 0 : (a * sD < D ? a * sD : D);
+        need0[p] = need1[p] = own[p];
+        if (b > a) {
+            need0[p] = a * sD - pad_front > 0 ? a * sD - pad_front : 0;
+            need1[p] = (b - 1) * sD - pad_front + kD < D ? (b - 1) * sD - pad_front + kD : D;
+        }
+    }
+    own[size] = D;
+
+    // Local slab: the needed slices plus any owned slices past them
+    int slab0 = need0[rank];
+    int slab1 = need1[rank] > own[rank + 1] ? need1[rank] : own[rank + 1];
+    int local_start = slab_starts[rank];
+    int local_end = slab_starts[rank + 1];
+    float *slab = NULL;
+    float *local_out = NULL;
+    if (size == 1) {
+        slab = (float*)f;
+        local_out = output;
+    } else {
+        if (slab1 > slab0) {
+            slab = (float*)malloc((size_t)(slab1 - slab0) * in_plane * sizeof(float));
+        }
+        if (rank == 0) {
+            local_out = output + (size_t)local_start * out_plane;
+        } else if (local_end > local_start) {
+            local_out = (float*)malloc((size_t)(local_end - local_start) * out_plane * sizeof(float));
+        }
+        if ((slab1 > slab0 && !slab) || (local_end > local_start && !local_out)) {
+            fprintf(stderr, "Error: Failed to allocate memory for 3D slab\n");
+            MPI_Abort(comm, 1);
+        }
+    }
+
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        MPI_Datatype in_slice;
+        MPI_Type_contiguous((int)in_plane, MPI_FLOAT, &in_slice);
+        MPI_Type_commit(&in_slice);
+
+        // Owned slices straight from rank 0
+        for (int p = 0; p < size; p++) {
+            counts[p] = own[p + 1] - own[p];
+            displs[p] = own[p];
+        }
+        MPI_Scatterv(f, counts, displs, in_slice, slab ? slab + (size_t)(own[rank] - slab0) * in_plane : NULL,
+                     counts[rank], in_slice, 0, comm);
+        if (rank != 0) {
+            stats->num_communications++;
+            stats->bytes_communicated += (long long)counts[rank] * in_plane * sizeof(float);
+        }
+
+        // Halo exchange; a halo deeper than a neighbour's slab takes more rounds
+        int rounds = 0;
+        for (int p = 0; p < size; p++) {
+            for (int q = 0; q < size; q++) {
+                int o0;
+                int front = volume_overlap(own[q], own[q + 1], need0[p], own[p], &o0);
+                int back = volume_overlap(own[q], own[q + 1], own[p + 1], need1[p], &o0);
+                if ((front || back) && abs(p - q) > rounds) rounds = abs(p - q);
+            }
+        }
+        for (int r = 1; r <= rounds; r++) {
+            int up = rank + r < size ? rank + r : MPI_PROC_NULL;
+            int down = rank - r >= 0 ? rank - r : MPI_PROC_NULL;
+            int s0 = 0, send = 0, r0 = 0, recv = 0;
+
+            // Front halos travel up, back halos travel down
+            if (up != MPI_PROC_NULL) send = volume_overlap(own[rank], own[rank + 1], need0[up], own[up], &s0);
+            if (down != MPI_PROC_NULL) recv = volume_overlap(own[down], own[down + 1], need0[rank], own[rank], &r0);
+            MPI_Sendrecv(send ? slab + (size_t)(s0 - slab0) * in_plane : NULL, send, in_slice, up, 0,
+                         recv ? slab + (size_t)(r0 - slab0) * in_plane : NULL, recv, in_slice, down, 0,
+                         comm, MPI_STATUS_IGNORE);
+            stats->num_communications += (send > 0) + (recv > 0);
+            stats->bytes_communicated += (long long)(send + recv) * in_plane * sizeof(float);
+
+            send = recv = 0;
+            if (down != MPI_PROC_NULL) send = volume_overlap(own[rank], own[rank + 1], own[down + 1], need1[down], &s0);
+            if (up != MPI_PROC_NULL) recv = volume_overlap(own[up], own[up + 1], own[rank + 1], need1[rank], &r0);
+            MPI_Sendrecv(send ? slab + (size_t)(s0 - slab0) * in_plane : NULL, send, in_slice, down, 1,
+                         recv ? slab + (size_t)(r0 - slab0) * in_plane : NULL, recv, in_slice, up, 1,
+                         comm, MPI_STATUS_IGNORE);
+            stats->num_communications += (send > 0) + (recv > 0);
+            stats->bytes_communicated += (long long)(send + recv) * in_plane * sizeof(float);
+        }
+        MPI_Type_free(&in_slice);
+        stats->communication_time = MPI_Wtime() - t_comm_start;
+    }
+
+    // One tap list per kernel slice
+    for (int kd = 0; kd < kD; kd++) {
+        for (int ki = 0; ki < kH; ki++) {
+            g_rows[kd * kH + ki] = (float*)g + ((size_t)kd * kH + ki) * kW;
+        }
+        if (conv2d_sparse_compile(g_rows + kd * kH, kH, kW, &sk[kd]) != 0) {
+            fprintf(stderr, "Error: Failed to allocate memory for 3D convolution\n");
+            MPI_Abort(comm, 1);
+        }
+    }
+
+    t_comp_start = MPI_Wtime();
+    int tiles_d = (local_end - local_start + CONV3D_TILE_D - 1) / CONV3D_TILE_D;
+    int tiles_h = (out_H + CONV3D_TILE_H - 1) / CONV3D_TILE_H;
+    TuneParams tune;
+    conv2d_get_tune_params(&tune);
+    omp_set_schedule(tune.schedule, tune.chunk_size);
+    #pragma omp parallel for schedule(runtime) collapse(2)
+    for (int td = 0; td < tiles_d; td++) {
+        for (int th = 0; th < tiles_h; th++) {
+            int od0 = local_start + td * CONV3D_TILE_D;
+            int od1 = od0 + CONV3D_TILE_D < local_end ? od0 + CONV3D_TILE_D : local_end;
+            int oi0 = th * CONV3D_TILE_H;
+            int oi1 = oi0 + CONV3D_TILE_H < out_H ? oi0 + CONV3D_TILE_H : out_H;
+            volume_tile(slab, slab0, D, H, W, sk, kD, sD, sH, sW, local_out, local_start, od0, od1, oi0, oi1);
+        }
+    }
+    stats->computation_time = MPI_Wtime() - t_comp_start;
+
+    // Output slabs back to rank 0
+    if (size > 1) {
+        t_comm_start = MPI_Wtime();
+        MPI_Datatype out_slice;
+        MPI_Type_contiguous((int)out_plane, MPI_FLOAT, &out_slice);
+        MPI_Type_commit(&out_slice);
+        for (int p = 0; p < size; p++) {
+            counts[p] = slab_starts[p + 1] - slab_starts[p];
+            displs[p] = slab_starts[p];
+        }
+        if (rank == 0) {
+            MPI_Gatherv(MPI_IN_PLACE, counts[0], out_slice, output, counts, displs, out_slice, 0, comm);
+        } else {
+            MPI_Gatherv(local_out, counts[rank], out_slice, NULL, NULL, NULL, out_slice, 0, comm);
+            stats->num_communications++;
+            stats->bytes_communicated += (long long)counts[rank] * out_plane * sizeof(float);
+        }
+        MPI_Type_free(&out_slice);
+        stats->broadcast_time = MPI_Wtime() - t_comm_start;
+        stats->communication_time += stats->broadcast_time;
+
+        free(slab);
+        if (rank != 0) free(local_out);
+    }
+
+    for (int kd = 0; kd < kD; kd++) conv2d_sparse_free(&sk[kd]);
+    free(sk);
+    free(g_rows);
+    free(slab_starts);
+    free(own);
+    free(need0);
+    free(need1);
+    free(counts);
+    free(displs);
+    conv2d_arena_stats_end(conv2d_thread_arena(), stats);
+    stats->total_time = MPI_Wtime() - t_start;
+}
+
+/**
+ * Hybrid MPI+OpenMP 3D convolution (see conv3d_stride_stats)
+ */
+void conv3d_stride(const float *f, int D, int H, int W, const float *g, int kD, int kH, int kW,
+                   int sD, int sH, int sW, float *output, MPI_Comm comm) {
+    PerfStats stats;
+    conv3d_stride_stats(f, D, H, W, g, kD, kH, kW, sD, sH, sW, output, comm, &stats);
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Client and load generator for the convolution service (conv_service)
+ *
+ * Single request:  conv_client -f f.txt -g g.txt [-o out.txt] [-sH N] [-sW N] [-m MODE] [--dtype T]
+ * Control:         conv_client --ping | --stats | --shutdown
+ * Load generator:  conv_client -f f.txt -g g.txt --bench N [--concurrency C]
+ *                  sends N requests from C concurrent connections and
+ *                  reports throughput and p50/p90/p99 round-trip latency
+ */
+
+typedef struct {
+    const char *socket_path;
+    const char *request;
+    int count;
+    double *latencies;
+    int failures;
+} BenchWorker;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Send one request line and read the one-line reply. Returns 0 on "OK".
+ */
+static int send_request(const char *socket_path, const char *request, char *reply, size_t reply_len) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        snprintf(reply, reply_len, "ERR cannot connect to %s", socket_path);
+        close(fd);
+        return -1;
+    }
+
+    size_t len = strlen(request);
+    const char *p = request;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w <= 0) break;
+        p += w;
+        len -= (size_t)w;
+    }
+
+    size_t n = 0;
+    while (n + 1 < reply_len) {
+        char c;
+        if (read(fd, &c, 1) <= 0 || c == '\n') break;
+        reply[n++] = c;
+    }
+    reply[n] = '\0';
+    close(fd);
+    return strncmp(reply, "OK", 2) == 0 ? 0 : -1;
+}
+
+static void* bench_worker_main(void *arg) {
+    BenchWorker *worker = (BenchWorker*)arg;
+    char reply[1024];
+    for (int n = 0; n < worker->count; n++) {
+        double t0 = now_seconds();
+        if (send_request(worker->socket_path, worker->request, reply, sizeof(reply)) != 0) {
+            worker->failures++;
+            worker->latencies[n] = -1.0;
+            continue;
+        }
+        worker->latencies[n] = now_seconds() - t0;
+    }
+    return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double pct) {
+    if (n == 0) return 0.0;
+    int idx = (int)(pct / 100.0 * n + 0.5) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return sorted[idx];
+}
+
+static void usage(const char *program_name) {
+    printf("Usage: %s [OPTIONS]\n", program_name);
+    printf("Client for the persistent convolution service\n\n");
+    printf("Options:\n");
+    printf("  -s SOCKET   Service socket (default: /tmp/conv2d.sock)\n");
+    printf("  -f INPUT    Input file or shm:/NAME segment\n");
+    printf("  -g FILE     Kernel file\n");
+    printf("  -o OUTPUT   Output file or shm:/NAME segment (optional)\n");
+    printf("  -sH STRIDE  Vertical stride (default: 1)\n");
+    printf("  -sW STRIDE  Horizontal stride (default: 1)\n");
+    printf("  -m MODE     Service mode: hybrid, omp, dynamic (default: hybrid)\n");
+    printf("  --dtype T   Storage type: f32, f16 or bf16 (default: f32)\n");
+    printf("  --bench N   Load generator: send N requests and report latency percentiles\n");
+    printf("  --concurrency C    Concurrent connections for --bench (default: 1)\n");
+    printf("  --ping | --stats | --shutdown   Service control requests\n");
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = "/tmp/conv2d.sock";
+    const char *input = NULL, *kernel = NULL, *output = NULL, *mode = "hybrid";
+    const char *control = NULL, *dtype = "f32";
+    int sH = 1, sW = 1, bench = 0, concurrency = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            kernel = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-sH") == 0 && i + 1 < argc) {
+            sH = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-sW") == 0 && i + 1 < argc) {
+            sW = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--dtype") == 0 && i + 1 < argc) {
+            dtype = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) {
+            concurrency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ping") == 0) {
+            control = "PING\n";
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            control = "STATS\n";
+        } else if (strcmp(argv[i], "--shutdown") == 0) {
+            control = "SHUTDOWN\n";
+        } else if (strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    char reply[1024];
+    if (control) {
+        int status = send_request(socket_path, control, reply, sizeof(reply));
+        printf("%s\n", reply);
+        return status == 0 ? 0 : 1;
+    }
+
+    if (!input || !kernel) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char request[9000];
+    snprintf(request, sizeof(request), "CONV input=%s kernel=%s sH=%d sW=%d mode=%s dtype=%s%s%s\n",
+             input, kernel, sH, sW, mode, dtype, output ? " output=" : "", output ? output : "");
+
+    if (bench <= 0) {
+        double t0 = now_seconds();
+        int status = send_request(socket_path, request, reply, sizeof(reply));
+        printf("%s\n", reply);
+        printf("Round trip: %.3f ms\n", 1000.0 * (now_seconds() - t0));
+        return status == 0 ? 0 : 1;
+    }
+
+    // Load generator: spread bench requests over concurrent connections
+    if (concurrency < 1) concurrency = 1;
+    if (concurrency > bench) concurrency = bench;
+    BenchWorker *workers = (BenchWorker*)calloc(concurrency, sizeof(BenchWorker));
+    pthread_t *threads = (pthread_t*)malloc(concurrency * sizeof(pthread_t));
+    double *latencies = (double*)malloc(bench * sizeof(double));
+
+    int offset = 0;
+    for (int w = 0; w < concurrency; w++) {
+        workers[w].socket_path = socket_path;
+        workers[w].request = request;
+        workers[w].count = bench / concurrency + (w < bench % concurrency ? 1 : 0);
+        workers[w].latencies = latencies + offset;
+        offset += workers[w].count;
+    }
+
+    double t_start = now_seconds();
+    for (int w = 0; w < concurrency; w++) {
+        pthread_create(&threads[w], NULL, bench_worker_main, &workers[w]);
+    }
+    int failures = 0;
+    for (int w = 0; w < concurrency; w++) {
+        pthread_join(threads[w], NULL);
+        failures += workers[w].failures;
+    }
+    double elapsed = now_seconds() - t_start;
+
+    int ok = 0;
+    for (int n = 0; n < bench; n++) {
+        if (latencies[n] >= 0.0) latencies[ok++] = latencies[n];
+    }
+    qsort(latencies, ok, sizeof(double), compare_doubles);
+
+    printf("========================================\n");
+    printf("Service Load Test\n");
+    printf("========================================\n");
+    printf("Requests:            %d (%d failed), concurrency %d\n", bench, failures, concurrency);
+    printf("Total time:          %.6f seconds\n", elapsed);
+    printf("Throughput:          %.2f requests/s\n", elapsed > 0 ? ok / elapsed : 0.0);
+    printf("Latency p50:         %.3f ms\n", 1000.0 * percentile(latencies, ok, 50.0));
+    printf("Latency p90:         %.3f ms\n", 1000.0 * percentile(latencies, ok, 90.0));
+    printf("Latency p99:         %.3f ms\n", 1000.0 * percentile(latencies, ok, 99.0));
+    printf("Latency max:         %.3f ms\n", ok > 0 ? 1000.0 * latencies[ok - 1] : 0.0);
+    printf("========================================\n");
+
+    free(latencies);
+    free(threads);
+    free(workers);
+    return failures == 0 ? 0 : 1;
+}
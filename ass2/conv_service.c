@@ -0,0 +1,634 @@
+#include "conv2d.h"
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
+ *
+ * Persistent convolution service
+ *
+ * A long-running MPI job that accepts convolution requests over a Unix-domain
+ * socket, so MPI start-up, allocation and kernel loading are paid once per
+ * job instead of once per request.
+ *
+ * Rank 0 runs a listener thread that accepts connections and queues one
+ * request line per connection; the main thread drains the queue, loads the
+ * input, and drives all ranks through the normal engines. Kernels stay
+ * cached on every rank and input/output buffers only grow.
+ *
+ * Request (one line):
+ *   CONV input=PATH|shm:/NAME kernel=PATH [output=PATH|shm:/NAME] [sH=N] [sW=N] [mode=MODE]
+ *        [dtype=f32|f16|bf16]
+ *   PING | STATS | SHUTDOWN
+ * Response (one line):
+ *   OK id=N out_H=N out_W=N queue_ms=X load_ms=X compute_ms=X write_ms=X total_ms=X
+ *   ERR message
+ *
+ * Shared-memory segments (POSIX shm) hold two ints (rows, cols) followed by
+ * rows * cols floats. With dtype=f16 or bf16 the input is converted once on
+ * rank 0 and broadcast, computed and gathered as 16-bit values (fp32
+ * accumulation); the stored result is widened back to float.
+ */
+
+#define SERVICE_MAX_LINE     8192
+#define SERVICE_KERNEL_CACHE 16
+
+// Commands broadcast from rank 0 to the worker ranks
+#define CMD_CONV     1
+#define CMD_SHUTDOWN 2
+
+/*
+ * Queued request: the client connection and its request line
+ */
+typedef struct ServiceRequest {
+    int fd;
+    char line[SERVICE_MAX_LINE];
+    double arrival;
+    struct ServiceRequest *next;
+} ServiceRequest;
+
+/*
+ * FIFO of requests filled by the listener thread
+ */
+typedef struct {
+    ServiceRequest *head;
+    ServiceRequest *tail;
+    int length;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} RequestQueue;
+
+/*
+ * Kernel cached on every rank; rank 0 also remembers where it came from
+ */
+typedef struct {
+    int id;
+    char path[4096];
+    time_t mtime;
+    float **g;
+    int kH, kW;
+    long long last_used;
+} CachedKernel;
+
+static RequestQueue queue = { NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+static int listen_fd = -1;
+
+/**
+ * Seconds since an arbitrary start, comparable across threads
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void queue_push(ServiceRequest *req) {
+    pthread_mutex_lock(&queue.lock);
+    req->next = NULL;
+    if (queue.tail) {
+        queue.tail->next = req;
+    } else {
+        queue.head = req;
+    }
+    queue.tail = req;
+    queue.length++;
+    pthread_cond_signal(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+static ServiceRequest* queue_pop(void) {
+    pthread_mutex_lock(&queue.lock);
+    while (!queue.head && !queue.closed) {
+        pthread_cond_wait(&queue.ready, &queue.lock);
+    }
+    ServiceRequest *req = queue.head;
+    if (req) {
+        queue.head = req->next;
+        if (!queue.head) queue.tail = NULL;
+        queue.length--;
+    }
+    pthread_mutex_unlock(&queue.lock);
+    return req;
+}
+
+/**
+ * Read one newline-terminated line from a socket
+ */
+static int read_line(int fd, char *line, size_t len) {
+    size_t n = 0;
+    while (n + 1 < len) {
+        char c;
+        ssize_t r = read(fd, &c, 1);
+        if (r <= 0) break;
+        if (c == '\n') break;
+        line[n++] = c;
+    }
+    line[n] = '\0';
+    return n > 0 ? 0 : -1;
+}
+
+static void write_all(int fd, const char *text) {
+    size_t len = strlen(text);
+    while (len > 0) {
+        ssize_t w = write(fd, text, len);
+        if (w <= 0) return;
+        text += w;
+        len -= (size_t)w;
+    }
+}
+
+/**
+ * Listener thread: accept connections and queue their request lines
+ */
+static void* listener_main(void *arg) {
+    (void)arg;
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) break;
+
+        ServiceRequest *req = (ServiceRequest*)malloc(sizeof(ServiceRequest));
+        if (!req || read_line(fd, req->line, sizeof(req->line)) != 0) {
+            free(req);
+            close(fd);
+            continue;
+        }
+        req->fd = fd;
+        req->arrival = now_seconds();
+        queue_push(req);
+    }
+    return NULL;
+}
+
+/**
+ * Find "key=value" in a request line; returns 0 and copies the value on success
+ */
+static int request_field(const char *line, const char *key, char *value, size_t len) {
+    size_t key_len = strlen(key);
+    const char *p = line;
+    while ((p = strstr(p, key)) != NULL) {
+        if ((p == line || p[-1] == ' ') && p[key_len] == '=') {
+            p += key_len + 1;
+            size_t n = strcspn(p, " ");
+            if (n >= len) n = len - 1;
+            memcpy(value, p, n);
+            value[n] = '\0';
+            return 0;
+        }
+        p += key_len;
+    }
+    return -1;
+}
+
+/**
+ * Grow-only 2D buffer kept warm across requests
+ */
+static int reserve_buffer(float ***buf, int *buf_rows, int *buf_cols, int rows, int cols) {
+    if (*buf && rows <= *buf_rows && cols <= *buf_cols) return 0;
+    int new_rows = rows > *buf_rows ? rows : *buf_rows;
+    int new_cols = cols > *buf_cols ? cols : *buf_cols;
+    free_2d_array(*buf, *buf_rows);
+    *buf = allocate_2d_array(new_rows, new_cols);
+    if (!*buf) {
+        *buf_rows = *buf_cols = 0;
+        return -1;
+    }
+    *buf_rows = new_rows;
+    *buf_cols = new_cols;
+    return 0;
+}
+
+/**
+ * Read a request input from a text file or a shm:/NAME segment into the buffer
+ */
+static int load_input(const char *source, float ***buf, int *buf_rows, int *buf_cols, int *H, int *W) {
+    if (strncmp(source, "shm:", 4) == 0) {
+        int fd = shm_open(source + 4, O_RDONLY, 0);
+        if (fd < 0) return -1;
+        int header[2];
+        if (read(fd, header, sizeof(header)) != (ssize_t)sizeof(header) || header[0] <= 0 || header[1] <= 0) {
+            close(fd);
+            return -1;
+        }
+        size_t bytes = sizeof(header) + (size_t)header[0] * header[1] * sizeof(float);
+        void *map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return -1;
+
+        *H = header[0];
+        *W = header[1];
+        int status = reserve_buffer(buf, buf_rows, buf_cols, *H, *W);
+        const float *data = (const float*)((const char*)map + sizeof(header));
+        for (int i = 0; i < *H && status == 0; i++) {
+            memcpy((*buf)[i], data + (size_t)i * *W, *W * sizeof(float));
+        }
+        munmap(map, bytes);
+        return status;
+    }
+
+    float **array;
+    if (read_array_from_file(source, &array, H, W) != 0) return -1;
+    int status = reserve_buffer(buf, buf_rows, buf_cols, *H, *W);
+    for (int i = 0; i < *H && status == 0; i++) {
+        memcpy((*buf)[i], array[i], *W * sizeof(float));
+    }
+    free_2d_array(array, *H);
+    return status;
+}
+
+/**
+ * Write a result to a text file or a shm:/NAME segment
+ */
+static int store_output(const char *target, float **output, int rows, int cols) {
+    if (strncmp(target, "shm:", 4) == 0) {
+        int fd = shm_open(target + 4, O_RDWR | O_CREAT, 0600);
+        if (fd < 0) return -1;
+        size_t bytes = 2 * sizeof(int) + (size_t)rows * cols * sizeof(float);
+        if (ftruncate(fd, (off_t)bytes) != 0) {
+            close(fd);
+            return -1;
+        }
+        void *map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return -1;
+
+        int *header = (int*)map;
+        header[0] = rows;
+        header[1] = cols;
+        float *data = (float*)(header + 2);
+        for (int i = 0; i < rows; i++) {
+            memcpy(data + (size_t)i * cols, output[i], cols * sizeof(float));
+        }
+        munmap(map, bytes);
+        return 0;
+    }
+    return write_array_to_file(target, output, rows, cols);
+}
+
+/**
+ * Look up a kernel on rank 0. Returns its cache slot on a hit. On a miss the
+ * kernel is read into *g (not cached yet, see install_kernel) and -1 is
+ * returned; -2 if it cannot be read.
+ */
+static int lookup_kernel(CachedKernel *cache, const char *path, long long tick,
+                         float ***g, int *kH, int *kW, time_t *mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -2;
+
+    for (int k = 0; k < SERVICE_KERNEL_CACHE; k++) {
+        if (cache[k].g && strcmp(cache[k].path, path) == 0 && cache[k].mtime == st.st_mtime) {
+            cache[k].last_used = tick;
+            return k;
+        }
+    }
+
+    if (read_array_from_file(path, g, kH, kW) != 0) return -2;
+    *mtime = st.st_mtime;
+    return -1;
+}
+
+/**
+ * Cache a kernel read by lookup_kernel on rank 0, once its request is known
+ * to be valid, evicting the least recently used entry. Returns the slot.
+ */
+static int install_kernel(CachedKernel *cache, const char *path, time_t mtime, float **g, int kH, int kW,
+                          int *next_id, long long tick) {
+    int victim = 0;
+    for (int k = 0; k < SERVICE_KERNEL_CACHE; k++) {
+        if (!cache[k].g || (cache[victim].g && cache[k].last_used < cache[victim].last_used)) {
+            victim = k;
+        }
+    }
+
+    free_2d_array(cache[victim].g, cache[victim].kH);
+    cache[victim].id = (*next_id)++;
+    snprintf(cache[victim].path, sizeof(cache[victim].path), "%s", path);
+    cache[victim].mtime = mtime;
+    cache[victim].g = g;
+    cache[victim].kH = kH;
+    cache[victim].kW = kW;
+    cache[victim].last_used = tick;
+    return victim;
+}
+
+/**
+ * Make room on a worker rank for kernel id in the slot rank 0 chose
+ */
+static void store_kernel(CachedKernel *cache, int slot, int id, int kH, int kW) {
+    free_2d_array(cache[slot].g, cache[slot].kH);
+    cache[slot].id = id;
+    cache[slot].path[0] = '\0';
+    cache[slot].g = allocate_2d_array(kH, kW);
+    cache[slot].kH = kH;
+    cache[slot].kW = kW;
+    if (!cache[slot].g) {
+        fprintf(stderr, "Error: Failed to allocate memory for cached kernel\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+static void usage(const char *program_name) {
+    printf("Usage: %s [-s SOCKET] [-t THREADS]\n", program_name);
+    printf("Persistent convolution service over a Unix-domain socket\n\n");
+    printf("  -s SOCKET   Socket path (default: /tmp/conv2d.sock)\n");
+    printf("  -t THREADS  OpenMP threads per MPI process\n");
+    printf("  --help      Show this help message\n\n");
+    printf("Example:\n");
+    printf("  srun -n 4 %s -s /tmp/conv2d.sock &\n", program_name);
+    printf("  ./conv_client -s /tmp/conv2d.sock -f f.txt -g g.txt -o out.txt\n");
+}
+
+int main(int argc, char **argv) {
+    // Rank 0 runs a listener thread next to the MPI thread
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) fprintf(stderr, "Error: MPI provides thread level %d, the service needs MPI_THREAD_FUNNELED\n", provided);
+        MPI_Finalize();
+        return 1;
+    }
+
+    const char *socket_path = "/tmp/conv2d.sock";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            omp_set_num_threads(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--help") == 0) {
+            if (rank == 0) usage(argv[0]);
+            MPI_Finalize();
+            return 0;
+        }
+    }
+
+    // Rank 0 owns the socket and the listener thread
+    pthread_t listener;
+    int ok = 1;
+    if (rank == 0) {
+        signal(SIGPIPE, SIG_IGN);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+        unlink(socket_path);
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            listen(listen_fd, 128) != 0) {
+            fprintf(stderr, "Error: Cannot listen on %s\n", socket_path);
+            ok = 0;
+        } else {
+            pthread_create(&listener, NULL, listener_main, NULL);
+            printf("Convolution service listening on %s (MPI processes=%d, OpenMP threads=%d)\n",
+                   socket_path, size, omp_get_max_threads());
+            fflush(stdout);
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    CachedKernel cache[SERVICE_KERNEL_CACHE];
+    memset(cache, 0, sizeof(cache));
+    int next_kernel_id = 1;
+    long long tick = 0;
+
+    float **f = NULL, **output = NULL;
+    int f_rows = 0, f_cols = 0, out_rows = 0, out_cols = 0;
+    uint16_t *f_half = NULL, *output_half = NULL;
+    size_t f_half_len = 0, output_half_len = 0;
+
+    long long served = 0, failed = 0;
+    double busy_time = 0.0;
+
+    while (1) {
+        // Header: command, H, W, kernel id, kernel slot, kH, kW, sH, sW, mode, dtype
+        int cmd[11] = {0};
+        ServiceRequest *req = NULL;
+        char error[256] = "";
+        char output_target[4096] = "";
+        double t_dequeue = 0.0, t_loaded = 0.0;
+        int slot = -1;
+        tick++;
+
+        if (rank == 0) {
+            while (!req) {
+                req = queue_pop();
+                if (!req) break;
+                t_dequeue = now_seconds();
+
+                if (strncmp(req->line, "PING", 4) == 0) {
+                    write_all(req->fd, "OK pong\n");
+                } else if (strncmp(req->line, "STATS", 5) == 0) {
+                    char reply[256];
+                    pthread_mutex_lock(&queue.lock);
+                    int queued = queue.length;
+                    pthread_mutex_unlock(&queue.lock);
+                    snprintf(reply, sizeof(reply), "OK served=%lld failed=%lld queued=%d busy_s=%.3f\n",
+                             served, failed, queued, busy_time);
+                    write_all(req->fd, reply);
+                } else if (strncmp(req->line, "SHUTDOWN", 8) == 0) {
+                    write_all(req->fd, "OK shutting down\n");
+                    cmd[0] = CMD_SHUTDOWN;
+                    close(req->fd);
+                    free(req);
+                    req = NULL;
+                    break;
+                } else if (strncmp(req->line, "CONV", 4) == 0) {
+                    char input[4096], kernel[4096], value[64];
+                    int sH = 1, sW = 1, mode = 0, dtype = CONV2D_DTYPE_F32;
+                    if (request_field(req->line, "sH", value, sizeof(value)) == 0) sH = atoi(value);
+                    if (request_field(req->line, "sW", value, sizeof(value)) == 0) sW = atoi(value);
+                    if (request_field(req->line, "mode", value, sizeof(value)) == 0) {
+                        mode = strcmp(value, "omp") == 0 ? 1 : strcmp(value, "dynamic") == 0 ? 2 : 0;
+                    }
+                    if (request_field(req->line, "dtype", value, sizeof(value)) == 0) {
+                        dtype = conv2d_dtype_from_name(value);
+                    }
+                    request_field(req->line, "output", output_target, sizeof(output_target));
+
+                    int H, W, kH = 0, kW = 0;
+                    float **g = NULL;
+                    time_t mtime = 0;
+                    if (request_field(req->line, "input", input, sizeof(input)) != 0 ||
+                        request_field(req->line, "kernel", kernel, sizeof(kernel)) != 0) {
+                        snprintf(error, sizeof(error), "missing input= or kernel=");
+                    } else if (dtype < 0) {
+                        snprintf(error, sizeof(error), "unknown dtype");
+                    } else if (sH <= 0 || sW <= 0) {
+                        snprintf(error, sizeof(error), "invalid stride %dx%d", sH, sW);
+                    } else if ((slot = lookup_kernel(cache, kernel, tick, &g, &kH, &kW, &mtime)) == -2) {
+                        snprintf(error, sizeof(error), "cannot read kernel %.200s", kernel);
+                    } else if (load_input(input, &f, &f_rows, &f_cols, &H, &W) != 0) {
+                        snprintf(error, sizeof(error), "cannot read input %.200s", input);
+                        free_2d_array(g, kH);
+                    } else {
+                        // Only a valid request may change the kernel cache
+                        if (slot < 0) {
+                            slot = install_kernel(cache, kernel, mtime, g, kH, kW, &next_kernel_id, tick);
+                        }
+                        cmd[0] = CMD_CONV;
+                        cmd[1] = H;
+                        cmd[2] = W;
+                        cmd[3] = cache[slot].id;
+                        cmd[4] = slot;
+                        cmd[5] = cache[slot].kH;
+                        cmd[6] = cache[slot].kW;
+                        cmd[7] = sH;
+                        cmd[8] = sW;
+                        cmd[9] = mode;
+                        cmd[10] = dtype;
+                        t_loaded = now_seconds();
+                        break;
+                    }
+                } else {
+                    snprintf(error, sizeof(error), "unknown request");
+                }
+
+                if (error[0]) {
+                    char reply[512];
+                    snprintf(reply, sizeof(reply), "ERR %s\n", error);
+                    write_all(req->fd, reply);
+                    failed++;
+                    error[0] = '\0';
+                }
+                close(req->fd);
+                free(req);
+                req = NULL;
+            }
+            if (!req && cmd[0] != CMD_SHUTDOWN) cmd[0] = CMD_SHUTDOWN;
+        }
+
+        MPI_Bcast(cmd, 11, MPI_INT, 0, MPI_COMM_WORLD);
+        if (cmd[0] == CMD_SHUTDOWN) break;
+
+        int H = cmd[1], W = cmd[2], kH = cmd[5], kW = cmd[6], sH = cmd[7], sW = cmd[8], mode = cmd[9];
+        int dtype = cmd[10];
+
+        // Workers hold kernels in the slots rank 0 chose; a kernel is sent
+        // whenever some worker does not have it in that slot yet
+        slot = cmd[4];
+        int missing = rank != 0 && (!cache[slot].g || cache[slot].id != cmd[3]);
+        MPI_Allreduce(MPI_IN_PLACE, &missing, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (missing) {
+            if (rank != 0) store_kernel(cache, slot, cmd[3], kH, kW);
+            for (int i = 0; i < kH; i++) {
+                MPI_Bcast(cache[slot].g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+            }
+        }
+
+        int out_H = (H + sH - 1) / sH;
+        int out_W = (W + sW - 1) / sW;
+        if (rank != 0) reserve_buffer(&f, &f_rows, &f_cols, H, W);
+        reserve_buffer(&output, &out_rows, &out_cols, out_H, out_W);
+
+        double t_compute = now_seconds();
+        if (dtype != CONV2D_DTYPE_F32) {
+            // 16-bit storage: grow-only buffers, rank 0 converts the input once
+            if ((size_t)H * W > f_half_len) {
+                free(f_half);
+                f_half_len = (size_t)H * W;
+                f_half = (uint16_t*)malloc(f_half_len * sizeof(uint16_t));
+            }
+            if ((size_t)out_H * out_W > output_half_len) {
+                free(output_half);
+                output_half_len = (size_t)out_H * out_W;
+                output_half = (uint16_t*)malloc(output_half_len * sizeof(uint16_t));
+            }
+            if (!f_half || !output_half) {
+                fprintf(stderr, "Error: Failed to allocate 16-bit buffers\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            if (rank == 0) {
+                for (int i = 0; i < H; i++) {
+                    conv2d_float_to_half(f[i], f_half + (size_t)i * W, W, dtype);
+                }
+            }
+            if (mode == 1) {
+                if (rank == 0) {
+                    conv2d_stride_half(f_half, H, W, dtype, cache[slot].g, kH, kW, sH, sW,
+                                       output_half, MPI_COMM_SELF);
+                }
+            } else {
+                for (int i = 0; i < H; i++) {
+                    MPI_Bcast(f_half + (size_t)i * W, W, MPI_UINT16_T, 0, MPI_COMM_WORLD);
+                }
+                conv2d_stride_half(f_half, H, W, dtype, cache[slot].g, kH, kW, sH, sW,
+                                   output_half, MPI_COMM_WORLD);
+            }
+            if (rank == 0) {
+                for (int i = 0; i < out_H; i++) {
+                    conv2d_half_to_float(output_half + (size_t)i * out_W, output[i], out_W, dtype);
+                }
+            }
+        } else if (mode == 1) {
+            // OpenMP on rank 0 only: no input distribution needed
+            if (rank == 0) conv2d_omp_stride(f, H, W, cache[slot].g, kH, kW, sH, sW, output);
+        } else {
+            for (int i = 0; i < H; i++) {
+                MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+            }
+            if (mode == 2) {
+                conv2d_stride_dynamic(f, H, W, cache[slot].g, kH, kW, sH, sW, output, MPI_COMM_WORLD);
+            } else {
+                conv2d_stride(f, H, W, cache[slot].g, kH, kW, sH, sW, output, MPI_COMM_WORLD);
+            }
+        }
+        double t_computed = now_seconds();
+        // Engines rewind their own scratch; reset between requests regardless
+        conv2d_arena_reset(conv2d_thread_arena());
+
+        if (rank == 0) {
+            int write_ok = output_target[0] ? store_output(output_target, output, out_H, out_W) == 0 : 1;
+            double t_done = now_seconds();
+
+            char reply[512];
+            if (write_ok) {
+                served++;
+                snprintf(reply, sizeof(reply),
+                         "OK id=%lld out_H=%d out_W=%d queue_ms=%.3f load_ms=%.3f compute_ms=%.3f write_ms=%.3f total_ms=%.3f\n",
+                         served, out_H, out_W,
+                         1000.0 * (t_dequeue - req->arrival), 1000.0 * (t_loaded - t_dequeue),
+                         1000.0 * (t_computed - t_compute), 1000.0 * (t_done - t_computed),
+                         1000.0 * (t_done - req->arrival));
+            } else {
+                failed++;
+                snprintf(reply, sizeof(reply), "ERR cannot write output %s\n", output_target);
+            }
+            busy_time += t_done - t_dequeue;
+            write_all(req->fd, reply);
+            close(req->fd);
+            free(req);
+        }
+    }
+
+    if (rank == 0) {
+        // Stop accepting; the listener exits when accept fails
+        shutdown(listen_fd, SHUT_RDWR);
+        close(listen_fd);
+        unlink(socket_path);
+        pthread_join(listener, NULL);
+        printf("Service stopped: %lld requests served, %lld failed\n", served, failed);
+    }
+
+    for (int k = 0; k < SERVICE_KERNEL_CACHE; k++) {
+        free_2d_array(cache[k].g, cache[k].kH);
+    }
+    free_2d_array(f, f_rows);
+    free_2d_array(output, out_rows);
+    free(f_half);
+    free(output_half);
+
+    conv2d_arena_release_all();
+    MPI_Finalize();
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "conv2d.h"
 #include <math.h>
+#include <limits.h>
 
 /**
  * Group Member: Jiazheng Guo(24070858), Zichen Zhang(24064091)
@@ -19,20 +20,2084 @@ void print_usage(const char *program_name) {
     printf("  -kW WIDTH   Kernel width\n");
     printf("  -sH STRIDE  Vertical stride (default: 1)\n");
     printf("  -sW STRIDE  Horizontal stride (default: 1)\n");
+    printf("  -dH DILATION  Vertical dilation (default: 1; serial, omp, mpi, hybrid)\n");
+    printf("  -dW DILATION  Horizontal dilation (default: 1; serial, omp, mpi, hybrid)\n");
     printf("  -t THREADS  Number of OpenMP threads per MPI process (optional)\n");
-    printf("  -m MODE     Mode: serial, omp, mpi, hybrid (default: hybrid)\n");
+    printf("  -m MODE     Mode: serial, omp, mpi, hybrid, dynamic, plan (default: hybrid)\n");
+    printf("  --repeat N  Run the convolution N times; statistics are for the last run (default: 1)\n");
+    printf("  --calibrate Time each rank first and split rows by measured speed\n");
+    printf("  --tune      Autotune the OpenMP schedule and block size (cached per problem class)\n");
+    printf("  --retune    As --tune, re-timing the candidates and ignoring the cache\n");
+    printf("  --no-tune   Use the built-in schedule and block size heuristics (default)\n");
+    printf("  --tune-cache FILE  Tuning cache file (default: $CONV2D_TUNE_CACHE or ~/.conv2d_tune_cache)\n");
+    printf("  --bank PATH Filter bank: multi-kernel file or directory of kernels\n");
+    printf("  --bank-size N      Filter bank of N random kH x kW kernels\n");
+    printf("  --bank-compare     Also time one conv2d_stride run per bank kernel\n");
+    printf("  -C CHANNELS Multi-channel layer with CHANNELS input channels (random data)\n");
+    printf("  -K KERNELS  Output channels of the multi-channel layer (default: -C)\n");
+    printf("  --depthwise        Depthwise multi-channel layer (one kernel per channel)\n");
+    printf("  --split channels   Split the multi-channel layer over output channels, not rows\n");
+    printf("  --batch SRC Batch mode: convolve every file of directory SRC or manifest SRC;\n");
+    printf("              -o names the output directory\n");
+    printf("  --batch-split PIXELS  Images larger than this use the row split (default: 2048*2048)\n");
+    printf("  --quant TYPE  Quantized engine with u8 or i8 input, timed against the float engine\n");
+    printf("  --qweights BITS    Quantized kernel weights: 8 or 16 bits (default: 8)\n");
+    printf("  --qout TYPE Quantized output: float, u8 or i8 (requantized) (default: float)\n");
+    printf("  --sparse-threshold D  Kernels with at most this fraction of nonzero taps use the\n");
+    printf("              tap-list engine in omp and hybrid modes; 0 disables it (default: %.2f)\n",
+           SPARSE_DENSITY_THRESHOLD);
+    printf("  --box-blocks N  Kernels of at most N constant rectangles (box filters) use the\n");
+    printf("              summed-area table engine in omp and hybrid modes; 0 disables it\n");
+    printf("              (default: %d)\n", BOX_MAX_BLOCKS);
+    printf("  --skip-zero Zero-skipping engine: skip output tiles whose input is all zero and\n");
+    printf("              all-zero rows in the broadcasts; timed against full compute\n");
+    printf("  --skip-tile N  Occupancy tile edge in pixels (default: %d)\n", CONV2D_SKIP_TILE);
+    printf("  --density D Fraction of nonzero pixels in the random input of --skip-zero,\n");
+    printf("              placed as 64x64 blobs (default: 0.1)\n");
+    printf("  --dirty RECTS  Incremental mode: change the input inside rectangles y,x,h,w\n");
+    printf("              (separated by ':') and recompute only the affected output\n");
+    printf("  --cache-dir DIR  Result cache: reuse the stored output of an identical input,\n");
+    printf("              kernel, stride and dilation instead of computing (fp32 only)\n");
+    printf("  --cache-max-mb MB  Size budget of the cache directory, LRU eviction (default: %d)\n",
+           CONV2D_CACHE_MAX_MB);
+    printf("  --chain SPEC  Layer chain KHxKW[/SHxSW],... (random kernels), fused depth-first\n");
+    printf("              over output tiles and timed against running the layers one by one\n");
+    printf("  --chain-tile N  Final-output tile edge of the fused chain (default: %d)\n", CONV2D_CHAIN_TILE);
+    printf("  --volume    3D convolution of a DxHxW volume (-D -H -W or a binary volume -f)\n");
+    printf("              with a kDxkHxkW kernel, timed against the naive loop nest\n");
+    printf("  -D DEPTH    Slices of the random --volume input\n");
+    printf("  -kD DEPTH   Kernel depth of --volume (default: -kH)\n");
+    printf("  -sD STRIDE  Depth stride of --volume (default: 1)\n");
+    printf("  --backward  Input and kernel gradients for a random upstream gradient, timed\n");
+    printf("              against naive loops and checked with finite differences\n");
+    printf("  --frames N  Frame-stream mode: N frames (the input panned one column per frame)\n");
+    printf("              pipelined over double-buffered bands, timed against frame-at-a-time\n");
+    printf("  --groups G  Rank groups frames are spread over (default: 0, by frame size)\n");
+    printf("  --iterate T Apply the kernel T times (stride 1) with temporal blocking, timed\n");
+    printf("              against a ghost exchange per step and a conv2d_stride call per step\n");
+    printf("  --iter-block B  Steps per ghost exchange of --iterate (default: %d)\n", CONV2D_ITER_BLOCK);
+    printf("  --iter-tile N  Edge of the time-skewed tiles of --iterate (default: %d)\n", CONV2D_ITER_TILE);
+    printf("  --roi Y,X,H,W  Convolve only the output rectangle at Y,X of size HxW, reading\n");
+    printf("              and distributing only the input it depends on (seeks in .bin files)\n");
+    printf("  --stats     Output min/max/mean/std and histogram, fused with the convolution\n");
+    printf("              and timed against a gather plus a separate pass\n");
+    printf("  --stats-only  As --stats, without gathering or writing the output\n");
+    printf("  --hist BINS Histogram bins of --stats (default: %d, at most %d)\n",
+           CONV2D_HIST_BINS, CONV2D_HIST_MAX_BINS);
+    printf("  --hist-range LO,HI  Histogram range (default: a bound on |output|)\n");
+    printf("  --bias B    Fused epilogue: add B to every output\n");
+    printf("  --act NAME  Fused epilogue activation: none, relu or leaky (default: none)\n");
+    printf("  --alpha A   Negative slope of the leaky activation (default: 0.01)\n");
+    printf("  --scale S   Fused epilogue: multiply by S after the activation\n");
+    printf("  --clamp LO,HI  Fused epilogue: clamp outputs to [LO, HI] (applied last)\n");
+    printf("  --pool 2    Fused 2x2 max-pool (stride 2) of the output; serial, omp, mpi, hybrid\n");
+    printf("  --dtype TYPE  Storage type: f32, f16 or bf16 (16-bit input, output and MPI\n");
+    printf("              buffers with fp32 accumulation; reports error vs fp32 serial); hybrid only\n");
     printf("  --help      Show this help message\n\n");
     printf("Examples:\n");
     printf("  mpirun -np 4 %s -H 1000 -W 1000 -kH 3 -kW 3 -sW 2 -sH 3\n", program_name);
     printf("  mpirun -np 2 %s -f f.txt -g g.txt -sW 1 -sH 1 -o output.txt\n", program_name);
+    printf("  mpirun -np 4 %s -H 2000 -W 2000 -kH 5 -kW 5 --bank-size 16 --bank-compare\n", program_name);
+}
+
+/**
+ * Build the output file name for kernel k of a bank: "out.txt" -> "out_k.txt"
+ */
+static void bank_output_name(const char *output_file, int k, char *name, size_t len) {
+    const char *dot = strrchr(output_file, '.');
+    const char *slash = strrchr(output_file, '/');
+    if (dot && (!slash || dot > slash)) {
+        snprintf(name, len, "%.*s_%d%s", (int)(dot - output_file), output_file, k, dot);
+    } else {
+        snprintf(name, len, "%s_%d", output_file, k);
+    }
+}
+
+/**
+ * Filter-bank mode: apply many kernels to one input in a single pass.
+ * The input is generated/read and broadcast once for the whole bank.
+ */
+static int run_bank_mode(int rank, char *input_file, char *bank_path, char *output_file,
+                         int H, int W, int kH, int kW, int sH, int sW, int bank_size, int compare) {
+    float **f = NULL;
+    float ***bank = NULL;
+    int num_kernels = 0;
+
+    if (rank == 0) {
+        if (H > 0 && W > 0) {
+            f = allocate_2d_array(H, W);
+            if (!f) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+        } else if (input_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Bank mode needs -f FILE or -H/-W for the input\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        if (bank_path) {
+            if (read_kernel_bank(bank_path, &bank, &num_kernels, &kH, &kW) != 0) {
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else if (bank_size > 0 && kH > 0 && kW > 0) {
+            num_kernels = bank_size;
+            bank = (float***)calloc(num_kernels, sizeof(float**));
+            if (!bank) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            for (int k = 0; k < num_kernels; k++) {
+                bank[k] = allocate_2d_array(kH, kW);
+                if (!bank[k]) {
+                    fprintf(stderr, "Error allocating memory\n");
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+                generate_random_array(bank[k], kH, kW);
+            }
+        } else {
+            fprintf(stderr, "Error: Bank mode needs --bank PATH or --bank-size N with -kH/-kW\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        printf("Filter bank: %d kernels of %dx%d on %dx%d input, stride %dx%d\n",
+               num_kernels, kH, kW, H, W, sH, sW);
+    }
+
+    int dims[7] = {H, W, kH, kW, sH, sW, num_kernels};
+    MPI_Bcast(dims, 7, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3]; sH = dims[4]; sW = dims[5];
+    num_kernels = dims[6];
+
+    // Validate the bank's dimensions as the single-kernel path does
+    if (rank == 0) {
+        if (H <= 0 || W <= 0 || kH <= 0 || kW <= 0 || sH <= 0 || sW <= 0 || num_kernels <= 0) {
+            fprintf(stderr, "Error: Invalid dimensions - H=%d W=%d kH=%d kW=%d sH=%d sW=%d kernels=%d\n",
+                    H, W, kH, kW, sH, sW, num_kernels);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Distribute the input once for the whole bank
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        bank = (float***)calloc(num_kernels, sizeof(float**));
+        if (!f || !bank) {
+            fprintf(stderr, "Error allocating memory\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int k = 0; k < num_kernels; k++) {
+            bank[k] = allocate_2d_array(kH, kW);
+            if (!bank[k]) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int k = 0; k < num_kernels; k++) {
+        for (int i = 0; i < kH; i++) {
+            MPI_Bcast(bank[k][i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        }
+    }
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    float ***outputs = (float***)malloc(num_kernels * sizeof(float**));
+    if (!outputs) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int k = 0; k < num_kernels; k++) {
+        outputs[k] = allocate_2d_array(out_H, out_W);
+        if (!outputs[k]) {
+            fprintf(stderr, "Error allocating memory\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    PerfStats stats;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_bank = MPI_Wtime();
+    conv2d_stride_bank_stats(f, H, W, bank, num_kernels, kH, kW, sH, sW, outputs, MPI_COMM_WORLD, &stats);
+    MPI_Barrier(MPI_COMM_WORLD);
+    t_bank = MPI_Wtime() - t_bank;
+
+    // Optional baseline: one conv2d_stride call per kernel
+    double t_separate = 0.0;
+    if (compare) {
+        float **separate = allocate_2d_array(out_H, out_W);
+        MPI_Barrier(MPI_COMM_WORLD);
+        t_separate = MPI_Wtime();
+        for (int k = 0; k < num_kernels; k++) {
+            conv2d_stride(f, H, W, bank[k], kH, kW, sH, sW, separate, MPI_COMM_WORLD);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        t_separate = MPI_Wtime() - t_separate;
+        free_2d_array(separate, out_H);
+    }
+
+    if (rank == 0) {
+        printf("\n");
+        printf("========================================\n");
+        printf("Filter Bank Statistics\n");
+        printf("========================================\n");
+        printf("Total time:          %.6f seconds\n", t_bank);
+        printf("Computation time:    %.6f seconds\n", stats.computation_time);
+        printf("Communication time:  %.6f seconds\n", stats.communication_time);
+        printf("Time per kernel:     %.6f seconds\n", t_bank / num_kernels);
+        printf("Output elements:     %lld\n", stats.output_elements);
+        if (compare) {
+            printf("Separate runs:       %.6f seconds (%.2fx speedup for the bank)\n",
+                   t_separate, t_bank > 0 ? t_separate / t_bank : 0.0);
+        }
+        printf("========================================\n");
+
+        if (output_file) {
+            for (int k = 0; k < num_kernels; k++) {
+                char name[4096];
+                bank_output_name(output_file, k, name, sizeof(name));
+                printf("Writing output %d to %s\n", k, name);
+                write_array_to_file(name, outputs[k], out_H, out_W);
+            }
+        }
+    }
+
+    free_kernel_bank(outputs, num_kernels, out_H);
+    free_kernel_bank(bank, num_kernels, kH);
+    free_2d_array(f, H);
+    return 0;
+}
+
+/**
+ * Broadcast count floats from rank 0 in pieces of at most INT_MAX elements
+ */
+static void bcast_floats(float *buf, size_t count) {
+    while (count > 0) {
+        int n = count > INT_MAX ? INT_MAX : (int)count;
+        MPI_Bcast(buf, n, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        buf += n;
+        count -= n;
+    }
+}
+
+/**
+ * Multi-channel layer mode: random NHWC input with C_in channels and
+ * C_out kernels of C_in x kH x kW (or a depthwise layer). A single-channel
+ * layer is also run through conv2d_stride and the outputs compared.
+ */
+static int run_mc_mode(int rank, int H, int W, int kH, int kW, int sH, int sW,
+                       int C_in, int C_out, int depthwise, int split) {
+    if (depthwise || C_out <= 0) C_out = C_in;
+    if (H <= 0 || W <= 0 || kH <= 0 || kW <= 0 || sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Multi-channel mode needs -H -W -kH -kW and positive strides\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    size_t in_count = (size_t)H * W * C_in;
+    size_t weight_count = depthwise ? (size_t)C_in * kH * kW : (size_t)C_out * C_in * kH * kW;
+    size_t out_count = (size_t)out_H * out_W * C_out;
+
+    float *in = (float*)malloc(in_count * sizeof(float));
+    float *weights = (float*)malloc(weight_count * sizeof(float));
+    float *out = (float*)malloc(out_count * sizeof(float));
+    if (!in || !weights || !out) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Rank 0 generates the tensors and broadcasts them once
+    if (rank == 0) {
+        srand((unsigned int)time(NULL));
+        for (size_t i = 0; i < in_count; i++) in[i] = (float)rand() / (float)RAND_MAX;
+        for (size_t i = 0; i < weight_count; i++) weights[i] = (float)rand() / (float)RAND_MAX;
+        printf("Multi-channel %s layer: %dx%dx%d input, %d kernels of %dx%dx%d, stride %dx%d, split by %s\n",
+               depthwise ? "depthwise" : "dense", H, W, C_in, C_out, depthwise ? 1 : C_in, kH, kW,
+               sH, sW, split == MC_SPLIT_CHANNELS ? "output channels" : "rows");
+    }
+    bcast_floats(in, in_count);
+    bcast_floats(weights, weight_count);
+
+    PerfStats stats;
+    MPI_Barrier(MPI_COMM_WORLD);
+    conv2d_mc_stride_mpi_stats(in, H, W, C_in, weights, kH, kW, C_out, sH, sW, out,
+                               depthwise, split, MPI_COMM_WORLD, &stats);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // With one channel the layer is a plain 2D convolution
+    float **reference = NULL;
+    if (C_in == 1 && C_out == 1) {
+        float **f = allocate_2d_array(H, W);
+        float **g = allocate_2d_array(kH, kW);
+        reference = allocate_2d_array(out_H, out_W);
+        if (!f || !g || !reference) {
+            fprintf(stderr, "Error allocating memory\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int i = 0; i < H; i++) memcpy(f[i], in + (size_t)i * W, W * sizeof(float));
+        for (int i = 0; i < kH; i++) memcpy(g[i], weights + (size_t)i * kW, kW * sizeof(float));
+        conv2d_stride(f, H, W, g, kH, kW, sH, sW, reference, MPI_COMM_WORLD);
+        free_2d_array(f, H);
+        free_2d_array(g, kH);
+    }
+
+    if (rank == 0) {
+        double flops = 2.0 * out_H * out_W * C_out * kH * kW * (depthwise ? 1 : C_in);
+        printf("\n");
+        printf("========================================\n");
+        printf("Multi-channel Statistics\n");
+        printf("========================================\n");
+        printf("Total time:          %.6f seconds\n", stats.total_time);
+        printf("Computation time:    %.6f seconds\n", stats.computation_time);
+        printf("Communication time:  %.6f seconds\n", stats.communication_time);
+        printf("Throughput:          %.2f GFLOP/s\n",
+               stats.total_time > 0 ? flops / stats.total_time / 1e9 : 0.0);
+        printf("Output elements:     %lld (%dx%dx%d)\n", stats.output_elements, out_H, out_W, C_out);
+        if (reference) {
+            double max_diff = 0.0;
+            for (int i = 0; i < out_H; i++) {
+                for (int j = 0; j < out_W; j++) {
+                    double d = fabs((double)out[(size_t)i * out_W + j] - reference[i][j]);
+                    if (d > max_diff) max_diff = d;
+                }
+            }
+            printf("Max diff vs 2D:      %.6g (C=1 against conv2d_stride)\n", max_diff);
+        }
+        printf("========================================\n");
+    }
+    if (reference) free_2d_array(reference, out_H);
+
+    free(in);
+    free(weights);
+    free(out);
+    return 0;
+}
+
+/**
+ * Quantized mode: 8-bit input and int8/int16 weights with int32 accumulation,
+ * benchmarked against the float hybrid engine on the same (dequantized) data
+ */
+static int run_quant_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                          int H, int W, int kH, int kW, int sH, int sW,
+                          int input_signed, int weight_bits, int out_type, int repeat) {
+    float **f = NULL, **g = NULL;
+    float input_scale = input_signed ? 1.0f / 128.0f : 1.0f / 255.0f;
+
+    // Rank 0 generates 8-bit pixels (or reads and quantizes float files)
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            srand((unsigned int)time(NULL));
+            for (int i = 0; i < H; i++) {
+                for (int j = 0; j < W; j++) {
+                    int q = input_signed ? rand() % 256 - 128 : rand() % 256;
+                    f[i][j] = q * input_scale;
+                }
+            }
+            generate_random_array(g, kH, kW);
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            float max_abs = 0.0f;
+            for (int i = 0; i < H; i++) {
+                for (int j = 0; j < W; j++) {
+                    if (fabsf(f[i][j]) > max_abs) max_abs = fabsf(f[i][j]);
+                }
+            }
+            if (max_abs > 0.0f) input_scale = max_abs / (input_signed ? 127.0f : 255.0f);
+        } else {
+            fprintf(stderr, "Error: Quantized mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&input_scale, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    // Only the 8-bit input is broadcast
+    uint8_t *f_q = (uint8_t*)malloc((size_t)H * W);
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    if (!f_q || !f || !g) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        if (rank == 0) conv2d_quantize_input(f[i], f_q + (size_t)i * W, W, input_scale, input_signed);
+        MPI_Bcast(f_q + (size_t)i * W, W, MPI_UINT8_T, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+
+    // Float baseline runs on the dequantized pixels, so only the weight
+    // quantization and the output requantization show up as error
+    for (int i = 0; i < H; i++) {
+        for (int j = 0; j < W; j++) {
+            int q = input_signed ? (int8_t)f_q[(size_t)i * W + j] : f_q[(size_t)i * W + j];
+            f[i][j] = q * input_scale;
+        }
+    }
+
+    QuantKernel qk;
+    if (conv2d_quantize_kernel(g, kH, kW, weight_bits, &qk) != 0) {
+        if (rank == 0) fprintf(stderr, "Error: Cannot quantize kernel to %d bits\n", weight_bits);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (rank == 0) {
+        printf("Quantized %dx%d %s input, %dx%d int%d kernel (scale %.3g), stride %dx%d, %s output (%s)\n",
+               H, W, input_signed ? "int8" : "uint8", kH, kW, weight_bits, qk.scale, sH, sW,
+               out_type == CONV2D_QOUT_FLOAT ? "float" : out_type == CONV2D_QOUT_U8 ? "uint8" : "int8",
+               sW == 1 && conv2d_quant_has_avx2() ? "AVX2 madd" : "scalar");
+    }
+
+    float **reference = allocate_2d_array(out_H, out_W);
+    float **result = allocate_2d_array(out_H, out_W);
+    void *quant_out = malloc((size_t)out_H * out_W * sizeof(float));
+    if (!reference || !result || !quant_out) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, float_stats, quant_stats;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, reference, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < float_stats.total_time) float_stats = stats;
+    }
+
+    // Requantized outputs use the range of the float result
+    float out_scale = 1.0f;
+    if (out_type != CONV2D_QOUT_FLOAT) {
+        float max_abs = 0.0f;
+        for (int i = 0; i < out_H; i++) {
+            for (int j = 0; j < out_W; j++) {
+                if (fabsf(reference[i][j]) > max_abs) max_abs = fabsf(reference[i][j]);
+            }
+        }
+        if (max_abs > 0.0f) out_scale = max_abs / (out_type == CONV2D_QOUT_U8 ? 255.0f : 127.0f);
+    }
+
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_quant_stride_stats(f_q, H, W, input_signed, input_scale, &qk, sH, sW,
+                                  out_type, out_scale, quant_out, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < quant_stats.total_time) quant_stats = stats;
+    }
+
+    if (rank == 0) {
+        double max_abs = 0.0, max_ref = 0.0;
+        for (int i = 0; i < out_H; i++) {
+            for (int j = 0; j < out_W; j++) {
+                size_t idx = (size_t)i * out_W + j;
+                if (out_type == CONV2D_QOUT_FLOAT) {
+                    result[i][j] = ((float*)quant_out)[idx];
+                } else if (out_type == CONV2D_QOUT_U8) {
+                    result[i][j] = ((uint8_t*)quant_out)[idx] * out_scale;
+                } else {
+                    result[i][j] = ((int8_t*)quant_out)[idx] * out_scale;
+                }
+                double err = fabs((double)result[i][j] - reference[i][j]);
+                if (err > max_abs) max_abs = err;
+                if (fabs(reference[i][j]) > max_ref) max_ref = fabs(reference[i][j]);
+            }
+        }
+
+        printf("\n");
+        printf("========================================\n");
+        printf("Quantized vs Float Engine (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Float time:          %.6f seconds (computation %.6f)\n",
+               float_stats.total_time, float_stats.computation_time);
+        printf("Quantized time:      %.6f seconds (computation %.6f)\n",
+               quant_stats.total_time, quant_stats.computation_time);
+        printf("Speedup:             %.2fx\n",
+               quant_stats.total_time > 0 ? float_stats.total_time / quant_stats.total_time : 0.0);
+        printf("Input broadcast:     %.2f MB (float: %.2f MB)\n",
+               (double)H * W / (1024.0 * 1024.0), (double)H * W * sizeof(float) / (1024.0 * 1024.0));
+        size_t out_elem = out_type == CONV2D_QOUT_FLOAT ? sizeof(float) : sizeof(uint8_t);
+        printf("Output gather:       %.2f MB (float: %.2f MB)\n",
+               quant_stats.bytes_communicated / (1024.0 * 1024.0),
+               quant_stats.bytes_communicated * (sizeof(float) / out_elem) / (1024.0 * 1024.0));
+        printf("Max abs error:       %.6g\n", max_abs);
+        printf("Max rel error:       %.6g (of max |output| %.6g)\n",
+               max_ref > 0 ? max_abs / max_ref : 0.0, max_ref);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, result, out_H, out_W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, result, out_H, out_W);
+            }
+        }
+    }
+
+    conv2d_free_quant_kernel(&qk);
+    free(quant_out);
+    free_2d_array(result, out_H);
+    free_2d_array(reference, out_H);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    free(f_q);
+    return 0;
+}
+
+/**
+ * Synthetic mostly-zero input: random 64x64 blobs of nonzero pixels placed
+ * until they cover the given fraction of the image (like masks or heatmaps)
+ */
+static void generate_sparse_array(float **array, int rows, int cols, double density) {
+    const int blob = 64;
+    for (int i = 0; i < rows; i++) {
+        memset(array[i], 0, (size_t)cols * sizeof(float));
+    }
+    if (density <= 0.0) return;
+    if (density >= 1.0) {
+        generate_random_array(array, rows, cols);
+        return;
+    }
+
+    srand((unsigned int)time(NULL));
+    long long target = (long long)(density * rows * cols);
+    long long covered = 0;
+    while (covered < target) {
+        int y0 = rand() % rows, x0 = rand() % cols;
+        int y1 = y0 + blob < rows ? y0 + blob : rows;
+        int x1 = x0 + blob < cols ? x0 + blob : cols;
+        for (int i = y0; i < y1 && covered < target; i++) {
+            for (int j = x0; j < x1 && covered < target; j++) {
+                if (array[i][j] == 0.0f) {
+                    array[i][j] = 0.01f + (float)rand() / RAND_MAX;
+                    covered++;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Zero-skipping mode: occupancy-map engine timed against the same engine
+ * with skipping disabled, on a file or a synthetic input of given density
+ */
+static int run_skip_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                         int H, int W, int kH, int kW, int sH, int sW,
+                         double density, int tile, int repeat) {
+    float **f = NULL, **g = NULL;
+
+    // Rank 0 generates or reads the data
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_sparse_array(f, H, W, density);
+            generate_random_array(g, kH, kW);
+            if (input_file) {
+                if (is_binary_filename(input_file)) write_array_to_binary(input_file, f, H, W, CONV2D_DTYPE_F32);
+                else write_array_to_file(input_file, f, H, W);
+            }
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Zero-skipping mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0 || tile <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d or tile %d\n", sH, sW, tile);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    float **baseline = allocate_2d_array(out_H, out_W);
+    float **output = allocate_2d_array(out_H, out_W);
+    if (!f || !g || !baseline || !output) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // All-zero input rows are not broadcast
+    double t_bcast = MPI_Wtime();
+    long long input_bytes = conv2d_bcast_nonzero_rows(f, H, W, 0, MPI_COMM_WORLD);
+    t_bcast = MPI_Wtime() - t_bcast;
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+
+    if (rank == 0) {
+        long long nonzero = 0;
+        for (int i = 0; i < H; i++) {
+            for (int j = 0; j < W; j++) {
+                if (f[i][j] != 0.0f) nonzero++;
+            }
+        }
+        printf("Zero skipping: %dx%d input (%.2f%% nonzero), %dx%d kernel, stride %dx%d, %dx%d tiles\n",
+               H, W, 100.0 * nonzero / ((double)H * W), kH, kW, sH, sW, tile, tile);
+    }
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, base_stats, skip_stats;
+    SkipStats skip, best_skip;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_stride_skip_stats(f, H, W, g, kH, kW, sH, sW, 0, baseline, MPI_COMM_WORLD, &stats, NULL);
+        if (r == 0 || stats.total_time < base_stats.total_time) base_stats = stats;
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_stride_skip_stats(f, H, W, g, kH, kW, sH, sW, tile, output, MPI_COMM_WORLD, &stats, &skip);
+        if (r == 0 || stats.total_time < skip_stats.total_time) {
+            skip_stats = stats;
+            best_skip = skip;
+        }
+    }
+
+    // Skipped tiles summed over ranks
+    long long tile_counts[2] = {best_skip.tiles_skipped, best_skip.tiles_total};
+    long long tile_sums[2];
+    MPI_Reduce(tile_counts, tile_sums, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    double build_time;
+    MPI_Reduce(&best_skip.build_time, &build_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int i = 0; i < out_H; i++) {
+            for (int j = 0; j < out_W; j++) {
+                double d = fabs((double)output[i][j] - baseline[i][j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+        double dense_mb = (double)H * W * sizeof(float) / (1024.0 * 1024.0);
+
+        printf("\n");
+        printf("========================================\n");
+        printf("Zero Skipping vs Full Compute (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Full time:           %.6f seconds (computation %.6f)\n",
+               base_stats.total_time, base_stats.computation_time);
+        printf("Skipping time:       %.6f seconds (computation %.6f)\n",
+               skip_stats.total_time, skip_stats.computation_time);
+        printf("Speedup:             %.2fx\n",
+               skip_stats.total_time > 0 ? base_stats.total_time / skip_stats.total_time : 0.0);
+        printf("Occupancy pre-pass:  %.6f seconds (slowest rank)\n", build_time);
+        printf("Tiles skipped:       %lld of %lld (%.1f%%)\n", tile_sums[0], tile_sums[1],
+               tile_sums[1] > 0 ? 100.0 * tile_sums[0] / tile_sums[1] : 0.0);
+        printf("Input broadcast:     %.2f MB in %.6f s (all rows: %.2f MB)\n",
+               input_bytes / (1024.0 * 1024.0), t_bcast, dense_mb);
+        printf("Output gather:       %.2f MB, %lld zero rows skipped (all rows: %.2f MB)\n",
+               skip_stats.bytes_communicated / (1024.0 * 1024.0), best_skip.rows_skipped,
+               base_stats.bytes_communicated / (1024.0 * 1024.0));
+        printf("Max diff vs full:    %.6g\n", max_diff);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, output, out_H, out_W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, output, out_H, out_W);
+            }
+        }
+    }
+
+    free_2d_array(output, out_H);
+    free_2d_array(baseline, out_H);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/**
+ * Parse "y,x,h,w[:y,x,h,w...]" into rectangles. Returns the count, or -1.
+ */
+static int parse_dirty_rects(const char *spec, Conv2dRect **rects) {
+    int n = 1;
+    for (const char *c = spec; *c; c++) {
+        if (*c == ':') n++;
+    }
+    *rects = (Conv2dRect*)malloc(n * sizeof(Conv2dRect));
+    if (!*rects) return -1;
+
+    const char *c = spec;
+    for (int k = 0; k < n; k++) {
+        Conv2dRect *r = &(*rects)[k];
+        int used = 0;
+        if (sscanf(c, "%d,%d,%d,%d%n", &r->y, &r->x, &r->h, &r->w, &used) != 4 || r->h <= 0 || r->w <= 0) {
+            free(*rects);
+            *rects = NULL;
+            return -1;
+        }
+        c += used;
+        if (*c == ':') c++;
+    }
+    return n;
+}
+
+/**
+ * Incremental mode: full convolution, then the input changes inside the
+ * dirty rectangles and only the affected output is recomputed. Timed against
+ * a full recompute of the changed input.
+ */
+static int run_dirty_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                          int H, int W, int kH, int kW, int sH, int sW,
+                          const char *dirty_spec, int repeat) {
+    float **f = NULL, **g = NULL;
+    Conv2dRect *dirty = NULL;
+    int num_dirty = parse_dirty_rects(dirty_spec, &dirty);
+    if (num_dirty < 0) {
+        if (rank == 0) fprintf(stderr, "Error: --dirty expects y,x,h,w[:y,x,h,w...]\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Rank 0 generates or reads the data
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+            generate_random_array(g, kH, kW);
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Incremental mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    float **reference = allocate_2d_array(out_H, out_W);
+    float **output = allocate_2d_array(out_H, out_W);
+    if (!f || !g || !reference || !output) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    // Output of the previous input
+    conv2d_stride(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD);
+
+    // The same change on every rank, so no rebroadcast is needed
+    long long dirty_pixels = 0;
+    for (int d = 0; d < num_dirty; d++) {
+        for (int i = dirty[d].y > 0 ? dirty[d].y : 0; i < dirty[d].y + dirty[d].h && i < H; i++) {
+            for (int j = dirty[d].x > 0 ? dirty[d].x : 0; j < dirty[d].x + dirty[d].w && j < W; j++) {
+                f[i][j] = 1.0f - f[i][j];
+                dirty_pixels++;
+            }
+        }
+    }
+
+    PerfStats stats, full_stats, update_stats;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, reference, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < full_stats.total_time) full_stats = stats;
+    }
+    long long recomputed = 0;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        recomputed = conv2d_update_stats(f, H, W, g, kH, kW, sH, sW, dirty, num_dirty, output,
+                                         MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < update_stats.total_time) update_stats = stats;
+    }
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int i = 0; i < out_H; i++) {
+            for (int j = 0; j < out_W; j++) {
+                double d = fabs((double)output[i][j] - reference[i][j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+
+        printf("Incremental update: %dx%d input, %dx%d kernel, stride %dx%d, %d dirty rectangle%s\n",
+               H, W, kH, kW, sH, sW, num_dirty, num_dirty == 1 ? "" : "s");
+        printf("\n");
+        printf("========================================\n");
+        printf("Incremental vs Full Recompute (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Dirty input:         %lld pixels (%.3f%%)\n", dirty_pixels,
+               100.0 * dirty_pixels / ((double)H * W));
+        printf("Recomputed output:   %lld pixels (%.3f%%)\n", recomputed,
+               100.0 * recomputed / ((double)out_H * out_W));
+        printf("Full time:           %.6f seconds (computation %.6f)\n",
+               full_stats.total_time, full_stats.computation_time);
+        printf("Incremental time:    %.6f seconds (computation %.6f)\n",
+               update_stats.total_time, update_stats.computation_time);
+        printf("Speedup:             %.2fx\n",
+               update_stats.total_time > 0 ? full_stats.total_time / update_stats.total_time : 0.0);
+        printf("Updated pixels/s:    %.3g\n",
+               update_stats.total_time > 0 ? recomputed / update_stats.total_time : 0.0);
+        printf("Bytes exchanged:     %.2f MB (full gather: %.2f MB)\n",
+               update_stats.bytes_communicated / (1024.0 * 1024.0),
+               (double)out_H * out_W * sizeof(float) / (1024.0 * 1024.0));
+        printf("Max diff vs full:    %.6g\n", max_diff);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, output, out_H, out_W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, output, out_H, out_W);
+            }
+        }
+    }
+
+    free_2d_array(output, out_H);
+    free_2d_array(reference, out_H);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    free(dirty);
+    return 0;
+}
+
+/**
+ * Parse a chain spec "KHxKW[/S | /SHxSW],..." into layers (kernels left
+ * unset). Returns the number of layers, or -1 on a malformed spec.
+ */
+static int parse_chain_spec(const char *spec, Conv2dLayer *layers) {
+    int n = 0;
+    const char *p = spec;
+    while (*p) {
+        if (n == CONV2D_CHAIN_MAX_LAYERS) return -1;
+        Conv2dLayer *L = &layers[n];
+        int used = 0;
+        if (sscanf(p, "%dx%d%n", &L->kH, &L->kW, &used) != 2) return -1;
+        p += used;
+        L->sH = L->sW = 1;
+        if (*p == '/') {
+            p++;
+            if (sscanf(p, "%d%n", &L->sH, &used) != 1) return -1;
+            p += used;
+            L->sW = L->sH;
+            if (*p == 'x') {
+                p++;
+                if (sscanf(p, "%d%n", &L->sW, &used) != 1) return -1;
+                p += used;
+            }
+        }
+        if (L->kH <= 0 || L->kW <= 0 || L->sH <= 0 || L->sW <= 0) return -1;
+        L->g = NULL;
+        n++;
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+    return n;
+}
+
+/**
+ * Chain mode: a multi-layer chain with random kernels, run layer by layer
+ * (conv2d_stride per layer) and fused depth-first over output tiles
+ */
+static int run_chain_mode(int rank, char *input_file, char *output_file, int H, int W,
+                          const char *chain_spec, int tile, int repeat) {
+    Conv2dLayer layers[CONV2D_CHAIN_MAX_LAYERS];
+    int num_layers = parse_chain_spec(chain_spec, layers);
+    if (num_layers < 1) {
+        if (rank == 0) fprintf(stderr, "Error: --chain expects KHxKW[/SHxSW],... with 1 to %d layers\n",
+                               CONV2D_CHAIN_MAX_LAYERS);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    float **f = NULL;
+
+    // Rank 0 generates or reads the input; kernels are random
+    if (rank == 0) {
+        if (H > 0 && W > 0) {
+            f = allocate_2d_array(H, W);
+            if (!f) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+        } else if (input_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Chain mode needs -H -W or -f\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[2] = {H, W};
+    MPI_Bcast(dims, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1];
+    if (rank != 0) f = allocate_2d_array(H, W);
+    for (int l = 0; l < num_layers; l++) {
+        layers[l].g = allocate_2d_array(layers[l].kH, layers[l].kW);
+        if (!layers[l].g) {
+            fprintf(stderr, "Error allocating memory\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (rank == 0) generate_random_array(layers[l].g, layers[l].kH, layers[l].kW);
+        for (int i = 0; i < layers[l].kH; i++) {
+            MPI_Bcast(layers[l].g[i], layers[l].kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        }
+    }
+
+    int dims_H[CONV2D_CHAIN_MAX_LAYERS + 1], dims_W[CONV2D_CHAIN_MAX_LAYERS + 1];
+    conv2d_chain_dims(H, W, layers, num_layers, dims_H, dims_W);
+    int out_H = dims_H[num_layers];
+    int out_W = dims_W[num_layers];
+    float **reference = allocate_2d_array(out_H, out_W);
+    float **output = allocate_2d_array(out_H, out_W);
+    if (!f || !reference || !output) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, layered_stats, fused_stats;
+    ChainStats chain, layered_chain, fused_chain;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_chain_layered_stats(f, H, W, layers, num_layers, reference, MPI_COMM_WORLD, &stats, &chain);
+        if (r == 0 || stats.total_time < layered_stats.total_time) {
+            layered_stats = stats;
+            layered_chain = chain;
+        }
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_chain_stats(f, H, W, layers, num_layers, tile, output, MPI_COMM_WORLD, &stats, &chain);
+        if (r == 0 || stats.total_time < fused_stats.total_time) {
+            fused_stats = stats;
+            fused_chain = chain;
+        }
+    }
+
+    // Peak memory is the largest rank's, traffic is summed over ranks
+    long long local_peak[2] = { layered_chain.peak_bytes, fused_chain.peak_bytes };
+    long long local_traffic[2] = { layered_chain.traffic_bytes, fused_chain.traffic_bytes };
+    long long local_macs[2] = { layered_chain.macs, fused_chain.macs };
+    long long peak_bytes[2], traffic_bytes[2], macs[2];
+    MPI_Reduce(local_peak, peak_bytes, 2, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_traffic, traffic_bytes, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_macs, macs, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int i = 0; i < out_H; i++) {
+            for (int j = 0; j < out_W; j++) {
+                double d = fabs((double)output[i][j] - reference[i][j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+        double mb = 1024.0 * 1024.0;
+
+        printf("Chain: %dx%d input, %d layer%s:", H, W, num_layers, num_layers == 1 ? "" : "s");
+        for (int l = 0; l < num_layers; l++) {
+            printf(" %dx%d/%dx%d", layers[l].kH, layers[l].kW, layers[l].sH, layers[l].sW);
+        }
+        printf(" -> %dx%d output\n", out_H, out_W);
+        printf("\n");
+        printf("========================================\n");
+        printf("Fused vs Layer-at-a-time (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Tile:                %dx%d final pixels, %.1f KB of buffers per thread\n",
+               tile > 0 ? tile : CONV2D_CHAIN_TILE, tile > 0 ? tile : CONV2D_CHAIN_TILE,
+               fused_chain.tile_buffer_bytes / 1024.0);
+        printf("Receptive field:     %d input rows per output row, rank 0 band %d rows\n",
+               fused_chain.receptive_field, fused_chain.band_rows);
+        printf("Layered time:        %.6f seconds (computation %.6f)\n",
+               layered_stats.total_time, layered_stats.computation_time);
+        printf("Fused time:          %.6f seconds (computation %.6f)\n",
+               fused_stats.total_time, fused_stats.computation_time);
+        printf("Speedup:             %.2fx\n",
+               fused_stats.total_time > 0 ? layered_stats.total_time / fused_stats.total_time : 0.0);
+        printf("Peak memory/rank:    %.2f MB fused, %.2f MB layered (modelled)\n",
+               peak_bytes[1] / mb, peak_bytes[0] / mb);
+        printf("DRAM traffic:        %.2f MB fused, %.2f MB layered (modelled, all ranks)\n",
+               traffic_bytes[1] / mb, traffic_bytes[0] / mb);
+        printf("Multiply-adds:       %.3g fused, %.3g layered (%.1f%% recomputed halo)\n",
+               (double)macs[1], (double)macs[0], macs[0] > 0 ? 100.0 * (macs[1] - macs[0]) / macs[0] : 0.0);
+        printf("Bytes exchanged:     %.2f MB fused, %.2f MB layered\n",
+               fused_stats.bytes_communicated / mb, layered_stats.bytes_communicated / mb);
+        printf("Max diff vs layered: %.6g\n", max_diff);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, output, out_H, out_W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, output, out_H, out_W);
+            }
+        }
+    }
+
+    free_2d_array(output, out_H);
+    free_2d_array(reference, out_H);
+    free_2d_array(f, H);
+    for (int l = 0; l < num_layers; l++) {
+        free_2d_array(layers[l].g, layers[l].kH);
+    }
+    return 0;
+}
+
+/**
+ * Statistics mode: output min/max/mean/std and histogram, computed fused
+ * with the convolution (and, with --stats-only, without gathering the
+ * output) and timed against a gather plus a separate pass
+ */
+static int run_stats_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                          int H, int W, int kH, int kW, int sH, int sW,
+                          int bins, const char *range_spec, int stats_only, int repeat) {
+    float **f = NULL, **g = NULL;
+
+    // Rank 0 generates or reads the data
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+            generate_random_array(g, kH, kW);
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Statistics mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    float **output = allocate_2d_array(out_H, out_W);
+    if (!f || !g || !output) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    // Histogram range: given, or a bound on |output| from rank 0's data
+    float range[2];
+    if (rank == 0) {
+        if (!range_spec || sscanf(range_spec, "%f,%f", &range[0], &range[1]) != 2) {
+            conv2d_reduce_range(f, H, W, g, kH, kW, &range[0], &range[1]);
+        }
+    }
+    MPI_Bcast(range, 2, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    // Baseline: gathered output, then a separate pass on rank 0
+    PerfStats stats, base_stats, fused_stats;
+    Conv2dReduce base, fused;
+    double base_time = 0.0, pass_time = 0.0;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+        double t_pass = MPI_Wtime();
+        if (rank == 0) {
+            conv2d_reduce_init(&base, range[0], range[1], bins);
+            conv2d_reduce_rows(&base, output, out_H, out_W);
+        }
+        double t1 = MPI_Wtime();
+        if (r == 0 || t1 - t0 < base_time) {
+            base_time = t1 - t0;
+            pass_time = t1 - t_pass;
+            base_stats = stats;
+        }
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_reduce_init(&fused, range[0], range[1], bins);
+        conv2d_stride_reduce_stats(f, H, W, g, kH, kW, sH, sW, stats_only ? NULL : output, &fused,
+                                   MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < fused_stats.total_time) fused_stats = stats;
+    }
+
+    if (rank == 0) {
+        double mb = 1024.0 * 1024.0;
+        printf("Output statistics: %dx%d input, %dx%d kernel, stride %dx%d, %dx%d output\n",
+               H, W, kH, kW, sH, sW, out_H, out_W);
+        printf("\n");
+        printf("========================================\n");
+        printf("Fused Reductions vs Separate Pass (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Separate time:       %.6f seconds (gather %.6f, pass %.6f)\n",
+               base_time, base_stats.communication_time, pass_time);
+        printf("Fused time:          %.6f seconds (computation %.6f)%s\n",
+               fused_stats.total_time, fused_stats.computation_time,
+               stats_only ? ", no output gather" : "");
+        printf("Speedup:             %.2fx\n",
+               fused_stats.total_time > 0 ? base_time / fused_stats.total_time : 0.0);
+        printf("Bytes exchanged:     %.4f MB fused, %.4f MB separate\n",
+               fused_stats.bytes_communicated / mb, base_stats.bytes_communicated / mb);
+        printf("Min/max difference:  %.6g / %.6g, mean difference %.6g\n",
+               fabs(fused.min - base.min), fabs(fused.max - base.max),
+               fabs(fused.sum - base.sum) / (fused.count > 0 ? fused.count : 1));
+        printf("\n");
+        printf("Statistics (fused):\n");
+        conv2d_reduce_print(&fused);
+        printf("========================================\n");
+
+        if (output_file && !stats_only) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, output, out_H, out_W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, output, out_H, out_W);
+            }
+        } else if (output_file) {
+            printf("Output not gathered with --stats-only; %s not written\n", output_file);
+        }
+    }
+
+    free_2d_array(output, out_H);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/**
+ * Region-of-interest mode: read, distribute and convolve only the input
+ * rectangle the output window depends on. Timed against reading and
+ * convolving the whole input, and checked against its window.
+ */
+static int run_roi_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                        int H, int W, int kH, int kW, int sH, int sW,
+                        const char *roi_spec, int repeat) {
+    float **f = NULL, **g = NULL, **crop = NULL;
+    Conv2dRect roi, in;
+    if (sscanf(roi_spec, "%d,%d,%d,%d", &roi.y, &roi.x, &roi.h, &roi.w) != 4) {
+        if (rank == 0) fprintf(stderr, "Error: --roi expects y0,x0,h,w\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Rank 0 reads the dimensions only, or generates the data
+    if (rank == 0) {
+        if (input_file && kernel_file) {
+            if (read_array_dims(input_file, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+            generate_random_array(g, kH, kW);
+        } else {
+            fprintf(stderr, "Error: ROI mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    if (conv2d_roi_input_rect(roi, H, W, kH, kW, sH, sW, &in) != 0) {
+        if (rank == 0) fprintf(stderr, "Error: ROI %d,%d,%d,%d is not inside the %dx%d output\n",
+                               roi.y, roi.x, roi.h, roi.w, out_H, out_W);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (rank != 0) g = allocate_2d_array(kH, kW);
+    float **roi_out = allocate_2d_array(roi.h, roi.w);
+    if (!g || !roi_out) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    // ROI: read the crop on rank 0, then distribute and convolve it
+    PerfStats stats, roi_stats, full_stats;
+    double read_time = 0.0, full_read_time = 0.0;
+    long long read_bytes = 0;
+    if (rank == 0) {
+        double t0 = MPI_Wtime();
+        if (input_file) {
+            read_bytes = read_array_region(input_file, in, &crop);
+            if (read_bytes < 0) {
+                fprintf(stderr, "Error reading %s\n", input_file);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            crop = allocate_2d_array(in.h, in.w);
+            if (!crop) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            for (int i = 0; i < in.h; i++) {
+                memcpy(crop[i], f[in.y + i] + in.x, in.w * sizeof(float));
+            }
+        }
+        read_time = MPI_Wtime() - t0;
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_stride_roi_stats(crop, in, H, W, g, kH, kW, sH, sW, roi, roi_out, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < roi_stats.total_time) roi_stats = stats;
+    }
+
+    // Baseline: read and broadcast the whole input, convolve all of it
+    if (rank == 0 && input_file) {
+        double t0 = MPI_Wtime();
+        if (read_array_from_file(input_file, &f, &H, &W) != 0) {
+            fprintf(stderr, "Error reading %s\n", input_file);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        full_read_time = MPI_Wtime() - t0;
+    }
+    if (rank != 0) f = allocate_2d_array(H, W);
+    float **output = allocate_2d_array(out_H, out_W);
+    if (!f || !output) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    double full_bcast_time = 0.0;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+        for (int i = 0; i < H; i++) {
+            MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        }
+        double t_bcast = MPI_Wtime() - t0;
+        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+        if (r == 0 || t_bcast + stats.total_time < full_bcast_time + full_stats.total_time) {
+            full_bcast_time = t_bcast;
+            full_stats = stats;
+        }
+    }
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int i = 0; i < roi.h; i++) {
+            for (int j = 0; j < roi.w; j++) {
+                double d = fabs(roi_out[i][j] - output[roi.y + i][roi.x + j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+        double mb = 1024.0 * 1024.0;
+        double full_bytes = (double)H * W * sizeof(float);
+        double roi_total = read_time + roi_stats.total_time;
+        double full_total = full_read_time + full_bcast_time + full_stats.total_time;
+        printf("Region of interest: output %d,%d %dx%d of %dx%d, input %d,%d %dx%d of %dx%d\n",
+               roi.y, roi.x, roi.h, roi.w, out_H, out_W, in.y, in.x, in.h, in.w, H, W);
+        printf("\n");
+        printf("========================================\n");
+        printf("ROI vs Full Convolution (best of %d)\n", repeat);
+        printf("========================================\n");
+        if (input_file) {
+            printf("Input read:          %.2f MB in %.6f s (ROI, %s), whole file in %.6f s\n",
+                   read_bytes / mb, read_time, read_bytes > 0 ? "seek-based" : "text, parsed in full",
+                   full_read_time);
+        }
+        printf("Input distributed:   %.2f MB of %.2f MB (%.2f%%)\n",
+               (double)in.h * in.w * sizeof(float) / mb, full_bytes / mb,
+               100.0 * in.h * in.w / ((double)H * W));
+        printf("ROI time:            %.6f seconds (computation %.6f, communication %.6f)\n",
+               roi_stats.total_time, roi_stats.computation_time, roi_stats.communication_time);
+        printf("Full time:           %.6f seconds (broadcast %.6f, convolution %.6f)\n",
+               full_bcast_time + full_stats.total_time, full_bcast_time, full_stats.total_time);
+        printf("Speedup:             %.2fx including reads\n", roi_total > 0 ? full_total / roi_total : 0.0);
+        printf("Bytes exchanged:     %.2f MB ROI, %.2f MB full\n",
+               roi_stats.bytes_communicated / mb,
+               (full_stats.bytes_communicated + (size > 1 ? full_bytes : 0.0)) / mb);
+        printf("Max difference:      %.6g (ROI vs window of the full output)\n", max_diff);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing ROI output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, roi_out, roi.h, roi.w, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, roi_out, roi.h, roi.w);
+            }
+        }
+    }
+
+    free_2d_array(output, out_H);
+    free_2d_array(roi_out, roi.h);
+    free_2d_array(crop, in.h);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/**
+ * Print one line of the iteration report with totals over all ranks
+ */
+static void print_iterate_line(const char *name, double time, const IterStats *it, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    long long local[4] = { it->exchanges, it->exchange_bytes, it->traffic_bytes, it->macs };
+    long long total[4];
+    MPI_Reduce(local, total, 4, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    if (rank == 0) {
+        int steps = it->steps > 0 ? it->steps : 1;
+        double mb = 1024.0 * 1024.0;
+        printf("%-14s %9.6f s  %9.1f  %12.4f  %12.2f  %8.3f\n", name, time,
+               (double)total[0] / steps, total[1] / mb / steps, total[2] / mb / steps,
+               (double)total[3] / steps / 1e9);
+    }
+}
+
+/**
+ * Iteration mode: the same stride-1 kernel applied --iterate times, with
+ * temporal blocking (block steps per ghost exchange) against a ghost
+ * exchange every step and one conv2d_stride call per step
+ */
+static int run_iterate_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                            int H, int W, int kH, int kW, int steps, int block, int tile, int repeat) {
+    float **f = NULL, **g = NULL;
+
+    // Rank 0 generates or reads the data
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+            generate_random_array(g, kH, kW);
+
+            // A random kernel normalised to sum 1 keeps the iteration bounded
+            double sum = 0.0;
+            for (int i = 0; i < kH; i++) {
+                for (int j = 0; j < kW; j++) sum += g[i][j];
+            }
+            for (int i = 0; i < kH; i++) {
+                for (int j = 0; j < kW; j++) g[i][j] = (float)(g[i][j] / sum);
+            }
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Iteration mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    float **output = allocate_2d_array(H, W);
+    float **reference = allocate_2d_array(H, W);
+    if (!f || !g || !output || !reference) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, blocked_stats, single_stats, stepwise_stats;
+    IterStats it, blocked, single, stepwise;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_iterate_stepwise_stats(f, H, W, g, kH, kW, steps, reference, MPI_COMM_WORLD, &stats, &it);
+        if (r == 0 || stats.total_time < stepwise_stats.total_time) {
+            stepwise_stats = stats;
+            stepwise = it;
+        }
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_iterate_stats(f, H, W, g, kH, kW, steps, 1, tile, output, MPI_COMM_WORLD, &stats, &it);
+        if (r == 0 || stats.total_time < single_stats.total_time) {
+            single_stats = stats;
+            single = it;
+        }
+    }
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_iterate_stats(f, H, W, g, kH, kW, steps, block, tile, output, MPI_COMM_WORLD, &stats, &it);
+        if (r == 0 || stats.total_time < blocked_stats.total_time) {
+            blocked_stats = stats;
+            blocked = it;
+        }
+    }
+
+    if (rank == 0) {
+        printf("Iterated convolution: %dx%d input, %dx%d kernel, %d steps, %d steps per exchange, %d-pixel tiles\n",
+               H, W, kH, kW, steps, blocked.block, tile > 0 ? tile : CONV2D_ITER_TILE);
+        printf("\n");
+        printf("========================================\n");
+        printf("Temporal Blocking (best of %d, per step over all ranks)\n", repeat);
+        printf("========================================\n");
+        printf("%-14s %11s  %9s  %12s  %12s  %8s\n", "Engine", "Time", "Exchanges", "Exchange MB",
+               "Traffic MB", "GMACs");
+    }
+    char name[32];
+    print_iterate_line("conv2d_stride", stepwise_stats.total_time, &stepwise, MPI_COMM_WORLD);
+    print_iterate_line("block 1", single_stats.total_time, &single, MPI_COMM_WORLD);
+    snprintf(name, sizeof(name), "block %d", blocked.block);
+    print_iterate_line(name, blocked_stats.total_time, &blocked, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int i = 0; i < H; i++) {
+            for (int j = 0; j < W; j++) {
+                double d = fabs(output[i][j] - reference[i][j]);
+                if (d > max_diff) max_diff = d;
+            }
+        }
+        printf("\n");
+        printf("Ghost rows (rank 0): %d at block %d\n", blocked.ghost_rows, blocked.block);
+        printf("Speedup:             %.2fx vs conv2d_stride, %.2fx vs block 1\n",
+               blocked_stats.total_time > 0 ? stepwise_stats.total_time / blocked_stats.total_time : 0.0,
+               blocked_stats.total_time > 0 ? single_stats.total_time / blocked_stats.total_time : 0.0);
+        printf("Max difference:      %.6g (blocked vs conv2d_stride)\n", max_diff);
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, output, H, W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, output, H, W);
+            }
+        }
+    }
+
+    free_2d_array(reference, H);
+    free_2d_array(output, H);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/*
+ * Frame stream of --frames: a base image panned one column per frame, and
+ * per-frame output checksums (plus files when -o is given)
+ */
+typedef struct {
+    float **base;
+    const char *output_file;
+    double *checksum;
+} StreamFrames;
+
+static void stream_source(int k, float *frame, int rows, int cols, void *ctx) {
+    StreamFrames *sf = (StreamFrames*)ctx;
+    int shift = k % cols;
+    for (int i = 0; i < rows; i++) {
+        float *dst = frame + (size_t)i * cols;
+        memcpy(dst, sf->base[i] + shift, (size_t)(cols - shift) * sizeof(float));
+        memcpy(dst + cols - shift, sf->base[i], (size_t)shift * sizeof(float));
+    }
+}
+
+static void stream_sink(int k, float *out, int rows, int cols, void *ctx) {
+    StreamFrames *sf = (StreamFrames*)ctx;
+    double sum = 0.0;
+    for (size_t n = 0; n < (size_t)rows * cols; n++) sum += out[n];
+    sf->checksum[k] = sum;
+
+    if (sf->output_file) {
+        char name[1024];
+        float **view = (float**)malloc(rows * sizeof(float*));
+        if (!view) return;
+        for (int i = 0; i < rows; i++) view[i] = out + (size_t)i * cols;
+        bank_output_name(sf->output_file, k, name, sizeof(name));
+        if (is_binary_filename(name)) {
+            write_array_to_binary(name, view, rows, cols, CONV2D_DTYPE_F32);
+        } else {
+            write_array_to_file(name, view, rows, cols);
+        }
+        free(view);
+    }
+}
+
+/**
+ * Frame-stream mode: --frames frames pipelined over double-buffered bands
+ * and rank groups, against one broadcast/convolve/gather per frame
+ */
+static int run_stream_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                           int H, int W, int kH, int kW, int sH, int sW,
+                           int num_frames, int groups) {
+    float **base = NULL, **g = NULL;
+
+    // Rank 0 generates or reads the base frame and the kernel
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            base = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!base || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(base, H, W);
+            generate_random_array(g, kH, kW);
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &base, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Frame-stream mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Every group root produces frames, so every rank keeps the base frame
+    if (rank != 0) {
+        base = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    double *checksum = (double*)calloc(num_frames, sizeof(double));
+    double *reference = (double*)calloc(num_frames, sizeof(double));
+    if (!base || !g || !checksum || !reference) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(base[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+
+    StreamStats framewise, pipelined;
+    StreamFrames sf = { base, NULL, reference };
+    MPI_Barrier(MPI_COMM_WORLD);
+    conv2d_stream_framewise_stats(num_frames, H, W, g, kH, kW, sH, sW, stream_source, stream_sink, &sf,
+                                  MPI_COMM_WORLD, &framewise);
+    sf.output_file = output_file;
+    sf.checksum = checksum;
+    MPI_Barrier(MPI_COMM_WORLD);
+    conv2d_stream_stats(num_frames, H, W, g, kH, kW, sH, sW, groups, stream_source, stream_sink, &sf,
+                        MPI_COMM_WORLD, &pipelined);
+
+    // Checksums live on the group roots
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : checksum, checksum, num_frames, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double max_diff = 0.0;
+        for (int k = 0; k < num_frames; k++) {
+            double d = fabs(checksum[k] - reference[k]);
+            if (d > max_diff) max_diff = d;
+        }
+        printf("Frame stream: %d frames of %dx%d, %dx%d kernel, stride %dx%d, %d group(s) of %d rank(s)\n",
+               num_frames, H, W, kH, kW, sH, sW, pipelined.groups, pipelined.group_size);
+        printf("\n");
+        printf("========================================\n");
+        printf("Pipelined vs Frame-at-a-time\n");
+        printf("========================================\n");
+        printf("%-16s %10s %10s %10s %10s %10s\n", "Engine", "Frames/s", "Mean (ms)", "p50 (ms)",
+               "p99 (ms)", "Max (ms)");
+        const StreamStats *rows[2] = { &framewise, &pipelined };
+        const char *names[2] = { "frame-at-a-time", "pipelined" };
+        for (int r = 0; r < 2; r++) {
+            printf("%-16s %10.2f %10.3f %10.3f %10.3f %10.3f\n", names[r], rows[r]->frames_per_second,
+                   rows[r]->latency_mean * 1e3, rows[r]->latency_p50 * 1e3, rows[r]->latency_p99 * 1e3,
+                   rows[r]->latency_max * 1e3);
+        }
+        printf("\n");
+        printf("Throughput gain:     %.2fx\n", framewise.frames_per_second > 0 ?
+               pipelined.frames_per_second / framewise.frames_per_second : 0.0);
+        printf("Rank 0 compute/wait: %.6f / %.6f s pipelined, %.6f / %.6f s frame-at-a-time\n",
+               pipelined.compute_time, pipelined.wait_time, framewise.compute_time, framewise.wait_time);
+        printf("Checksum difference: %.6g (max over frames)\n", max_diff);
+        printf("========================================\n");
+        if (output_file) printf("Output frames written as %s with the frame number appended\n", output_file);
+    }
+
+    free(checksum);
+    free(reference);
+    free_2d_array(base, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/**
+ * Backward mode: gradients with respect to the input and the kernel for a
+ * random upstream gradient, timed against the naive loops and checked
+ * against them and against finite differences
+ */
+static int run_backward_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                             int H, int W, int kH, int kW, int sH, int sW, int repeat) {
+    float **f = NULL, **g = NULL;
+
+    // Rank 0 generates or reads the data
+    if (rank == 0) {
+        if (H > 0 && W > 0 && kH > 0 && kW > 0) {
+            f = allocate_2d_array(H, W);
+            g = allocate_2d_array(kH, kW);
+            if (!f || !g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            generate_random_array(f, H, W);
+            generate_random_array(g, kH, kW);
+        } else if (input_file && kernel_file) {
+            if (read_array_from_file(input_file, &f, &H, &W) != 0 ||
+                read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            fprintf(stderr, "Error: Backward mode needs -H -W -kH -kW or -f/-g files\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {H, W, kH, kW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    H = dims[0]; W = dims[1]; kH = dims[2]; kW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+
+    if (rank != 0) {
+        f = allocate_2d_array(H, W);
+        g = allocate_2d_array(kH, kW);
+    }
+    float **grad_out = allocate_2d_array(out_H, out_W);
+    float **grad_in = allocate_2d_array(H, W);
+    float **grad_g = allocate_2d_array(kH, kW);
+    if (!f || !g || !grad_out || !grad_in || !grad_g) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0) generate_random_array(grad_out, out_H, out_W);
+    for (int i = 0; i < H; i++) {
+        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    for (int i = 0; i < out_H; i++) {
+        MPI_Bcast(grad_out[i], out_W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, in_stats, g_stats;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_grad_input_stats(grad_out, H, W, g, kH, kW, sH, sW, grad_in, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < in_stats.total_time) in_stats = stats;
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv2d_grad_kernel_stats(f, H, W, grad_out, kH, kW, sH, sW, grad_g, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < g_stats.total_time) g_stats = stats;
+    }
+
+    if (rank == 0) {
+        float **ref_in = allocate_2d_array(H, W);
+        float **ref_g = allocate_2d_array(kH, kW);
+        if (!ref_in || !ref_g) {
+            fprintf(stderr, "Error allocating memory\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        double t0 = MPI_Wtime();
+        conv2d_grad_input_serial(grad_out, H, W, g, kH, kW, sH, sW, ref_in);
+        double naive_in = MPI_Wtime() - t0;
+        t0 = MPI_Wtime();
+        conv2d_grad_kernel_serial(f, H, W, grad_out, kH, kW, sH, sW, ref_g);
+        double naive_g = MPI_Wtime() - t0;
+
+        double diff_in = 0.0, diff_g = 0.0;
+        for (int i = 0; i < H; i++) {
+            for (int j = 0; j < W; j++) {
+                double d = fabs(grad_in[i][j] - ref_in[i][j]);
+                if (d > diff_in) diff_in = d;
+            }
+        }
+        for (int i = 0; i < kH; i++) {
+            for (int j = 0; j < kW; j++) {
+                double d = fabs(grad_g[i][j] - ref_g[i][j]) / fmax(1.0, fabs(ref_g[i][j]));
+                if (d > diff_g) diff_g = d;
+            }
+        }
+
+        // Kernel taps need full-image losses; skip them when that is slow
+        double err_in, err_g;
+        int check_g = (double)out_H * out_W * kH * kW * kH * kW <= 2e9;
+        conv2d_grad_check(f, H, W, g, kH, kW, sH, sW, grad_out, grad_in,
+                          check_g ? grad_g : NULL, 1000, &err_in, &err_g);
+
+        printf("Backward pass: %dx%d input, %dx%d kernel, stride %dx%d, %dx%d upstream gradient\n",
+               H, W, kH, kW, sH, sW, out_H, out_W);
+        printf("\n");
+        printf("========================================\n");
+        printf("Gradients vs Naive Loops (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("Input gradient:      %.6f s (naive %.6f s, %.2fx), gather %.6f s, %.2f MB\n",
+               in_stats.total_time, naive_in, in_stats.total_time > 0 ? naive_in / in_stats.total_time : 0.0,
+               in_stats.communication_time, in_stats.bytes_communicated / (1024.0 * 1024.0));
+        printf("Kernel gradient:     %.6f s (naive %.6f s, %.2fx), MPI_Allreduce %.6f s, %lld bytes\n",
+               g_stats.total_time, naive_g, g_stats.total_time > 0 ? naive_g / g_stats.total_time : 0.0,
+               g_stats.communication_time, g_stats.bytes_communicated);
+        printf("Max difference:      %.6g input, %.6g kernel (relative) vs naive\n", diff_in, diff_g);
+        printf("Finite differences:  %.6g input (1000 pixels), ", err_in);
+        if (check_g) {
+            printf("%.6g kernel (all taps), relative\n", err_g);
+        } else {
+            printf("kernel skipped (full-image losses too slow at this size)\n");
+        }
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing input gradient to %s\n", output_file);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, grad_in, H, W, CONV2D_DTYPE_F32);
+            } else {
+                write_array_to_file(output_file, grad_in, H, W);
+            }
+        }
+        free_2d_array(ref_in, H);
+        free_2d_array(ref_g, kH);
+    }
+
+    free_2d_array(grad_out, out_H);
+    free_2d_array(grad_in, H);
+    free_2d_array(grad_g, kH);
+    free_2d_array(f, H);
+    free_2d_array(g, kH);
+    return 0;
+}
+
+/**
+ * Volume mode: 3D convolution of a D x H x W volume, timed against the naive
+ * loop nest on rank 0 and checked against it
+ */
+static int run_volume_mode(int rank, char *input_file, char *kernel_file, char *output_file,
+                           int D, int H, int W, int kD, int kH, int kW, int sD, int sH, int sW, int repeat) {
+    float *f = NULL, *g = NULL;
+
+    // Rank 0 generates or reads the volume; the kernel is random unless given
+    if (rank == 0) {
+        if (input_file) {
+            if (read_volume_from_file(input_file, &f, &D, &H, &W) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else if (D > 0 && H > 0 && W > 0) {
+            f = (float*)malloc((size_t)D * H * W * sizeof(float));
+            if (!f) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            srand((unsigned int)time(NULL));
+            for (size_t i = 0; i < (size_t)D * H * W; i++) f[i] = (float)rand() / (float)RAND_MAX;
+        } else {
+            fprintf(stderr, "Error: Volume mode needs -D -H -W or a binary volume file -f\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        if (kernel_file) {
+            if (read_volume_from_file(kernel_file, &g, &kD, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else if (kD > 0 && kH > 0 && kW > 0) {
+            g = (float*)malloc((size_t)kD * kH * kW * sizeof(float));
+            if (!g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            for (int i = 0; i < kD * kH * kW; i++) g[i] = (float)rand() / (float)RAND_MAX;
+        } else {
+            fprintf(stderr, "Error: Volume mode needs -kD -kH -kW or a binary volume kernel -g\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[6] = {D, H, W, kD, kH, kW};
+    MPI_Bcast(dims, 6, MPI_INT, 0, MPI_COMM_WORLD);
+    D = dims[0]; H = dims[1]; W = dims[2]; kD = dims[3]; kH = dims[4]; kW = dims[5];
+    if (sD <= 0 || sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%dx%d\n", sD, sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int out_D = (D + sD - 1) / sD;
+    int out_H = (H + sH - 1) / sH;
+    int out_W = (W + sW - 1) / sW;
+    size_t out_n = (size_t)out_D * out_H * out_W;
+
+    float *output = NULL;
+    if (rank != 0) {
+        g = (float*)malloc((size_t)kD * kH * kW * sizeof(float));
+    } else {
+        output = (float*)malloc(out_n * sizeof(float));
+    }
+    if (!g || (rank == 0 && !output)) {
+        fprintf(stderr, "Error allocating memory\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Bcast(g, kD * kH * kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    if (repeat < 1) repeat = 1;
+
+    PerfStats stats, best;
+    for (int r = 0; r < repeat; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        conv3d_stride_stats(f, D, H, W, g, kD, kH, kW, sD, sH, sW, output, MPI_COMM_WORLD, &stats);
+        if (r == 0 || stats.total_time < best.total_time) best = stats;
+    }
+    long long bytes = 0;
+    MPI_Reduce(&best.bytes_communicated, &bytes, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        printf("Volume: %dx%dx%d input, %dx%dx%d kernel, stride %dx%dx%d, %dx%dx%d output\n",
+               D, H, W, kD, kH, kW, sD, sH, sW, out_D, out_H, out_W);
+        printf("\n");
+        printf("========================================\n");
+        printf("3D Convolution (best of %d)\n", repeat);
+        printf("========================================\n");
+        printf("conv3d_stride:       %.6f s (compute %.6f s, communication %.6f s, gather %.6f s)\n",
+               best.total_time, best.computation_time, best.communication_time, best.broadcast_time);
+        printf("Communicated:        %.2f MB (scatter, halo slices and gather, all ranks)\n",
+               bytes / (1024.0 * 1024.0));
+        printf("Load imbalance:      %.2f%% (equal slabs %.2f%%)\n",
+               best.load_imbalance_after * 100.0, best.load_imbalance_before * 100.0);
+
+        // The naive loop nest is only worth waiting for on small volumes
+        if ((double)out_n * kD * kH * kW <= 4e9) {
+            float *reference = (float*)malloc(out_n * sizeof(float));
+            if (!reference) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            double t0 = MPI_Wtime();
+            conv3d_serial_stride(f, D, H, W, g, kD, kH, kW, sD, sH, sW, reference);
+            double naive = MPI_Wtime() - t0;
+            double diff = 0.0;
+            for (size_t i = 0; i < out_n; i++) {
+                double d = fabs(output[i] - reference[i]);
+                if (d > diff) diff = d;
+            }
+            printf("Naive loop nest:     %.6f s (%.2fx), max difference %.6g\n",
+                   naive, best.total_time > 0 ? naive / best.total_time : 0.0, diff);
+            free(reference);
+        } else {
+            printf("Naive loop nest:     skipped (too slow at this size)\n");
+        }
+        printf("========================================\n");
+
+        if (output_file) {
+            printf("Writing output volume to %s\n", output_file);
+            write_volume_to_binary(output_file, output, out_D, out_H, out_W, CONV2D_DTYPE_F32);
+        }
+    }
+
+    free(output);
+    free(f);
+    free(g);
+    return 0;
+}
+
+/**
+ * Batch mode: convolve every input of a directory or manifest with one kernel
+ */
+static int run_batch_mode(int rank, char *batch_source, char *kernel_file, char *output_dir,
+                          int kH, int kW, int sH, int sW, long long split_pixels) {
+    float **g = NULL;
+    if (rank == 0) {
+        if (kernel_file) {
+            if (read_array_from_file(kernel_file, &g, &kH, &kW) != 0) {
+                fprintf(stderr, "Error reading files\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else if (kH > 0 && kW > 0) {
+            g = allocate_2d_array(kH, kW);
+            generate_random_array(g, kH, kW);
+        } else {
+            fprintf(stderr, "Error: Batch mode needs -g FILE or -kH/-kW for the kernel\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    int dims[4] = {kH, kW, sH, sW};
+    MPI_Bcast(dims, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    kH = dims[0]; kW = dims[1]; sH = dims[2]; sW = dims[3];
+    if (sH <= 0 || sW <= 0) {
+        if (rank == 0) fprintf(stderr, "Error: Invalid stride %dx%d\n", sH, sW);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank != 0) g = allocate_2d_array(kH, kW);
+    for (int i = 0; i < kH; i++) {
+        MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    }
+
+    BatchStats stats;
+    int status = conv2d_batch_run(batch_source, g, kH, kW, sH, sW, split_pixels,
+                                  output_dir, MPI_COMM_WORLD, &stats);
+
+    if (rank == 0 && stats.images + stats.failures > 0) {
+        printf("\n");
+        printf("========================================\n");
+        printf("Batch Statistics\n");
+        printf("========================================\n");
+        printf("Images:              %d (%d whole per rank, %d row split, %d failed)\n",
+               stats.images, stats.small_images, stats.large_images, stats.failures);
+        printf("Total time:          %.6f seconds\n", stats.total_time);
+        printf("Throughput:          %.2f images/s\n", stats.images_per_second);
+        printf("Latency mean:        %.6f seconds\n", stats.latency_mean);
+        printf("Latency p50:         %.6f seconds\n", stats.latency_p50);
+        printf("Latency p90:         %.6f seconds\n", stats.latency_p90);
+        printf("Latency p99:         %.6f seconds\n", stats.latency_p99);
+        printf("Latency max:         %.6f seconds\n", stats.latency_max);
+        printf("========================================\n");
+    }
+
+    free_2d_array(g, kH);
+    return status;
+}
+
+/**
+ * Free the per-thread scratch arenas, then shut MPI down
+ */
+static void finalize(void) {
+    conv2d_arena_release_all();
+    MPI_Finalize();
 }
 
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+    // The frame-stream engine calls MPI from the master thread of a parallel
+    // region; with less thread support it falls back to one frame at a time
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        fprintf(stderr, "Warning: MPI provides thread level %d, below MPI_THREAD_FUNNELED\n", provided);
+    }
 
     // Command line arguments
     char *input_file = NULL;
@@ -40,8 +2105,37 @@ int main(int argc, char **argv) {
     char *output_file = NULL;
     int H = 0, W = 0, kH = 0, kW = 0;
     int sH = 1, sW = 1;  // Default stride
+    int dH = 1, dW = 1;  // Default dilation
     int num_threads = 0;
     char *mode = "hybrid";
+    int calibrate = 0;
+    int tune = 0, force_tune = 0;
+    char *tune_cache = NULL;
+    char *cache_dir = NULL;
+    long long cache_max_mb = CONV2D_CACHE_MAX_MB;
+    char *bank_path = NULL;
+    int bank_size = 0, bank_compare = 0;
+    int C_in = 0, C_out = 0, depthwise = 0, mc_split = MC_SPLIT_SPATIAL;
+    char *batch_source = NULL;
+    long long batch_split = BATCH_SPLIT_PIXELS;
+    int repeat = 1;
+    int dtype = CONV2D_DTYPE_F32;
+    int quant = 0, quant_signed = 0, quant_bits = 8, quant_out = CONV2D_QOUT_FLOAT;
+    int skip_zero = 0, skip_tile = CONV2D_SKIP_TILE;
+    char *dirty_spec = NULL;
+    double density = 0.1;
+    Conv2dEpilogue epilogue;
+    conv2d_epilogue_default(&epilogue);
+    int use_epilogue = 0, pool = 0;
+    char *chain_spec = NULL;
+    char *roi_spec = NULL;
+    int num_frames = 0, stream_groups = 0;
+    int backward = 0;
+    int volume = 0, D = 0, kD = 0, sD = 1;
+    int iterate_steps = 0, iter_block = CONV2D_ITER_BLOCK, iter_tile = CONV2D_ITER_TILE;
+    int want_stats = 0, stats_only = 0, hist_bins = CONV2D_HIST_BINS;
+    char *hist_range = NULL;
+    int chain_tile = CONV2D_CHAIN_TILE;
 
     // Manual parsing for all arguments
     for (int i = 1; i < argc; i++) {
@@ -72,19 +2166,181 @@ int main(int argc, char **argv) {
         } else if (strcmp(argv[i], "-sW") == 0 && i + 1 < argc) {
             sW = atoi(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "-dH") == 0 && i + 1 < argc) {
+            dH = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-dW") == 0 && i + 1 < argc) {
+            dW = atoi(argv[i + 1]);
+            i++;
         } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
             num_threads = atoi(argv[i + 1]);
             i++;
         } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
             mode = argv[i + 1];
             i++;
+        } else if (strcmp(argv[i], "--calibrate") == 0) {
+            calibrate = 1;
+        } else if (strcmp(argv[i], "--tune") == 0) {
+            tune = 1;
+        } else if (strcmp(argv[i], "--retune") == 0) {
+            tune = 1;
+            force_tune = 1;
+        } else if (strcmp(argv[i], "--no-tune") == 0) {
+            tune = 0;
+            force_tune = 0;
+        } else if (strcmp(argv[i], "--tune-cache") == 0 && i + 1 < argc) {
+            tune_cache = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--bank") == 0 && i + 1 < argc) {
+            bank_path = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--bank-size") == 0 && i + 1 < argc) {
+            bank_size = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--bank-compare") == 0) {
+            bank_compare = 1;
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            C_in = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) {
+            C_out = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--depthwise") == 0) {
+            depthwise = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_source = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--batch-split") == 0 && i + 1 < argc) {
+            batch_split = atoll(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--dtype") == 0 && i + 1 < argc) {
+            dtype = conv2d_dtype_from_name(argv[i + 1]);
+            if (dtype < 0) {
+                if (rank == 0) fprintf(stderr, "Error: Unknown --dtype %s (use f32, f16 or bf16)\n", argv[i + 1]);
+                finalize();
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--quant") == 0 && i + 1 < argc) {
+            quant = 1;
+            quant_signed = strcmp(argv[i + 1], "i8") == 0;
+            i++;
+        } else if (strcmp(argv[i], "--qweights") == 0 && i + 1 < argc) {
+            quant_bits = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--qout") == 0 && i + 1 < argc) {
+            quant_out = strcmp(argv[i + 1], "u8") == 0 ? CONV2D_QOUT_U8 :
+                        strcmp(argv[i + 1], "i8") == 0 ? CONV2D_QOUT_I8 : CONV2D_QOUT_FLOAT;
+            i++;
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--cache-max-mb") == 0 && i + 1 < argc) {
+            cache_max_mb = atoll(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--dirty") == 0 && i + 1 < argc) {
+            dirty_spec = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--skip-zero") == 0) {
+            skip_zero = 1;
+        } else if (strcmp(argv[i], "--skip-tile") == 0 && i + 1 < argc) {
+            skip_tile = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+            density = atof(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--sparse-threshold") == 0 && i + 1 < argc) {
+            conv2d_set_sparse_threshold(atof(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--box-blocks") == 0 && i + 1 < argc) {
+            conv2d_set_box_max_blocks(atoi(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--chain") == 0 && i + 1 < argc) {
+            chain_spec = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--chain-tile") == 0 && i + 1 < argc) {
+            chain_tile = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--volume") == 0) {
+            volume = 1;
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            D = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-kD") == 0 && i + 1 < argc) {
+            kD = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-sD") == 0 && i + 1 < argc) {
+            sD = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--backward") == 0) {
+            backward = 1;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            num_frames = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--groups") == 0 && i + 1 < argc) {
+            stream_groups = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--iterate") == 0 && i + 1 < argc) {
+            iterate_steps = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--iter-block") == 0 && i + 1 < argc) {
+            iter_block = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--iter-tile") == 0 && i + 1 < argc) {
+            iter_tile = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--roi") == 0 && i + 1 < argc) {
+            roi_spec = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            want_stats = 1;
+        } else if (strcmp(argv[i], "--stats-only") == 0) {
+            want_stats = 1;
+            stats_only = 1;
+        } else if (strcmp(argv[i], "--hist") == 0 && i + 1 < argc) {
+            hist_bins = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--hist-range") == 0 && i + 1 < argc) {
+            hist_range = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--bias") == 0 && i + 1 < argc) {
+            epilogue.bias = atof(argv[i + 1]);
+            use_epilogue = 1;
+            i++;
+        } else if (strcmp(argv[i], "--act") == 0 && i + 1 < argc) {
+            epilogue.activation = conv2d_activation_from_name(argv[i + 1]);
+            use_epilogue = 1;
+            i++;
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            epilogue.alpha = atof(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            epilogue.scale = atof(argv[i + 1]);
+            use_epilogue = 1;
+            i++;
+        } else if (strcmp(argv[i], "--clamp") == 0 && i + 1 < argc) {
+            if (sscanf(argv[i + 1], "%f,%f", &epilogue.clamp_min, &epilogue.clamp_max) != 2) {
+                epilogue.clamp_min = 1.0f;
+                epilogue.clamp_max = 0.0f;
+            }
+            use_epilogue = 1;
+            i++;
+        } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+            pool = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+            mc_split = strcmp(argv[i + 1], "channels") == 0 ? MC_SPLIT_CHANNELS : MC_SPLIT_SPATIAL;
+            i++;
         }
     }
 
     // Handle help
     if (argc == 1 || (argc == 2 && strcmp(argv[1], "--help") == 0)) {
         if (rank == 0) print_usage(argv[0]);
-        MPI_Finalize();
+        finalize();
         return 0;
     }
 
@@ -93,6 +2349,138 @@ int main(int argc, char **argv) {
         omp_set_num_threads(num_threads);
     }
 
+    // The pointwise epilogue is applied by every engine
+    if (epilogue.activation < 0 || epilogue.clamp_min > epilogue.clamp_max) {
+        if (rank == 0) fprintf(stderr, "Error: --act must be none, relu or leaky and --clamp LO,HI needs LO <= HI\n");
+        finalize();
+        return 1;
+    }
+    // The gradients are of the plain convolution; a fused epilogue has no
+    // backward pass here
+    if (backward && (use_epilogue || pool)) {
+        if (rank == 0) fprintf(stderr, "Error: --bias, --act, --scale, --clamp and --pool cannot be used with --backward\n");
+        finalize();
+        return 1;
+    }
+    if (use_epilogue) conv2d_set_epilogue(&epilogue);
+
+    // Pooling, dilation and 16-bit storage exist for the four basic modes
+    // only; every other mode runs its own engine and would ignore them
+    int special_mode = bank_path || bank_size > 0 || batch_source || quant || volume || backward ||
+                       num_frames > 0 || iterate_steps > 0 || roi_spec || want_stats || chain_spec ||
+                       dirty_spec || skip_zero || C_in > 0;
+    int basic_mode = strcmp(mode, "serial") == 0 || strcmp(mode, "omp") == 0 ||
+                     strcmp(mode, "mpi") == 0 || strcmp(mode, "hybrid") == 0;
+
+    // Fused pooling exists for the four basic modes
+    if (pool != 0 && (pool != 2 || dH != 1 || dW != 1 || special_mode || dtype != CONV2D_DTYPE_F32 || !basic_mode)) {
+        if (rank == 0) fprintf(stderr, "Error: --pool 2 needs mode serial, omp, mpi or hybrid without dilation\n");
+        finalize();
+        return 1;
+    }
+
+    // Dilated engines exist for the four basic modes
+    int dilated = dH != 1 || dW != 1;
+    if (dH < 1 || dW < 1 || (dilated && (special_mode || dtype != CONV2D_DTYPE_F32 || !basic_mode))) {
+        if (rank == 0) fprintf(stderr, "Error: Dilation %dx%d needs mode serial, omp, mpi or hybrid\n", dH, dW);
+        finalize();
+        return 1;
+    }
+
+    // 16-bit storage has a hybrid engine only
+    if (dtype != CONV2D_DTYPE_F32 && (special_mode || strcmp(mode, "hybrid") != 0)) {
+        if (rank == 0) fprintf(stderr, "Error: --dtype %s needs mode hybrid\n", conv2d_dtype_name(dtype));
+        finalize();
+        return 1;
+    }
+
+    if (bank_path || bank_size > 0) {
+        run_bank_mode(rank, input_file, bank_path, output_file,
+                      H, W, kH, kW, sH, sW, bank_size, bank_compare);
+        finalize();
+        return 0;
+    }
+
+    if (batch_source) {
+        int status = run_batch_mode(rank, batch_source, kernel_file, output_file,
+                                    kH, kW, sH, sW, batch_split);
+        finalize();
+        return status == 0 ? 0 : 1;
+    }
+
+    if (quant) {
+        run_quant_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW,
+                       quant_signed, quant_bits, quant_out, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (volume) {
+        run_volume_mode(rank, input_file, kernel_file, output_file, D, H, W, kD > 0 ? kD : kH, kH, kW,
+                        sD, sH, sW, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (backward) {
+        run_backward_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (num_frames > 0) {
+        run_stream_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW,
+                        num_frames, stream_groups);
+        finalize();
+        return 0;
+    }
+
+    if (iterate_steps > 0) {
+        run_iterate_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW,
+                         iterate_steps, iter_block, iter_tile, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (roi_spec) {
+        run_roi_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW, roi_spec, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (want_stats) {
+        run_stats_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW,
+                       hist_bins, hist_range, stats_only, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (chain_spec) {
+        run_chain_mode(rank, input_file, output_file, H, W, chain_spec, chain_tile, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (dirty_spec) {
+        run_dirty_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW,
+                       dirty_spec, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (skip_zero) {
+        run_skip_mode(rank, input_file, kernel_file, output_file, H, W, kH, kW, sH, sW,
+                      density, skip_tile, repeat);
+        finalize();
+        return 0;
+    }
+
+    if (C_in > 0) {
+        run_mc_mode(rank, H, W, kH, kW, sH, sW, C_in, C_out, depthwise, mc_split);
+        finalize();
+        return 0;
+    }
+
     // Variables for arrays
     float **f = NULL, **g = NULL, **output = NULL;
     int f_rows, f_cols, g_rows, g_cols;
@@ -117,7 +2505,10 @@ int main(int argc, char **argv) {
             f_rows = H; f_cols = W;
             g_rows = kH; g_cols = kW;
 
-            if (input_file) write_array_to_file(input_file, f, H, W);
+            if (input_file) {
+                if (is_binary_filename(input_file)) write_array_to_binary(input_file, f, H, W, dtype);
+                else write_array_to_file(input_file, f, H, W);
+            }
             if (kernel_file) write_array_to_file(kernel_file, g, kH, kW);
 
         } else if (input_file && kernel_file) {
@@ -154,15 +2545,76 @@ int main(int argc, char **argv) {
         }
     }
 
-    // Allocate arrays on all processes
+    // Result cache: rank 0 hashes the data it holds and looks the key up; on
+    // a hit nothing is broadcast or computed
+    int use_cache = cache_dir && dtype == CONV2D_DTYPE_F32 && !pool;
+    uint64_t cache_key = 0;
+    if (cache_dir && !use_cache && rank == 0) {
+        if (pool) fprintf(stderr, "Warning: --cache-dir ignored with --pool\n");
+        else fprintf(stderr, "Warning: --cache-dir ignored with --dtype %s\n", conv2d_dtype_name(dtype));
+    }
+    if (use_cache) {
+        int hit = 0;
+        Conv2dCacheEntry entry;
+        double t_lookup = MPI_Wtime();
+        if (rank == 0) {
+            double t_hash = MPI_Wtime();
+            if (conv2d_cache_key(f, H, W, g, kH, kW, sH, sW, dH, dW, &cache_key) != 0) {
+                // Only rank 0 looks up and stores, so the others need not know
+                fprintf(stderr, "Warning: Cannot hash the input, result cache skipped\n");
+                use_cache = 0;
+            } else {
+                t_hash = MPI_Wtime() - t_hash;
+                hit = conv2d_cache_lookup(cache_dir, cache_key, (H + sH - 1) / sH, (W + sW - 1) / sW, &entry);
+                printf("Result cache %s: key %016llx (hash %.6f seconds)\n", hit ? "hit" : "miss",
+                       (unsigned long long)cache_key, t_hash);
+            }
+        }
+        MPI_Bcast(&hit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (hit) {
+            if (rank == 0) {
+                printf("Total time: %.6f seconds (no broadcast or computation)\n", MPI_Wtime() - t_lookup);
+                if (output_file) {
+                    printf("Writing output to %s\n", output_file);
+                    if (is_binary_filename(output_file)) {
+                        write_array_to_binary(output_file, entry.output, entry.rows, entry.cols, dtype);
+                    } else {
+                        write_array_to_file(output_file, entry.output, entry.rows, entry.cols);
+                    }
+                }
+                conv2d_cache_release(&entry);
+                free_2d_array(f, H);
+                free_2d_array(g, kH);
+            }
+            finalize();
+            return 0;
+        }
+    }
+
+    // Allocate arrays on all processes (16-bit storage keeps only the
+    // converted input on the other ranks)
     if (rank != 0) {
-        f = allocate_2d_array(H, W);
+        if (dtype == CONV2D_DTYPE_F32) f = allocate_2d_array(H, W);
         g = allocate_2d_array(kH, kW);
     }
 
     // Broadcast input data
-    for (int i = 0; i < H; i++) {
-        MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    uint16_t *f_half = NULL, *output_half = NULL;
+    if (dtype != CONV2D_DTYPE_F32) {
+        f_half = (uint16_t*)malloc((size_t)H * W * sizeof(uint16_t));
+        output_half = (uint16_t*)malloc((size_t)((H + sH - 1) / sH) * ((W + sW - 1) / sW) * sizeof(uint16_t));
+        if (!f_half || !output_half) {
+            fprintf(stderr, "Error allocating 16-bit buffers\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int i = 0; i < H; i++) {
+            if (rank == 0) conv2d_float_to_half(f[i], f_half + (size_t)i * W, W, dtype);
+            MPI_Bcast(f_half + (size_t)i * W, W, MPI_UINT16_T, 0, MPI_COMM_WORLD);
+        }
+    } else {
+        for (int i = 0; i < H; i++) {
+            MPI_Bcast(f[i], W, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        }
     }
     for (int i = 0; i < kH; i++) {
         MPI_Bcast(g[i], kW, MPI_FLOAT, 0, MPI_COMM_WORLD);
@@ -171,34 +2623,187 @@ int main(int argc, char **argv) {
     // Calculate output size
     int out_H = (H + sH - 1) / sH;
     int out_W = (W + sW - 1) / sW;
-    output = allocate_2d_array(out_H, out_W);
+
+    // With fused pooling the result is the pooled array; only the unfused
+    // serial reference stores the full-resolution output. With 16-bit storage
+    // the engine writes output_half, and only rank 0 widens it to fp32.
+    if ((!pool || strcmp(mode, "serial") == 0) && (!f_half || rank == 0)) {
+        output = allocate_2d_array(out_H, out_W);
+    }
+    int pool_H = (out_H + 1) / 2;
+    int pool_W = (out_W + 1) / 2;
+    float **pooled = pool ? allocate_2d_array(pool_H, pool_W) : NULL;
+    float **result = pool ? pooled : output;
+    int result_H = pool ? pool_H : out_H;
+    int result_W = pool ? pool_W : out_W;
 
     // Timing and performance statistics
     struct timespec start, end;
     double elapsed;
     PerfStats stats;
 
+    // With --tune, pick the OpenMP schedule and block size: cached or freshly
+    // tuned on rank 0. All ranks use rank 0's choice.
+    int uses_threads = strcmp(mode, "serial") != 0 && strcmp(mode, "mpi") != 0;
+    if (uses_threads && tune) {
+        TuneParams params;
+        int tune_dims[3];
+        int from_cache = 0;
+        double tune_time = MPI_Wtime();
+        if (rank == 0) {
+            from_cache = conv2d_autotune(f, H, W, g, kH, kW, sH, sW, force_tune, tune_cache, &params);
+            if (from_cache < 0) {
+                fprintf(stderr, "Warning: Autotuning failed, keeping the current schedule\n");
+                conv2d_get_tune_params(&params);
+            }
+            tune_dims[0] = params.block_size;
+            tune_dims[1] = (int)params.schedule;
+            tune_dims[2] = params.chunk_size;
+        }
+        MPI_Bcast(tune_dims, 3, MPI_INT, 0, MPI_COMM_WORLD);
+        params.block_size = tune_dims[0];
+        params.schedule = (omp_sched_t)tune_dims[1];
+        params.chunk_size = tune_dims[2];
+        conv2d_set_tune_params(&params);
+        tune_time = MPI_Wtime() - tune_time;
+
+        if (rank == 0) {
+            const char *sched_name = params.schedule == omp_sched_static ? "static" :
+                                     params.schedule == omp_sched_guided ? "guided" : "dynamic";
+            printf("Tuning: schedule(%s, %d), block size %d (%s, %.3f seconds)\n",
+                   sched_name, params.chunk_size, params.block_size,
+                   from_cache == 1 ? "cached" : from_cache == 0 ? "tuned" : "defaults", tune_time);
+        }
+    }
+
+    // Optional speed calibration so slower ranks get fewer rows
+    if (calibrate) {
+        // The weights must be measured on the dense loop the partitioner
+        // models: check the calibration kernel is not a box or sparse kernel
+        if (rank == 0) {
+            float **cal_g = allocate_2d_array(CALIBRATION_KERNEL, CALIBRATION_KERNEL);
+            BoxKernel cal_box;
+            if (!cal_g) {
+                fprintf(stderr, "Error allocating memory\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            conv2d_calibration_kernel(cal_g, CALIBRATION_KERNEL);
+            int boxed = conv2d_box_compile(cal_g, CALIBRATION_KERNEL, CALIBRATION_KERNEL, BOX_MAX_BLOCKS, &cal_box) == 0;
+            if (boxed) conv2d_box_free(&cal_box);
+            double density = conv2d_kernel_density(cal_g, CALIBRATION_KERNEL, CALIBRATION_KERNEL);
+            free_2d_array(cal_g, CALIBRATION_KERNEL);
+            if (boxed || density <= SPARSE_DENSITY_THRESHOLD) {
+                fprintf(stderr, "Error: Calibration kernel would not use the dense engine\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+        if (conv2d_calibrate_rank_weights(MPI_COMM_WORLD) != 0 && rank == 0) {
+            fprintf(stderr, "Warning: Calibration failed, using uniform rank weights\n");
+        }
+    }
+
     MPI_Barrier(MPI_COMM_WORLD);
 
     if (rank == 0) {
         printf("Running %s mode: MPI processes=%d, OpenMP threads=%d\n",
                mode, size, omp_get_max_threads());
+        if (f_half) {
+            printf("Storage: %s with fp32 accumulation (%s)\n", conv2d_dtype_name(dtype),
+                   dtype == CONV2D_DTYPE_BF16 ? "shift conversion" :
+                   conv2d_half_has_f16c() ? "F16C conversion" : "scalar conversion");
+        }
         printf("Input size: %dx%d, Kernel: %dx%d, Stride: %dx%d\n",
                H, W, kH, kW, sH, sW);
+        if (dilated) printf("Dilation: %dx%d\n", dH, dW);
         printf("Output size: %dx%d\n", out_H, out_W);
+        if (use_epilogue) {
+            printf("Epilogue: bias %g, activation %s", epilogue.bias, conv2d_activation_name(epilogue.activation));
+            if (epilogue.activation == CONV2D_ACT_LEAKY_RELU) printf(" (alpha %g)", epilogue.alpha);
+            printf(", scale %g", epilogue.scale);
+            if (epilogue.clamp_min > -FLT_MAX || epilogue.clamp_max < FLT_MAX) {
+                printf(", clamp [%g, %g]", epilogue.clamp_min, epilogue.clamp_max);
+            }
+            printf("\n");
+        }
+        if (pool) {
+            printf("Pooling: 2x2 max, stride 2 (%s), pooled output %dx%d\n",
+                   strcmp(mode, "serial") == 0 ? "separate pass" : "fused", pool_H, pool_W);
+        }
+        if (!f_half && !dilated && (strcmp(mode, "omp") == 0 || strcmp(mode, "hybrid") == 0)) {
+            BoxKernel box;
+            if (conv2d_box_select(g, kH, kW, sH, sW, &box)) {
+                printf("Kernel: %d constant rectangle%s covering %d taps (summed-area table engine)\n",
+                       box.num_blocks, box.num_blocks == 1 ? "" : "s", box.nnz);
+                conv2d_box_free(&box);
+            } else {
+                double density = conv2d_kernel_density(g, kH, kW);
+                printf("Kernel density: %.3f (%s engine, threshold %.2f)\n", density,
+                       conv2d_get_sparse_threshold() > 0 && density <= conv2d_get_sparse_threshold() ?
+                       "tap-list" : "dense",
+                       conv2d_get_sparse_threshold());
+            }
+        }
     }
 
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    if (strcmp(mode, "serial") == 0 && rank == 0) {
-        conv2d_serial_stride(f, H, W, g, kH, kW, sH, sW, output);
-    } else if (strcmp(mode, "omp") == 0 && rank == 0) {
-        conv2d_omp_stride(f, H, W, g, kH, kW, sH, sW, output);
-    } else if (strcmp(mode, "mpi") == 0) {
-        conv2d_mpi_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+    // Plan mode: create once, execute --repeat times
+    int is_plan = (strcmp(mode, "plan") == 0);
+    double plan_create_time = 0.0, plan_first_time = 0.0, plan_rest_time = 0.0;
+    if (is_plan) {
+        if (repeat < 1) repeat = 1;
+        double t0 = MPI_Wtime();
+        Conv2dPlan *plan = conv2d_plan_create(H, W, kH, kW, sH, sW, MPI_COMM_WORLD, CONV2D_PLAN_DEFAULT);
+        if (!plan) MPI_Abort(MPI_COMM_WORLD, 1);
+        plan_create_time = MPI_Wtime() - t0;
+        for (int r = 0; r < repeat; r++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            t0 = MPI_Wtime();
+            conv2d_execute(plan, f, g, output);
+            MPI_Barrier(MPI_COMM_WORLD);
+            if (r == 0) plan_first_time = MPI_Wtime() - t0;
+            else plan_rest_time += MPI_Wtime() - t0;
+        }
+        if (rank == 0) conv2d_plan_print(plan);
+        conv2d_plan_destroy(plan);
     } else {
-        // hybrid (default)
-        conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+        // Repeated runs reuse the scratch arena; stats describe the last run
+        for (int r = 0; r < (repeat > 1 ? repeat : 1); r++) {
+            if (f_half) {
+                conv2d_stride_half_stats(f_half, H, W, dtype, g, kH, kW, sH, sW, output_half,
+                                         MPI_COMM_WORLD, &stats);
+            } else if (pool) {
+                if (strcmp(mode, "serial") == 0 && rank == 0) {
+                    conv2d_serial_stride(f, H, W, g, kH, kW, sH, sW, output);
+                    conv2d_maxpool2x2(output, out_H, out_W, pooled);
+                } else if (strcmp(mode, "omp") == 0 && rank == 0) {
+                    conv2d_stride_pool(f, H, W, g, kH, kW, sH, sW, pooled, MPI_COMM_SELF);
+                } else if (strcmp(mode, "mpi") == 0 || strcmp(mode, "hybrid") == 0) {
+                    conv2d_stride_pool_stats(f, H, W, g, kH, kW, sH, sW, pooled, MPI_COMM_WORLD, &stats);
+                }
+            } else if (dilated) {
+                if (strcmp(mode, "serial") == 0 && rank == 0) {
+                    conv2d_serial_dilated(f, H, W, g, kH, kW, sH, sW, dH, dW, output);
+                } else if (strcmp(mode, "omp") == 0 && rank == 0) {
+                    conv2d_omp_dilated(f, H, W, g, kH, kW, sH, sW, dH, dW, output);
+                } else if (strcmp(mode, "mpi") == 0) {
+                    conv2d_mpi_dilated_stats(f, H, W, g, kH, kW, sH, sW, dH, dW, output, MPI_COMM_WORLD, &stats);
+                } else if (strcmp(mode, "hybrid") == 0) {
+                    conv2d_stride_dilated_stats(f, H, W, g, kH, kW, sH, sW, dH, dW, output, MPI_COMM_WORLD, &stats);
+                }
+            } else if (strcmp(mode, "serial") == 0 && rank == 0) {
+                conv2d_serial_stride(f, H, W, g, kH, kW, sH, sW, output);
+            } else if (strcmp(mode, "omp") == 0 && rank == 0) {
+                conv2d_omp_stride(f, H, W, g, kH, kW, sH, sW, output);
+            } else if (strcmp(mode, "mpi") == 0) {
+                conv2d_mpi_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+            } else if (strcmp(mode, "dynamic") == 0) {
+                conv2d_stride_dynamic_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+            } else if (strcmp(mode, "serial") != 0 && strcmp(mode, "omp") != 0) {
+                // hybrid (default)
+                conv2d_stride_stats(f, H, W, g, kH, kW, sH, sW, output, MPI_COMM_WORLD, &stats);
+            }
+        }
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
@@ -206,9 +2811,22 @@ int main(int argc, char **argv) {
 
     elapsed = get_time_diff(start, end);
 
+    // Collect per-rank chunk counts and idle time for the dynamic mode
+    int is_dynamic = (strcmp(mode, "dynamic") == 0);
+    int *rank_chunks = NULL;
+    double *rank_idle = NULL;
+    if (is_dynamic) {
+        if (rank == 0) {
+            rank_chunks = (int*)malloc(size * sizeof(int));
+            rank_idle = (double*)malloc(size * sizeof(double));
+        }
+        MPI_Gather(&stats.chunks_claimed, 1, MPI_INT, rank_chunks, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Gather(&stats.idle_time, 1, MPI_DOUBLE, rank_idle, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+
     if (rank == 0) {
-        // Print detailed performance statistics for MPI and Hybrid modes
-        if (strcmp(mode, "mpi") == 0 || strcmp(mode, "hybrid") == 0) {
+        // Print detailed performance statistics for MPI, Hybrid and Dynamic modes
+        if (strcmp(mode, "mpi") == 0 || strcmp(mode, "hybrid") == 0 || is_dynamic) {
             printf("\n");
             printf("========================================\n");
             printf("Performance Statistics\n");
@@ -227,22 +2845,83 @@ int main(int argc, char **argv) {
             printf("  - MPI_Bcast calls: %d\n", stats.num_communications);
             printf("  - Bytes transferred: %.2f MB\n", stats.bytes_communicated / (1024.0 * 1024.0));
             printf("  - Output elements: %lld\n", stats.output_elements);
+            printf("\n");
+            if (f_half) {
+                // Widen the result and compare with the fp32 serial reference
+                float **reference = allocate_2d_array(out_H, out_W);
+                conv2d_serial_stride(f, H, W, g, kH, kW, sH, sW, reference);
+                double max_abs = 0.0, max_ref = 0.0;
+                for (int i = 0; i < out_H; i++) {
+                    conv2d_half_to_float(output_half + (size_t)i * out_W, output[i], out_W, dtype);
+                    for (int j = 0; j < out_W; j++) {
+                        double err = fabs((double)output[i][j] - reference[i][j]);
+                        if (err > max_abs) max_abs = err;
+                        if (fabs(reference[i][j]) > max_ref) max_ref = fabs(reference[i][j]);
+                    }
+                }
+                free_2d_array(reference, out_H);
+                printf("Precision (%s vs fp32 serial):\n", conv2d_dtype_name(dtype));
+                printf("  - Max abs error:   %.6g\n", max_abs);
+                printf("  - Max rel error:   %.6g (of max |output| %.6g)\n",
+                       max_ref > 0 ? max_abs / max_ref : 0.0, max_ref);
+                printf("\n");
+            }
+            printf("Scratch Memory (rank 0):\n");
+            printf("  - Arena allocations: %lld (%.2f MB)\n",
+                   stats.scratch_allocs, stats.scratch_bytes / (1024.0 * 1024.0));
+            printf("  - Heap allocations:  %lld\n", stats.heap_allocs);
+            printf("\n");
+            if (is_dynamic) {
+                printf("Dynamic Load Balance:\n");
+                for (int p = 0; p < size; p++) {
+                    printf("  - Rank %d: %d chunks, idle %.6f seconds\n",
+                           p, rank_chunks[p], rank_idle[p]);
+                }
+            } else {
+                printf("Load Balance (modelled cost):\n");
+                printf("  - Imbalance with equal bands: %.1f%%\n", 100.0 * stats.load_imbalance_before);
+                printf("  - Imbalance with cost split:  %.1f%%\n", 100.0 * stats.load_imbalance_after);
+            }
             printf("========================================\n");
+        } else if (is_plan) {
+            printf("Plan creation:       %.6f seconds\n", plan_create_time);
+            printf("First execute:       %.6f seconds\n", plan_first_time);
+            if (repeat > 1) {
+                printf("Later executes:      %.6f seconds mean over %d\n",
+                       plan_rest_time / (repeat - 1), repeat - 1);
+            }
+            printf("Total time: %.6f seconds\n", elapsed);
         } else {
             printf("Total time: %.6f seconds\n", elapsed);
         }
 
         if (output_file) {
             printf("Writing output to %s\n", output_file);
-            write_array_to_file(output_file, output, out_H, out_W);
+            if (is_binary_filename(output_file)) {
+                write_array_to_binary(output_file, result, result_H, result_W, dtype);
+            } else {
+                write_array_to_file(output_file, result, result_H, result_W);
+            }
+        }
+    }
+
+    if (use_cache && rank == 0) {
+        double t_store = MPI_Wtime();
+        if (conv2d_cache_store(cache_dir, cache_key, output, out_H, out_W, cache_max_mb * 1024 * 1024) == 0) {
+            printf("Stored result in cache %s (%.6f seconds)\n", cache_dir, MPI_Wtime() - t_store);
         }
     }
 
     // Cleanup
+    free(rank_chunks);
+    free(rank_idle);
     free_2d_array(f, H);
     free_2d_array(g, kH);
     free_2d_array(output, out_H);
+    free_2d_array(pooled, pool_H);
+    free(f_half);
+    free(output_half);
 
-    MPI_Finalize();
+    finalize();
     return 0;
 }